@@ -0,0 +1,270 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "fpga_emu.h"
+
+#define EMU_SLEEP_THRESHOLD_NS  100000ULL  /* Longer delays sleep first */
+#define EMU_SLEEP_MARGIN_NS     50000ULL   /* then spin the last part   */
+
+static uint64_t
+monotonic_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+sleep_until_ns (uint64_t deadline_ns)
+{
+  struct timespec ts;
+
+  ts.tv_sec = deadline_ns / 1000000000ULL;
+  ts.tv_nsec = deadline_ns % 1000000000ULL;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+    ;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Waits until deadline_ns. Short delays are spun for accuracy; long ones
+ * sleep and spin only the last EMU_SLEEP_MARGIN_NS.
+ *
+ */
+
+static void
+wait_until_ns (uint64_t deadline_ns)
+{
+  uint64_t now = monotonic_ns ();
+
+  if (deadline_ns > now + EMU_SLEEP_THRESHOLD_NS)
+    sleep_until_ns (deadline_ns - EMU_SLEEP_MARGIN_NS);
+  while (monotonic_ns () < deadline_ns)
+    ;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Notifies the pending records at once: the pipe wakes readers and pollers
+ * and sends the O_ASYNC signal, then the eventfd is signalled.
+ *
+ */
+
+static void
+emu_flush (fpga_emu_t *emu)
+{
+  size_t length = emu->npending * sizeof(emu->pending[0]);
+  ssize_t written;
+  uint64_t one = 1;
+
+  if (emu->npending == 0)
+    return;
+  written = write (emu->fd_write, emu->pending, length);
+  if (written < (ssize_t) length)
+    emu->dropped += (length - (written > 0 ? written : 0))
+        / sizeof(emu->pending[0]);
+  if (emu->efd != -1 && write (emu->efd, &one, sizeof(one)) != sizeof(one))
+    emu->dropped++;
+  emu->npending = 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Publishes one record, following GPIO_int_handler(): the slot is claimed by
+ * its seq, filled, and the head is released.
+ *
+ */
+
+static void
+emu_raise (fpga_emu_t *emu)
+{
+  struct gpio_int_ring *ring = emu->ring;
+  struct gpio_int_event *ev;
+  unsigned int seq = ring->head;
+  int cpu = sched_getcpu ();
+
+  ev = &ring->events[seq & GPIO_EVENT_RING_MASK];
+  __atomic_store_n (&ev->seq, seq, __ATOMIC_RELAXED);
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+  ev->timestamp_ns = monotonic_ns ();
+  ev->cpu = cpu < 0 ? 0 : cpu;
+  __atomic_store_n (&ring->head, seq + 1, __ATOMIC_RELEASE);
+
+  if (emu->npending == 0)
+    emu->first_pending_ns = ev->timestamp_ns;
+  emu->pending[emu->npending++] = *ev;
+  if (emu->npending >= emu->coalesce_count
+      || emu->npending == GPIO_EVENT_RING_SIZE)
+    emu_flush (emu);
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Bit 0 is a self-clearing trigger: the thread takes it with an atomic
+ * fetch-and-clear, so every assertion is seen even when the pin is cleared
+ * and set again between two samples of the register.
+ *
+ */
+
+static void *
+emu_thread (void *arg)
+{
+  fpga_emu_t *emu = (fpga_emu_t *) arg;
+  unsigned int seed = (unsigned int) monotonic_ns ();
+  uint64_t edge, delay;
+
+  while (!emu->stop)
+  {
+    if (__atomic_fetch_and (emu->map.reg, ~ONE_BIT_MASK(0), __ATOMIC_ACQ_REL)
+        & ONE_BIT_MASK(0))
+    {
+      edge = monotonic_ns ();
+      delay = emu->delay_ns;
+      if (emu->jitter_ns != 0)
+        delay += (uint64_t) ((double) rand_r (&seed) / RAND_MAX
+                             * emu->jitter_ns);
+      wait_until_ns (edge + delay);
+      emu_raise (emu);
+    }
+    if (emu->npending != 0 && emu->coalesce_us != 0
+        && monotonic_ns () - emu->first_pending_ns
+            >= emu->coalesce_us * 1000ULL)
+      emu_flush (emu);
+    if (emu->poll_ns != 0)
+      sleep_until_ns (monotonic_ns () + emu->poll_ns);
+  }
+  return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Starts the emulator thread.
+ *
+ */
+
+int
+fpga_emu_start (fpga_emu_t *emu, const char *mem_device,
+                unsigned int target_addr, uint64_t delay_ns,
+                uint64_t jitter_ns)
+{
+  sigset_t all, saved;
+  int fds[2];
+  int rc;
+
+  memset (emu, 0, sizeof(*emu));
+  emu->fd = emu->fd_write = emu->efd = -1;
+  emu->delay_ns = delay_ns;
+  emu->coalesce_count = 1;
+  emu->jitter_ns = jitter_ns;
+  /* Spinning on the only CPU would starve the monitor */
+  emu->poll_ns = sysconf (_SC_NPROCESSORS_ONLN) > 1 ? 0 : 10000;
+
+  /* The shared-memory file is created on first use */
+  if ((fds[0] = open (mem_device, O_RDWR | O_CREAT, 0600)) == -1)
+    return -1;
+  close (fds[0]);
+  if (gpio_open_memory_map (&emu->map, mem_device, target_addr) == -1)
+    return -1;
+  emu->ring = calloc (1, sizeof(*emu->ring));
+  if (emu->ring == NULL || pipe (fds) == -1)
+    goto fail;
+  emu->ring->size = GPIO_EVENT_RING_SIZE;
+  gpio_write_reg (&emu->map, 0);  // Reset, like the FPGA at power-up
+  emu->fd = fds[0];
+  emu->fd_write = fds[1];
+  fcntl (emu->fd, F_SETFL, fcntl (emu->fd, F_GETFL) | O_NONBLOCK);
+  fcntl (emu->fd_write, F_SETFL, fcntl (emu->fd_write, F_GETFL) | O_NONBLOCK);
+
+  /* The thread inherits a mask blocking every signal */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &saved);
+  rc = pthread_create (&emu->thread, NULL, emu_thread, emu);
+  pthread_sigmask (SIG_SETMASK, &saved, NULL);
+  if (rc == 0)
+    return 0;
+
+fail:
+  if (emu->fd != -1)
+  {
+    close (emu->fd);
+    close (emu->fd_write);
+  }
+  free (emu->ring);
+  emu->ring = NULL;
+  gpio_close_memory_map (&emu->map);
+  return -1;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Places the emulator thread on a CPU with a priority.
+ *
+ */
+
+int
+fpga_emu_set_sched (fpga_emu_t *emu, int cpu, int priority)
+{
+  struct sched_param param;
+  cpu_set_t set;
+  int rc = 0;
+
+  memset (&param, 0, sizeof(param));
+  param.sched_priority = priority;
+  if (pthread_setschedparam (emu->thread,
+                             priority > 0 ? SCHED_FIFO : SCHED_OTHER,
+                             &param) != 0)
+    rc = -1;
+
+  CPU_ZERO (&set);
+  if (cpu >= 0)
+    CPU_SET (cpu, &set);
+  else
+  {
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      CPU_SET (cpu, &set);
+  }
+  if (pthread_setaffinity_np (emu->thread, sizeof(set), &set) != 0)
+    rc = -1;
+  return rc;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Sets the coalescing thresholds.
+ *
+ */
+
+int
+fpga_emu_set_coalesce (fpga_emu_t *emu, unsigned int count,
+                       unsigned int time_us)
+{
+  if (count == 0)
+    return -1;
+  emu->coalesce_us = time_us;
+  emu->coalesce_count = count;
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Stops the emulator thread.
+ *
+ */
+
+void
+fpga_emu_stop (fpga_emu_t *emu)
+{
+  emu->stop = 1;
+  pthread_join (emu->thread, NULL);
+  close (emu->fd_write);
+  close (emu->fd);
+  free (emu->ring);
+  emu->ring = NULL;
+  gpio_close_memory_map (&emu->map);
+}
@@ -0,0 +1,95 @@
+/*
+ * fpga_emu.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _FPGA_EMU_H_
+#define _FPGA_EMU_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include "gpio.h"
+#include "gpio_interrupt.h"
+
+/* -----------------------------------------------------------------------------
+ *
+ * Userspace stand-in for the int_latency_0 FPGA block and the GPIO kernel
+ * module. A thread maps the shared-memory file used in place of /dev/mem
+ * and watches bit 0 of the register, which it clears when it takes an
+ * assertion (self-clearing trigger). On each assertion it waits the
+ * configured delay plus a random jitter, then behaves like GPIO_int_handler:
+ * the record is published in an event ring with the kernel's protocol and
+ * written to a pipe. The read end of the pipe replaces /dev/gpio_int, so
+ * read(), poll(), epoll and O_ASYNC/F_SETSIG signals work as with the
+ * driver, the latter delivered by the kernel's own pipe notification. An
+ * eventfd stored in efd is signalled like the one registered with the
+ * driver.
+ *
+ */
+typedef struct
+{
+  uint64_t delay_ns;               /* Edge to "interrupt" delay           */
+  uint64_t jitter_ns;              /* Uniform random extra delay          */
+  uint64_t poll_ns;                /* Register sampling period, 0: spin   */
+  int fd;                          /* Read end: stands in for the device  */
+  int fd_write;                    /* Write end used by the thread        */
+  int efd;                         /* eventfd signalled per record, -1    */
+  volatile unsigned int coalesce_count; /* Notify per count records...   */
+  volatile unsigned int coalesce_us;    /* ...or after this long, 0: off */
+  struct gpio_int_event pending[GPIO_EVENT_RING_SIZE]; /* Not notified yet */
+  unsigned int npending;
+  uint64_t first_pending_ns;       /* Publication of pending[0]           */
+  struct gpio_int_ring *ring;      /* Event ring written by the thread    */
+  unsigned long dropped;           /* Records the full pipe did not take,
+                                      like read() overruns of the driver */
+  gpio_map_t map;                  /* The thread's view of the register   */
+  pthread_t thread;
+  volatile int stop;
+} fpga_emu_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Maps the register at target_addr of mem_device and starts the emulator
+ * thread. The thread blocks every signal, so SIGIO and the F_SETSIG signal
+ * go to the monitor's threads. It returns 0 on success and -1 on failure.
+ *
+ */
+int
+fpga_emu_start (fpga_emu_t *emu, const char *mem_device,
+                unsigned int target_addr, uint64_t delay_ns,
+                uint64_t jitter_ns);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Places the emulator thread, which plays the IRQ, on a CPU (-1: any) and
+ * gives it a SCHED_FIFO priority (0: SCHED_OTHER). It returns 0 on success
+ * and -1 on failure.
+ *
+ */
+int
+fpga_emu_set_sched (fpga_emu_t *emu, int cpu, int priority);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Coalesces the notifications like GPIO_IOC_SET_COALESCE: the records are
+ * written to the pipe, and the eventfd signalled, once per count records or
+ * time_us after the first pending one (0: no time limit). The time limit is
+ * checked at each register sample. It returns 0 on success and -1 if count
+ * is 0.
+ *
+ */
+int
+fpga_emu_set_coalesce (fpga_emu_t *emu, unsigned int count,
+                       unsigned int time_us);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Stops the emulator thread and releases the pipe, ring and mapping.
+ *
+ */
+void
+fpga_emu_stop (fpga_emu_t *emu);
+
+#endif /* _FPGA_EMU_H_ */
@@ -1,22 +1,33 @@
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <fcntl.h>
 #include <stddef.h>
 #include <unistd.h>
 #include "gpio.h"
 
-#define ONE_BIT_MASK(_bit)    (0x00000001 << (_bit))
 #define MAP_SIZE              4096UL
 #define MAP_MASK              (MAP_SIZE - 1)
 
 /* -----------------------------------------------------------------------------
  *
- * Opens a memory map. It return its file descriptor.
+ * Opens a memory map. The page holding target_addr is mapped once and kept
+ * in the handle until gpio_close_memory_map() is called.
  *
  */
 
 int
-gpio_open_memory_map (char *mem_device)
+gpio_open_memory_map (gpio_map_t *map, const char *mem_device,
+                      unsigned int target_addr)
 {
+  struct stat st;
+  off_t page_offset = target_addr & ~MAP_MASK;
+  void *regs;
+
+  map->fd = -1;
+  map->map_base = NULL;
+  map->reg = NULL;
+  map->shadow = 0;
+
   int fd = open (mem_device, O_RDWR | O_SYNC);
 
   if (fd == -1)
@@ -24,59 +35,39 @@ gpio_open_memory_map (char *mem_device)
     return -1;
   }
 
-  return fd;
-
-}
-
-
-/* -----------------------------------------------------------------------------
- *
- * gpio_set_pin routine: This routine sets and clears a single bit
- * in a GPIO register.
- *
- */
-
-int
-gpio_set_pin (int fd, unsigned int target_addr, unsigned int pin_number,
-              unsigned int bit_val)
-{
-  unsigned int reg_data;
-
-  volatile unsigned int *regs, *address;
+  /*
+   * An ordinary file may stand in for the memory device. Make sure it is
+   * long enough to map the register page.
+   */
+  if (fstat (fd, &st) == 0 && S_ISREG(st.st_mode)
+      && st.st_size < (off_t) (page_offset + MAP_SIZE))
+  {
+    if (ftruncate (fd, page_offset + MAP_SIZE) == -1)
+    {
+      close (fd);
+      return -1;
+    }
+  }
 
-  regs = (unsigned int *) mmap (NULL, MAP_SIZE, PROT_READ | PROT_WRITE,
-                                MAP_SHARED, fd, target_addr & ~MAP_MASK);
+  regs = mmap (NULL, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+               page_offset);
+  if (regs == MAP_FAILED)
+  {
+    close (fd);
+    return -1;
+  }
 
-  address = regs + (((target_addr) & MAP_MASK) >> 2);
+  map->fd = fd;
+  map->map_base = (volatile unsigned int *) regs;
+  map->reg = map->map_base + ((target_addr & MAP_MASK) >> 2);
+  gpio_shadow_resync (map);
 
 #ifdef DEBUG1
-  printf("REGS           = 0x%.8x\n", regs);
+  printf("REGS           = 0x%.8x\n", map->map_base);
   printf("Target Address = 0x%.8x\n", target_addr);
-  printf("Address        = 0x%.8x\n", address);     // display address value
-  //printf("Mask           = 0x%.8x\n", ONE_BIT_MASK(pin_number));  // Display mask value
+  printf("Address        = 0x%.8x\n", map->reg);     // display address value
 #endif
 
-  /* Read register value to modify */
-
-  reg_data = *address;
-
-  if (bit_val == 0)
-  {
-
-    /* Deassert output pin in the target port's DR register*/
-
-    reg_data &= ~ONE_BIT_MASK(pin_number);
-    *address = reg_data;
-  }
-  else
-  {
-
-    /* Assert output pin in the target port's DR register*/
-
-    reg_data |= ONE_BIT_MASK(pin_number);
-    *address = reg_data;
-  }
-
   return 0;
 
 }
@@ -88,13 +79,22 @@ gpio_set_pin (int fd, unsigned int target_addr, unsigned int pin_number,
  */
 
 int
-gpio_close_memory_map (int fd)
+gpio_close_memory_map (gpio_map_t *map)
 {
-  int temp = close (fd);
-  if (temp == -1)
+  int rc = 0;
+
+  if (map->map_base != NULL)
   {
-    return -1;
+    if (munmap ((void *) map->map_base, MAP_SIZE) == -1)
+      rc = -1;
+    map->map_base = NULL;
+    map->reg = NULL;
   }
-  munmap (NULL, MAP_SIZE);
-  return 0;
+  if (map->fd != -1)
+  {
+    if (close (map->fd) == -1)
+      rc = -1;
+    map->fd = -1;
+  }
+  return rc;
 }
@@ -8,31 +8,201 @@
 #ifndef _GPIO_H_
 #define _GPIO_H_
 
+#define ONE_BIT_MASK(_bit)    (0x00000001 << (_bit))
+
 /* -----------------------------------------------------------------------------
  *
- * Opens a memory map. It return its file descriptor.
+ * Handle of a mapped GPIO register. The page holding the register is mapped
+ * once by gpio_open_memory_map() and kept until gpio_close_memory_map(), so
+ * the set/clear/write calls below only touch the register itself.
+ *
+ */
+typedef struct
+{
+  int fd;                          /* Descriptor of the memory device/file  */
+  volatile unsigned int *map_base; /* Start of the mapped page              */
+  volatile unsigned int *reg;      /* Register inside the mapped page       */
+  unsigned int shadow;             /* Userspace copy for write-only access  */
+} gpio_map_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Opens a memory map. The memory device (normally /dev/mem) is opened and the
+ * page holding target_addr is mapped. A plain file may be given instead of
+ * the memory device; it is extended (sparse) so the page can be mapped.
+ * It returns 0 on success and -1 on failure.
  *
  */
 int
-gpio_open_memory_map (char *mem_device);
+gpio_open_memory_map (gpio_map_t *map, const char *mem_device,
+                      unsigned int target_addr);
+
+/** @brief gpio_read_reg routine: Reads the mapped GPIO register.
+ *  @param map Mapped GPIO register
+ *  @return The register value
+ */
+static inline unsigned int
+gpio_read_reg (gpio_map_t *map)
+{
+  return *map->reg;
+}
+
+/** @brief gpio_write_reg routine: Writes the whole mapped GPIO register.
+ *  @param map Mapped GPIO register
+ *  @param value Value written to the register
+ */
+static inline void
+gpio_write_reg (gpio_map_t *map, unsigned int value)
+{
+  *map->reg = value;
+}
+
+/** @brief gpio_set_bit routine: Asserts a single bit in the GPIO register.
+ *  @param map Mapped GPIO register
+ *  @param pin_number GPIO pin to be asserted
+ */
+static inline void
+gpio_set_bit (gpio_map_t *map, unsigned int pin_number)
+{
+  *map->reg = *map->reg | ONE_BIT_MASK(pin_number);
+}
+
+/** @brief gpio_clear_bit routine: Deasserts a single bit in the GPIO register.
+ *  @param map Mapped GPIO register
+ *  @param pin_number GPIO pin to be deasserted
+ */
+static inline void
+gpio_clear_bit (gpio_map_t *map, unsigned int pin_number)
+{
+  *map->reg = *map->reg & ~ONE_BIT_MASK(pin_number);
+}
 
 /** @brief gpio_set_pin routine: This routine sets and clears a single bit
  * in a GPIO register.
- *  @param target_addr GPIO register address
+ *  @param map Mapped GPIO register
  *  @param pin_number GPIO pin used to read/write
- *  @return bit_val   value used to set the GPIO pin
+ *  @param bit_val   value used to set the GPIO pin
  */
-int
-gpio_set_pin (int fd, unsigned int target_addr, unsigned int pin_number,
-              unsigned int bit_val);
+static inline void
+gpio_set_pin (gpio_map_t *map, unsigned int pin_number, unsigned int bit_val)
+{
+  if (bit_val == 0)
+    gpio_clear_bit (map, pin_number);
+  else
+    gpio_set_bit (map, pin_number);
+}
 
+/* -----------------------------------------------------------------------------
+ *
+ * Shadow register (write-only) access. The register value is kept in
+ * map->shadow so the hot path never reads the device: each call updates the
+ * shadow atomically and then stores the result. Since two threads may store
+ * in a different order than they updated the shadow, the store is repeated
+ * until the shadow is seen unchanged after it, so the last store always
+ * carries the latest shadow value.
+ *
+ */
+
+static inline void
+gpio_shadow_publish (gpio_map_t *map, unsigned int value)
+{
+  unsigned int latest;
+
+  for (;;)
+  {
+    *map->reg = value;
+    /* The store must be visible before the shadow is checked again */
+    __atomic_thread_fence (__ATOMIC_SEQ_CST);
+    latest = __atomic_load_n (&map->shadow, __ATOMIC_ACQUIRE);
+    if (latest == value)
+      break;
+    value = latest;
+  }
+}
+
+/** @brief gpio_shadow_resync routine: Re-reads the device into the shadow.
+ *  Used when something else than this handle may have changed the register.
+ *  @param map Mapped GPIO register
+ *  @return The register value
+ */
+static inline unsigned int
+gpio_shadow_resync (gpio_map_t *map)
+{
+  unsigned int value = *map->reg;
+
+  __atomic_store_n (&map->shadow, value, __ATOMIC_RELEASE);
+  return value;
+}
+
+/** @brief gpio_shadow_set_bit routine: Asserts a bit without reading the
+ *  device.
+ *  @param map Mapped GPIO register
+ *  @param pin_number GPIO pin to be asserted
+ */
+static inline void
+gpio_shadow_set_bit (gpio_map_t *map, unsigned int pin_number)
+{
+  gpio_shadow_publish (map, __atomic_or_fetch (&map->shadow,
+                                               ONE_BIT_MASK(pin_number),
+                                               __ATOMIC_ACQ_REL));
+}
+
+/** @brief gpio_shadow_clear_bit routine: Deasserts a bit without reading the
+ *  device.
+ *  @param map Mapped GPIO register
+ *  @param pin_number GPIO pin to be deasserted
+ */
+static inline void
+gpio_shadow_clear_bit (gpio_map_t *map, unsigned int pin_number)
+{
+  gpio_shadow_publish (map, __atomic_and_fetch (&map->shadow,
+                                                ~ONE_BIT_MASK(pin_number),
+                                                __ATOMIC_ACQ_REL));
+}
+
+/** @brief gpio_shadow_update routine: Replaces the bits selected by mask with
+ *  the matching bits of value, without reading the device.
+ *  @param map Mapped GPIO register
+ *  @param mask Bits to be updated
+ *  @param value New value of the selected bits
+ */
+static inline void
+gpio_shadow_update (gpio_map_t *map, unsigned int mask, unsigned int value)
+{
+  unsigned int old_val = __atomic_load_n (&map->shadow, __ATOMIC_RELAXED);
+  unsigned int new_val;
+
+  do
+  {
+    new_val = (old_val & ~mask) | (value & mask);
+  }
+  while (!__atomic_compare_exchange_n (&map->shadow, &old_val, new_val, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+  gpio_shadow_publish (map, new_val);
+}
+
+/** @brief gpio_shadow_set_pin routine: Write-only version of gpio_set_pin().
+ *  @param map Mapped GPIO register
+ *  @param pin_number GPIO pin used to write
+ *  @param bit_val   value used to set the GPIO pin
+ */
+static inline void
+gpio_shadow_set_pin (gpio_map_t *map, unsigned int pin_number,
+                     unsigned int bit_val)
+{
+  if (bit_val == 0)
+    gpio_shadow_clear_bit (map, pin_number);
+  else
+    gpio_shadow_set_bit (map, pin_number);
+}
 
 /* -----------------------------------------------------------------------------
  *
- * Closes a memory map.
+ * Closes a memory map. The mapped page is released and the memory device is
+ * closed.
  *
  */
 int
-gpio_close_memory_map (int fd);
+gpio_close_memory_map (gpio_map_t *map);
 
 #endif /* _GPIO_H_ */
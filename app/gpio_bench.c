@@ -0,0 +1,121 @@
+/*
+ ============================================================================
+ Name        : gpio_bench.c
+ Author      : Advanced MCU - Spring 2018 - Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Microbenchmark of the GPIO register access paths. It compares
+ the read-modify-write path against the shadow register path on a mapped
+ register (by default a plain file standing in for /dev/mem).
+ ============================================================================
+ */
+
+/* *************************** INCLUDES *********************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include "gpio.h"
+
+/* ******************* MACROS AND TYPE DEFINITIONS ************************* */
+
+#define BENCH_MEM_FILE    "/tmp/gpio_bench_mem"
+#define BENCH_ITERATIONS  10000000UL
+
+#define INT_LATENCY_ADDR  0x43C10000
+
+/* ********************** FUNCTION IMPLEMENTATION ************************* */
+
+static double
+elapsed_ns (struct timespec *t1, struct timespec *t2)
+{
+  return (t2->tv_sec - t1->tv_sec) * 1e9 + (t2->tv_nsec - t1->tv_nsec);
+}
+
+static double
+bench_rmw (gpio_map_t *map, unsigned long iterations)
+{
+  struct timespec t1, t2;
+  unsigned long i;
+
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  for (i = 0; i < iterations; i++)
+  {
+    gpio_set_pin (map, 0, 1);
+    gpio_set_pin (map, 0, 0);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &t2);
+  return elapsed_ns (&t1, &t2) / (2.0 * iterations);
+}
+
+static double
+bench_shadow (gpio_map_t *map, unsigned long iterations)
+{
+  struct timespec t1, t2;
+  unsigned long i;
+
+  gpio_shadow_resync (map);
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  for (i = 0; i < iterations; i++)
+  {
+    gpio_shadow_set_bit (map, 0);
+    gpio_shadow_clear_bit (map, 0);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &t2);
+  return elapsed_ns (&t1, &t2) / (2.0 * iterations);
+}
+
+/* *************************** MAIN FUNCTION ****************************** */
+
+int
+main (int argc, char **argv)
+{
+  char *mem_device = BENCH_MEM_FILE;
+  unsigned long iterations = BENCH_ITERATIONS;
+  gpio_map_t gpio_map;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "m:n:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'm':
+        mem_device = optarg;
+        break;
+      case 'n':
+        iterations = strtoul (optarg, NULL, 0);
+        break;
+      default:
+        printf ("Usage: %s [-m mem_device] [-n iterations]\n", argv[0]);
+        exit (-1);
+    }
+  }
+  if (iterations == 0)
+    iterations = 1;
+
+  /* The file standing in for /dev/mem is created on first use */
+  if (access (mem_device, F_OK) != 0)
+    close (open (mem_device, O_RDWR | O_CREAT, 0644));
+
+  if (gpio_open_memory_map (&gpio_map, mem_device, INT_LATENCY_ADDR) == -1)
+  {
+    perror ("GPIO_BENCH: Unable to map memory device");
+    exit (-1);
+  }
+  printf ("GPIO_BENCH: %s mapped, %lu set/clear pairs per path\n",
+          mem_device, iterations);
+
+  /* Warm up both paths before taking measurements */
+  bench_rmw (&gpio_map, iterations / 10 + 1);
+  bench_shadow (&gpio_map, iterations / 10 + 1);
+
+  printf ("Read-modify-write:  %8.2fns per access\n",
+          bench_rmw (&gpio_map, iterations));
+  printf ("Shadow register:    %8.2fns per access\n",
+          bench_shadow (&gpio_map, iterations));
+
+  gpio_close_memory_map (&gpio_map);
+  return 0;
+}
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include "gpio_ctl.h"
+
+static const char *trigger_names[] = {
+  [GPIO_TRIGGER_RISING]  = "rising",
+  [GPIO_TRIGGER_FALLING] = "falling",
+  [GPIO_TRIGGER_BOTH]    = "both",
+  [GPIO_TRIGGER_HIGH]    = "high",
+  [GPIO_TRIGGER_LOW]     = "low",
+};
+
+static const struct
+{
+  const char *name;
+  uint32_t mask;
+} notify_names[] = {
+  { "ring",  GPIO_NOTIFY_RING  },
+  { "wake",  GPIO_NOTIFY_WAKE  },
+  { "sigio", GPIO_NOTIFY_SIGIO },
+  { "eventfd", GPIO_NOTIFY_EVENTFD },
+};
+
+#define ARRAY_LEN(a)  (sizeof(a) / sizeof((a)[0]))
+
+/* -----------------------------------------------------------------------------
+ *
+ * ioctl wrappers.
+ *
+ */
+
+int
+gpio_ctl_info (int fd, struct gpio_int_info *info)
+{
+  return ioctl (fd, GPIO_IOC_GET_INFO, info) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_stats (int fd, struct gpio_int_stats *stats, int reset)
+{
+  return ioctl (fd, reset ? GPIO_IOC_SNAP_RESET : GPIO_IOC_GET_STATS, stats)
+      == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_reset (int fd)
+{
+  return ioctl (fd, GPIO_IOC_RESET_STATS) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_set_notify (int fd, uint32_t mask)
+{
+  return ioctl (fd, GPIO_IOC_SET_NOTIFY, &mask) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_set_coalesce (int fd, uint32_t count, uint32_t time_us)
+{
+  struct gpio_int_coalesce coalesce;
+
+  coalesce.count = count;
+  coalesce.time_us = time_us;
+  return ioctl (fd, GPIO_IOC_SET_COALESCE, &coalesce) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_set_trigger (int fd, uint32_t trigger)
+{
+  return ioctl (fd, GPIO_IOC_SET_TRIGGER, &trigger) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_set_irq_mode (int fd, uint32_t mode)
+{
+  return ioctl (fd, GPIO_IOC_SET_IRQ_MODE, &mode) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_cursor (int fd, struct gpio_int_cursor *cursor)
+{
+  return ioctl (fd, GPIO_IOC_GET_CURSOR, cursor) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_set_eventfd (int fd, int efd)
+{
+  int32_t value = efd;
+
+  return ioctl (fd, GPIO_IOC_SET_EVENTFD, &value) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_set_debug (int fd, uint32_t debug)
+{
+  return ioctl (fd, GPIO_IOC_SET_DEBUG, &debug) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_loopback_start (int fd, uint64_t period_ns, uint64_t samples)
+{
+  struct gpio_int_loopback lb;
+
+  lb.period_ns = period_ns;
+  lb.samples = samples;
+  return ioctl (fd, GPIO_IOC_LOOPBACK_START, &lb) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_loopback_stop (int fd)
+{
+  return ioctl (fd, GPIO_IOC_LOOPBACK_STOP) == -1 ? -1 : 0;
+}
+
+int
+gpio_ctl_loopback_stats (int fd, struct gpio_int_loopback_stats *stats)
+{
+  return ioctl (fd, GPIO_IOC_LOOPBACK_STATS, stats) == -1 ? -1 : 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Names of the settings.
+ *
+ */
+
+const char *
+gpio_ctl_trigger_name (uint32_t trigger)
+{
+  if (trigger >= ARRAY_LEN(trigger_names))
+    return "unknown";
+  return trigger_names[trigger];
+}
+
+int
+gpio_ctl_parse_trigger (const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < ARRAY_LEN(trigger_names); i++)
+    if (strcmp (name, trigger_names[i]) == 0)
+      return i;
+  return -1;
+}
+
+void
+gpio_ctl_notify_string (uint32_t mask, char *buf, size_t len)
+{
+  size_t i, used = 0;
+
+  buf[0] = '\0';
+  for (i = 0; i < ARRAY_LEN(notify_names) && used < len; i++)
+    if (mask & notify_names[i].mask)
+      used += snprintf (buf + used, len - used, "%s%s", used ? "," : "",
+                        notify_names[i].name);
+  if (used == 0)
+    snprintf (buf, len, "none");
+}
+
+/* A comma-separated list of names, "all" or "none" */
+int
+gpio_ctl_parse_notify (const char *names)
+{
+  char copy[64], *name, *save;
+  int mask = 0;
+  size_t i;
+
+  if (strcmp (names, "all") == 0)
+    return GPIO_NOTIFY_ALL;
+  if (strcmp (names, "none") == 0)
+    return 0;
+  snprintf (copy, sizeof(copy), "%s", names);
+  for (name = strtok_r (copy, ",", &save); name != NULL;
+       name = strtok_r (NULL, ",", &save))
+  {
+    for (i = 0; i < ARRAY_LEN(notify_names); i++)
+      if (strcmp (name, notify_names[i].name) == 0)
+        break;
+    if (i == ARRAY_LEN(notify_names))
+      return -1;
+    mask |= notify_names[i].mask;
+  }
+  return mask;
+}
@@ -0,0 +1,96 @@
+/*
+ * gpio_ctl.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _GPIO_CTL_H_
+#define _GPIO_CTL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gpio_interrupt.h"
+
+/* -----------------------------------------------------------------------------
+ *
+ * Wrappers of the ioctl control plane of /dev/gpio_int (GPIO_IOC_* in
+ * gpio_interrupt.h). Every function takes the opened device and returns 0
+ * on success and -1 on failure with errno set, e.g. ENOTTY when fd is not
+ * the GPIO device or the driver predates the control plane.
+ *
+ */
+
+/* Reads the version, features and current settings of the driver */
+int
+gpio_ctl_info (int fd, struct gpio_int_info *info);
+
+/* Sums the per-CPU statistics of the driver; with reset non-zero they are
+ * cleared in the same step, so no interrupt falls between two snapshots */
+int
+gpio_ctl_stats (int fd, struct gpio_int_stats *stats, int reset);
+
+/* Reads the read() cursor of this open file: its position, the records
+ * waiting and those it lost */
+int
+gpio_ctl_cursor (int fd, struct gpio_int_cursor *cursor);
+
+/* Clears the statistics of the driver */
+int
+gpio_ctl_reset (int fd);
+
+/* Selects the notification paths, a mask of GPIO_NOTIFY_* */
+int
+gpio_ctl_set_notify (int fd, uint32_t mask);
+
+/* Notifies once per count interrupts or time_us after the first pending
+ * one (0: no time limit) */
+int
+gpio_ctl_set_coalesce (int fd, uint32_t count, uint32_t time_us);
+
+/* Selects the interrupt trigger, one of GPIO_TRIGGER_* */
+int
+gpio_ctl_set_trigger (int fd, uint32_t trigger);
+
+/* Selects the hard (GPIO_IRQ_MODE_HARD) or threaded IRQ handler */
+int
+gpio_ctl_set_irq_mode (int fd, uint32_t mode);
+
+/* Registers an eventfd signalled on each notification, -1 unregisters it */
+int
+gpio_ctl_set_eventfd (int fd, int efd);
+
+/* Enables or disables the printk() of the handler */
+int
+gpio_ctl_set_debug (int fd, uint32_t debug);
+
+/* Starts the in-kernel loopback for samples edges (0: until stopped), one
+ * every period_ns; it clears the loopback statistics */
+int
+gpio_ctl_loopback_start (int fd, uint64_t period_ns, uint64_t samples);
+
+int
+gpio_ctl_loopback_stop (int fd);
+
+int
+gpio_ctl_loopback_stats (int fd, struct gpio_int_loopback_stats *stats);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Names of the settings, for the output and the command line. The parsers
+ * return -1 for an unknown name.
+ *
+ */
+const char *
+gpio_ctl_trigger_name (uint32_t trigger);
+
+int
+gpio_ctl_parse_trigger (const char *name);
+
+void
+gpio_ctl_notify_string (uint32_t mask, char *buf, size_t len);
+
+int
+gpio_ctl_parse_notify (const char *names);
+
+#endif /* _GPIO_CTL_H_ */
@@ -0,0 +1,231 @@
+/*
+ ============================================================================
+ Name        : gpio_ctl_tool.c
+ Author      : Advanced MCU - Spring 2018 - Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Command line front end of the ioctl control plane of the GPIO
+ kernel module: shows the driver settings and statistics, resets them and
+ changes the notification paths, coalescing, trigger and debug output.
+ ============================================================================
+ */
+
+/* *************************** INCLUDES *********************************** */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gpio_ctl.h"
+
+/* ******************* MACROS AND TYPE DEFINITIONS ************************* */
+
+#define GPIO_DEVICE       "/dev/gpio_int"
+#define NSEC_PER_USEC     1000.0
+
+/* ********************** FUNCTION IMPLEMENTATION ************************* */
+
+static void
+usage (const char *name)
+{
+  printf ("Usage: %s [-d device] command [argument]\n"
+          "  info                       driver version, features, settings\n"
+          "  stats [-r]                 statistics (-r: snapshot and reset)\n"
+          "  reset                      clear the statistics\n"
+          "  notify all|none|ring,wake,sigio,eventfd\n"
+          "  coalesce count [time_us]   notify once per count interrupts\n"
+          "  trigger rising|falling|both|high|low\n"
+          "  debug 0|1                  printk() in the handler\n"
+          "  irqmode hard|threaded      IRQ handler, threaded: notify from"
+          " the IRQ thread\n"
+          "  loopback [start period_ns [samples]|stop]\n"
+          "                             in-kernel pin toggling, no argument:"
+          " results\n", name);
+  exit (-1);
+}
+
+static void
+print_info (const struct gpio_int_info *info)
+{
+  char notify[48];
+
+  gpio_ctl_notify_string (info->notify, notify, sizeof(notify));
+  printf ("Version:   %u.%u\n", info->version >> 8, info->version & 0xff);
+  printf ("Device:    gpio_int%u\n", info->index);
+  printf ("Features: %s%s%s%s%s%s%s%s%s%s\n",
+          info->features & GPIO_FEAT_RING ? " ring" : "",
+          info->features & GPIO_FEAT_READ ? " read" : "",
+          info->features & GPIO_FEAT_STATS ? " stats" : "",
+          info->features & GPIO_FEAT_COALESCE ? " coalesce" : "",
+          info->features & GPIO_FEAT_TRIGGER ? " trigger" : "",
+          info->features & GPIO_FEAT_LOOPBACK ? " loopback" : "",
+          info->features & GPIO_FEAT_THREADED ? " threaded" : "",
+          info->features & GPIO_FEAT_EVENTFD ? " eventfd" : "",
+          info->features & GPIO_FEAT_SIMULATION ? " simulation" : "",
+          info->features & GPIO_FEAT_PREEMPT_RT ? " preempt_rt" : "");
+  printf ("IRQ:       %u (%s, %s handler)\n", info->irq,
+          gpio_ctl_trigger_name (info->trigger),
+          info->irq_mode == GPIO_IRQ_MODE_THREADED ? "threaded" : "hard");
+  printf ("Ring:      %u records\n", info->ring_size);
+  printf ("Notify:    %s\n", notify);
+  printf ("Coalesce:  %u interrupts, %u us\n", info->coalesce_count,
+          info->coalesce_us);
+  printf ("Debug:     %s\n", info->debug ? "on" : "off");
+}
+
+static void
+print_stat (const char *name, const struct gpio_int_stat *stat)
+{
+  if (stat->max == 0)
+  {
+    printf ("%-12s -\n", name);
+    return;
+  }
+  printf ("%-12s min %10.3f us  max %10.3f us  last %10.3f us\n", name,
+          stat->min / NSEC_PER_USEC, stat->max / NSEC_PER_USEC,
+          stat->last / NSEC_PER_USEC);
+}
+
+static void
+print_stats (const struct gpio_int_stats *stats)
+{
+  printf ("Interrupts:    %llu\n", (unsigned long long) stats->count);
+  printf ("Notifications: %llu\n", (unsigned long long) stats->notifications);
+  printf ("Ring head:     %u\n", stats->head);
+  printf ("Read overruns: %u\n", stats->read_overruns);
+  print_stat ("Handler", &stats->isr);
+  print_stat ("Interval", &stats->gap);
+  print_stat ("Thread wake", &stats->thread);
+}
+
+/* Log2 histogram of the driver, bucket i covers [2^(i-1), 2^i) ns */
+static void
+print_hist (const struct gpio_int_stat *stat)
+{
+  unsigned long long total = 0, below = 0;
+  int i;
+
+  for (i = 0; i < GPIO_STAT_BUCKETS; i++)
+    total += stat->hist[i];
+  for (i = 0; i < GPIO_STAT_BUCKETS; i++)
+  {
+    if (stat->hist[i] == 0)
+      continue;
+    below += stat->hist[i];
+    printf ("  < %12.3f us %10u %7.3f%%\n", (1ULL << i) / NSEC_PER_USEC,
+            stat->hist[i], 100.0 * below / total);
+  }
+}
+
+static int
+loopback (int fd, int argc, char **argv)
+{
+  struct gpio_int_loopback_stats stats;
+
+  if (argc > 0 && strcmp (argv[0], "stop") == 0)
+    return gpio_ctl_loopback_stop (fd);
+  if (argc > 1 && strcmp (argv[0], "start") == 0)
+    return gpio_ctl_loopback_start (fd, strtoull (argv[1], NULL, 0),
+                                    argc > 2 ? strtoull (argv[2], NULL, 0)
+                                        : 0);
+  if (argc > 0)
+    return -2;
+
+  if (gpio_ctl_loopback_stats (fd, &stats) == -1)
+    return -1;
+  printf ("Loopback:      %s\n", stats.running ? "running" : "stopped");
+  printf ("Samples:       %llu\n", (unsigned long long) stats.samples);
+  printf ("Timeouts:      %llu\n", (unsigned long long) stats.timeouts);
+  print_stat ("Edge to IRQ", &stats.latency);
+  if (stats.samples != 0)
+    print_hist (&stats.latency);
+  return 0;
+}
+
+/* *************************** MAIN FUNCTION ****************************** */
+
+int
+main (int argc, char **argv)
+{
+  const char *device = GPIO_DEVICE;
+  struct gpio_int_info info;
+  struct gpio_int_stats stats;
+  const char *command;
+  int fd, rc, value;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "+d:")) != -1)
+  {
+    if (opt == 'd')
+      device = optarg;
+    else
+      usage (argv[0]);
+  }
+  if (optind >= argc)
+    usage (argv[0]);
+  command = argv[optind++];
+
+  if ((fd = open (device, O_RDONLY)) == -1)
+  {
+    printf ("GPIO_CTL: Failed to open %s: %s\n", device, strerror (errno));
+    exit (-1);
+  }
+
+  if (strcmp (command, "info") == 0)
+  {
+    if ((rc = gpio_ctl_info (fd, &info)) == 0)
+      print_info (&info);
+  }
+  else if (strcmp (command, "stats") == 0)
+  {
+    value = optind < argc && strcmp (argv[optind], "-r") == 0;
+    if ((rc = gpio_ctl_stats (fd, &stats, value)) == 0)
+      print_stats (&stats);
+  }
+  else if (strcmp (command, "reset") == 0)
+    rc = gpio_ctl_reset (fd);
+  else if (strcmp (command, "loopback") == 0)
+  {
+    if ((rc = loopback (fd, argc - optind, argv + optind)) == -2)
+      usage (argv[0]);
+  }
+  else if (optind >= argc)
+    usage (argv[0]);
+  else if (strcmp (command, "notify") == 0)
+  {
+    if ((value = gpio_ctl_parse_notify (argv[optind])) < 0)
+      usage (argv[0]);
+    rc = gpio_ctl_set_notify (fd, value);
+  }
+  else if (strcmp (command, "coalesce") == 0)
+    rc = gpio_ctl_set_coalesce (fd, strtoul (argv[optind], NULL, 0),
+                                optind + 1 < argc
+                                    ? strtoul (argv[optind + 1], NULL, 0) : 0);
+  else if (strcmp (command, "trigger") == 0)
+  {
+    if ((value = gpio_ctl_parse_trigger (argv[optind])) < 0)
+      usage (argv[0]);
+    rc = gpio_ctl_set_trigger (fd, value);
+  }
+  else if (strcmp (command, "irqmode") == 0)
+  {
+    if (strcmp (argv[optind], "hard") == 0)
+      value = GPIO_IRQ_MODE_HARD;
+    else if (strcmp (argv[optind], "threaded") == 0)
+      value = GPIO_IRQ_MODE_THREADED;
+    else
+      usage (argv[0]);
+    rc = gpio_ctl_set_irq_mode (fd, value);
+  }
+  else if (strcmp (command, "debug") == 0)
+    rc = gpio_ctl_set_debug (fd, strtoul (argv[optind], NULL, 0));
+  else
+    usage (argv[0]);
+
+  if (rc == -1)
+    printf ("GPIO_CTL: %s failed: %s\n", command, strerror (errno));
+  close (fd);
+  return rc == 0 ? 0 : -1;
+}
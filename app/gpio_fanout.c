@@ -0,0 +1,299 @@
+/*
+ ============================================================================
+ Name        : gpio_fanout.c
+ Author      : Advanced MCU - Spring 2018 - Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Fan-out benchmark of the GPIO kernel module. For 1, 2, 4 ...
+ 64 subscribers, each with its own open file and read() cursor, it toggles
+ the interrupt pin and reports the time spent in the interrupt handler, the
+ delivery latency (IRQ entry to the subscriber) and the records each
+ subscriber lost.
+ ============================================================================
+ */
+
+/* *************************** INCLUDES *********************************** */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "gpio.h"
+#include "gpio_ctl.h"
+#include "histogram.h"
+
+/* ******************* MACROS AND TYPE DEFINITIONS ************************* */
+
+#define GPIO_DEVICE       "/dev/gpio_int"
+#define MEM_DEVICE        "/dev/mem"
+#define INT_LATENCY_ADDR  0x43C10000
+
+#define FANOUT_MAX_SUBS   64        /* Last step of the sweep             */
+#define FANOUT_EDGES      2000      /* Interrupts per step                */
+#define FANOUT_PERIOD_US  500       /* Between two rising edges           */
+#define FANOUT_BATCH      64        /* Records per read()                 */
+#define FANOUT_POLL_MS    100       /* Subscribers check the stop flag    */
+#define FANOUT_DRAIN_MS   1000      /* Wait for late records after a step */
+
+#define NSEC_PER_SEC      1000000000ULL
+#define NSEC_PER_USEC     1000.0
+
+/*
+ * One subscriber: an open file of the device drained by its own thread.
+ */
+typedef struct
+{
+  int fd;
+  pthread_t thread;
+  unsigned long records;    /* Records received                          */
+  histogram_t latency;      /* IRQ entry to this thread, every record    */
+} subscriber_t;
+
+/* ******************* STATIC AND GLOBAL VARIABLES  *********************** */
+
+static volatile int stop_subscribers = 0;
+
+/* ********************** FUNCTION IMPLEMENTATION ************************* */
+
+static uint64_t
+monotonic_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void
+sleep_until (uint64_t deadline_ns)
+{
+  struct timespec ts;
+
+  ts.tv_sec = deadline_ns / NSEC_PER_SEC;
+  ts.tv_nsec = deadline_ns % NSEC_PER_SEC;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+    ;
+}
+
+/* Upper bound of a percentile of a driver log2 histogram, in ns */
+static unsigned long long
+stat_percentile (const struct gpio_int_stat *stat, double percentile)
+{
+  unsigned long long total = 0, below = 0;
+  int i;
+
+  for (i = 0; i < GPIO_STAT_BUCKETS; i++)
+    total += stat->hist[i];
+  for (i = 0; i < GPIO_STAT_BUCKETS; i++)
+  {
+    below += stat->hist[i];
+    if (total != 0 && below * 100.0 >= percentile * total)
+      return i ? 1ULL << i : 1;
+  }
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Drains the subscriber's file until the stop flag is set. The device is
+ * opened non-blocking and waited on with poll(), so the flag is seen within
+ * FANOUT_POLL_MS.
+ *
+ */
+
+static void *
+subscriber_thread (void *arg)
+{
+  subscriber_t *sub = (subscriber_t *) arg;
+  struct gpio_int_event events[FANOUT_BATCH];
+  struct pollfd pfd = { .fd = sub->fd, .events = POLLIN };
+  uint64_t now;
+  ssize_t n, i;
+
+  while (!stop_subscribers)
+  {
+    if (poll (&pfd, 1, FANOUT_POLL_MS) <= 0)
+      continue;
+    while ((n = read (sub->fd, events, sizeof(events))) > 0)
+    {
+      now = monotonic_ns ();
+      n /= sizeof(events[0]);
+      for (i = 0; i < n; i++)
+        hist_add (&sub->latency, now - events[i].timestamp_ns);
+      sub->records += n;
+    }
+  }
+  return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * One step of the sweep: num_subs subscribers receive edges interrupts.
+ *
+ */
+
+static int
+run_step (const char *device, int fd_ctl, gpio_map_t *map, int num_subs,
+          unsigned long edges, unsigned long period_us)
+{
+  static subscriber_t subs[FANOUT_MAX_SUBS];
+  struct gpio_int_stats stats;
+  struct gpio_int_cursor cursor;
+  unsigned long delivered = 0, overruns = 0;
+  uint64_t next, period = (uint64_t) period_us * 1000, deadline;
+  histogram_t latency;
+  int i, started = 0, rc = 0;
+
+  hist_reset (&latency);
+  stop_subscribers = 0;
+  for (i = 0; i < num_subs; i++)
+  {
+    memset (&subs[i], 0, sizeof(subs[i]));
+    hist_reset (&subs[i].latency);
+    subs[i].fd = open (device, O_RDONLY | O_NONBLOCK);
+    if (subs[i].fd == -1
+        || pthread_create (&subs[i].thread, NULL, subscriber_thread,
+                           &subs[i]) != 0)
+    {
+      printf ("GPIO_FANOUT: Unable to start subscriber %d: %s\n", i,
+              strerror (errno));
+      if (subs[i].fd != -1)
+        close (subs[i].fd);
+      rc = -1;
+      break;
+    }
+    started++;
+  }
+
+  if (rc == 0)
+  {
+    gpio_ctl_stats (fd_ctl, &stats, 1);
+    next = monotonic_ns ();
+    for (i = 0; i < (int) edges; i++)
+    {
+      gpio_set_pin (map, 0, 1);
+      sleep_until (next + period / 2);
+      gpio_set_pin (map, 0, 0);
+      next += period;
+      sleep_until (next);
+    }
+
+    /* Wait for every subscriber to receive every record, or give up */
+    deadline = monotonic_ns () + FANOUT_DRAIN_MS * 1000000ULL;
+    for (i = 0; i < num_subs && monotonic_ns () < deadline; )
+    {
+      if (__atomic_load_n (&subs[i].records, __ATOMIC_RELAXED) >= edges)
+        i++;
+      else
+        usleep (1000);
+    }
+  }
+
+  stop_subscribers = 1;
+  for (i = 0; i < started; i++)
+  {
+    pthread_join (subs[i].thread, NULL);
+    if (gpio_ctl_cursor (subs[i].fd, &cursor) == 0)
+      overruns += cursor.overruns;
+    delivered += subs[i].records;
+    hist_merge (&latency, &subs[i].latency);
+    close (subs[i].fd);
+  }
+  if (rc == -1)
+    return -1;
+
+  if (gpio_ctl_stats (fd_ctl, &stats, 0) == -1)
+  {
+    printf ("GPIO_FANOUT: Unable to read the driver statistics: %s\n",
+            strerror (errno));
+    return -1;
+  }
+  printf ("%5d %8llu %10lu %9lu %9llu %9llu %9llu %10.3f %10.3f %10.3f\n",
+          num_subs, (unsigned long long) stats.count, delivered, overruns,
+          stat_percentile (&stats.isr, 50), stat_percentile (&stats.isr, 99),
+          (unsigned long long) stats.isr.max,
+          hist_percentile (&latency, 50) / NSEC_PER_USEC,
+          hist_percentile (&latency, 99) / NSEC_PER_USEC,
+          latency.max / NSEC_PER_USEC);
+  return 0;
+}
+
+/* *************************** MAIN FUNCTION ****************************** */
+
+int
+main (int argc, char **argv)
+{
+  const char *device = GPIO_DEVICE;
+  char *mem_device = MEM_DEVICE;
+  unsigned long edges = FANOUT_EDGES, period_us = FANOUT_PERIOD_US;
+  int max_subs = FANOUT_MAX_SUBS;
+  gpio_map_t gpio_map;
+  int fd_ctl, num_subs, opt;
+
+  while ((opt = getopt (argc, argv, "d:m:n:p:s:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'd':
+        device = optarg;
+        break;
+      case 'm':
+        mem_device = optarg;
+        break;
+      case 'n':
+        edges = strtoul (optarg, NULL, 0);
+        break;
+      case 'p':
+        period_us = strtoul (optarg, NULL, 0);
+        break;
+      case 's':
+        max_subs = atoi (optarg);
+        if (max_subs >= 1 && max_subs <= FANOUT_MAX_SUBS)
+          break;
+        /* fall through */
+      default:
+        printf ("Usage: %s [-d device] [-m mem_device] [-n edges] "
+                "[-p period_us] [-s max_subscribers (1-%d)]\n", argv[0],
+                FANOUT_MAX_SUBS);
+        exit (-1);
+    }
+  }
+
+  /* The control file is not a subscriber: it never reads */
+  fd_ctl = open (device, O_RDONLY | O_NONBLOCK);
+  if (fd_ctl == -1)
+  {
+    printf ("GPIO_FANOUT: Unable to open %s\n", device);
+    exit (-1);
+  }
+  if (gpio_open_memory_map (&gpio_map, mem_device, INT_LATENCY_ADDR) == -1)
+  {
+    printf ("GPIO_FANOUT: Unable to map %s\n", mem_device);
+    exit (-1);
+  }
+  gpio_set_pin (&gpio_map, 0, 0);
+
+  printf ("GPIO_FANOUT: %s, %lu edges every %lu us per step\n\n", device,
+          edges, period_us);
+  printf ("%5s %8s %10s %9s %9s %9s %9s %10s %10s %10s\n", "Subs", "IRQs",
+          "Delivered", "Overruns", "ISR p50", "ISR p99", "ISR max",
+          "Dlv p50", "Dlv p99", "Dlv max");
+  printf ("%5s %8s %10s %9s %9s %9s %9s %10s %10s %10s\n", "", "", "", "",
+          "(ns)", "(ns)", "(ns)", "(us)", "(us)", "(us)");
+  for (num_subs = 1; num_subs <= max_subs; num_subs *= 2)
+  {
+    if (run_step (device, fd_ctl, &gpio_map, num_subs, edges, period_us)
+        == -1)
+      break;
+  }
+
+  gpio_close_memory_map (&gpio_map);
+  close (fd_ctl);
+  return 0;
+}
@@ -11,6 +11,7 @@
 
 /* *************************** INCLUDES *********************************** */
 
+#define _GNU_SOURCE       /* F_SETSIG */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,9 +22,27 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
-#include <math.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
 #include <limits.h>
+#include <ctype.h>
+#include <stdarg.h>
 #include "gpio.h"
+#include "gpio_ring.h"
+#include "histogram.h"
+#include "timing.h"
+#include "trace.h"
+#include "fpga_emu.h"
+#include "rt_profile.h"
+#include "gpio_ctl.h"
+#include "load_gen.h"
+#include "stimulus.h"
+#include "jitter.h"
+#include "gpio_interrupt.h"
 
 /* ******************* MACROS AND TYPE DEFINITIONS ************************* */
 
@@ -37,7 +56,11 @@
 
 #define GPIO_DEVICE       "/dev/gpio_int"
 #define PROC_FS_FILENAME  "/proc/interrupts"
+#define PROC_GPIO_FILENAME "/proc/gpio-interrupt"  /* Driver statistics, N */
 #define MEM_DEVICE        "/dev/mem"
+#define EMU_MEM_FILE      "/dev/shm/gpio_emu"  /* Register file of -e    */
+#define TRACE_MARKER      "/sys/kernel/tracing/trace_marker"
+#define TRACE_MARKER_OLD  "/sys/kernel/debug/tracing/trace_marker"
 #define CSV_FILENAME      "latency.csv"
 
 #define NUM_SETS          1
@@ -45,6 +68,138 @@
 
 #define INT_LATENCY_ADDR  0x43C10000
 
+#define NSEC_PER_SEC      1000000000UL
+#define NSEC_PER_USEC     1000.0
+
+#define GPIO_RT_SIGNAL    (SIGRTMIN + 1)  /* Queued signal set by F_SETSIG */
+#define RT_WAIT_TIMEOUT_S 1               /* Wait limit per sample, any mode */
+#define SPIN_CLOCK_MASK   1023            /* Spins between two clock reads  */
+
+#define GPIO_IRQ_NUMBER   164             /* IRQ line in /proc/interrupts */
+#define WINDOW_SAMPLES    10000           /* Default soak window length   */
+
+#define RT_DEFAULT_PRIO   80              /* SCHED_FIFO priority of -R    */
+#define MAX_MATRIX        8               /* Profiles swept by -X         */
+
+#define MAX_COALESCE      16              /* Settings swept by -B         */
+#define THROUGHPUT_SECS   2               /* Default length of a -B step  */
+#define THROUGHPUT_RATE   10000           /* Default edges per second     */
+#define THROUGHPUT_BATCH  256             /* Records drained per read()   */
+
+#define MAX_LOAD_PROFILES 4               /* Profiles compared by -W      */
+
+#define STIM_QUEUE_SIZE   65536           /* Assert times not matched yet */
+#define STIM_MAX_STEPS    12              /* Offered load doublings of -A */
+#define STIM_SATURATION   0.9             /* Served/offered of saturation */
+
+#define WAIT_TIMED_OUT    (-1)            /* wait_interrupt() results     */
+#define WAIT_STOPPED      (-2)
+
+/*
+ * Latency statistics of one measured interval (e.g. pin assert to user
+ * wake-up). Values are kept in nanoseconds in a log-bucketed histogram, so
+ * memory stays constant whatever the number of samples.
+ */
+typedef struct
+{
+  const char *name;
+  histogram_t hist;
+} latency_stats_t;
+
+/*
+ * One step of the throughput mode (-B): a coalescing setting and what the
+ * consumer measured with it.
+ */
+typedef struct
+{
+  unsigned int count;       /* Notify per count records                   */
+  unsigned int time_us;     /* or after time_us, 0: no time limit         */
+  unsigned long events;     /* Records consumed                           */
+  unsigned long wakeups;    /* Waits that returned records                */
+  uint64_t elapsed_ns;      /* First wait to last wake-up                 */
+  uint64_t cpu_ns;          /* CPU time of the consumer thread            */
+  histogram_t latency;      /* IRQ entry to user, every record            */
+  int failed;               /* Setting refused                            */
+} coalesce_step_t;
+
+/*
+ * One offered load of the stimulus mode (-A) and what was served.
+ */
+typedef struct
+{
+  double offered;           /* Mean offered load of the pattern, edges/s  */
+  unsigned long edges;      /* Edges asserted by the generator            */
+  unsigned long records;    /* Records consumed                           */
+  unsigned long served;     /* Records matched with an assert time        */
+  unsigned long missed;     /* Edges superseded before a record came      */
+  unsigned long backlog;    /* Edges still waiting at the end             */
+  uint64_t elapsed_ns;
+  histogram_t latency;      /* Pin assert to user, queueing included      */
+  histogram_t irq;          /* Pin assert to IRQ entry                    */
+  histogram_t lateness;     /* Generator behind its schedule              */
+  int saturated;
+} stim_step_t;
+
+/*
+ * Pin toggling thread of the stimulus mode. The assert times are passed to
+ * the consumer through a single-producer, single-consumer queue: head is
+ * only written by the generator and tail by the consumer.
+ */
+typedef struct
+{
+  stimulus_t *stim;
+  volatile int stop;
+  unsigned long edges;
+  unsigned long overflows;  /* Assert times the full queue did not take   */
+  histogram_t lateness;
+  uint64_t t_assert[STIM_QUEUE_SIZE];
+  unsigned long head;
+  unsigned long tail;
+  pthread_t thread;
+} stim_generator_t;
+
+/*
+ * Pin toggling thread of the throughput mode.
+ */
+typedef struct
+{
+  unsigned long rate;       /* Edges per second, 0: as fast as possible   */
+  volatile int stop;
+  unsigned long edges;
+  pthread_t thread;
+} edge_generator_t;
+
+/*
+ * How the monitor waits for the interrupt of each sample.
+ */
+typedef enum
+{
+  WAIT_SIGNAL = 0,  /* SIGIO handler sets a flag, main loop spins on it   */
+  WAIT_RING,        /* Busy-poll the head of the mmap'ed event ring       */
+  WAIT_READ,        /* Sleep until readable, then one read() of records   */
+  WAIT_POLL,        /* Sleep in poll(), then read the records             */
+  WAIT_EPOLL,       /* Sleep in epoll_wait(), then read the records       */
+  WAIT_RTSIG,       /* F_SETSIG realtime signal taken with sigtimedwait() */
+  WAIT_EVENTFD,     /* Sleep on the driver's eventfd, then read() it      */
+  NUM_WAIT_MODES
+} wait_mode_t;
+
+/*
+ * Notification accounting of one set. Every sample asserts the pin once, so
+ * a wake-up that finds more than one kernel record stands for interrupts
+ * whose notifications were merged, and a sample that times out without any
+ * notification is a lost interrupt.
+ */
+typedef struct
+{
+  unsigned long wakeups;    /* Notifications taken by the monitor         */
+  unsigned long records;    /* Kernel records consumed                    */
+  unsigned long coalesced;  /* Records beyond the first of each wake-up   */
+  unsigned long lost;       /* Samples that timed out without a wake-up   */
+  unsigned long overflows;  /* Plain SIGIO sent because the RT queue was full */
+} notify_counters_t;
+
+
 /* ************************* FUNCTION PROPOTOTYPES ************************ */
 
 /** @brief The signal handler function
@@ -78,67 +233,1753 @@ update_csv_file (FILE *fp, unsigned long min, unsigned long max);
  *  @param fp It is the file descriptor of the opened/created file.
  *  @return none
  */
-void
-close_csv_file (FILE *fp);
+void
+close_csv_file (FILE *fp);
+
+/** @brief Clears the latency statistics
+ *  @param stats The statistics to be cleared
+ *  @param name The name printed in the report
+ *  @return none
+ */
+void
+stats_reset (latency_stats_t *stats, const char *name);
+
+/** @brief Adds one sample to the latency statistics
+ *  @param stats The statistics to be updated
+ *  @param value_ns The latency sample in nanoseconds
+ *  @return none
+ */
+void
+stats_add (latency_stats_t *stats, unsigned long value_ns);
+
+/** @brief Prints the latency statistics
+ *  @param stats The statistics to be printed
+ *  @return none
+ */
+void
+stats_print (latency_stats_t *stats);
+
+/** @brief Prints one line per wait mode comparing their distributions
+ *  @param mode_hist The total latency histogram of each wait mode
+ *  @param first_mode The first wait mode to be printed
+ *  @param last_mode The last wait mode to be printed
+ *  @return none
+ */
+void
+print_mode_table (histogram_t *mode_hist, wait_mode_t first_mode,
+                  wait_mode_t last_mode);
+
+/** @brief Appends a serialized histogram to a file
+ *  The files can be merged across runs and processes with hist_tool.
+ *  @param filename The name of the file
+ *  @param hist The histogram to be saved
+ *  @return 0 on success, -1 on failure
+ */
+int
+save_histogram (const char *filename, const histogram_t *hist);
+
+/** @brief Reads the kernel record of the last interrupt
+ *  Drains the records queued by the GPIO kernel module and keeps the newest
+ *  one. The device is opened non-blocking so this never waits.
+ *  @param fd The file descriptor of the GPIO device
+ *  @param event Filled with the newest record
+ *  @return The number of records read, 0 if none was available
+ */
+int
+read_last_event (int fd, struct gpio_int_event *event);
+
+/** @brief Enables or disables SIGIO generation on the GPIO device
+ *  @param fd The file descriptor of the GPIO device
+ *  @param on TRUE to set O_ASYNC, FALSE to clear it
+ *  @return 0 on success, -1 on failure
+ */
+int
+set_async_notification (int fd, int on);
+
+/** @brief Sleeps in poll() until a file is readable
+ *  The descriptors stay non-blocking, so read() after it never sleeps.
+ *  @param fd The file descriptor
+ *  @return 0 once readable, WAIT_TIMED_OUT after RT_WAIT_TIMEOUT_S and
+ *  WAIT_STOPPED if SIGINT/SIGHUP asked the monitor to stop
+ */
+int
+wait_readable (int fd);
+
+/** @brief Bounds a busy-wait by RT_WAIT_TIMEOUT_S
+ *  The clock is only read every SPIN_CLOCK_MASK + 1 spins, the first time
+ *  to set the deadline, so a short spin costs no clock read.
+ *  @param spins The spins so far, counting this one
+ *  @param deadline Set on the first clock read
+ *  @return TRUE once the deadline passed
+ */
+int
+spin_timed_out (unsigned long spins, struct timespec *deadline);
+
+/** @brief Arms the notification used by a wait strategy
+ *  Sets O_ASYNC, the F_SETSIG signal and the signal mask for the mode, so
+ *  the other notification paths add no cost during the set.
+ *  @param mode The wait strategy
+ *  @return none
+ */
+void
+set_wait_mode (wait_mode_t mode);
+
+/** @brief Waits for the interrupt of the current sample
+ *  @param mode The wait strategy
+ *  @param t_user Filled with the time the wait returned
+ *  @param event Filled with the newest kernel record
+ *  @param notifications Filled with the number of notifications taken
+ *  @return The number of kernel records consumed, 0 if none (no split),
+ *  WAIT_TIMED_OUT if the wait timed out (lost interrupt) and WAIT_STOPPED if
+ *  SIGINT/SIGHUP asked the monitor to stop
+ */
+int
+wait_interrupt (wait_mode_t mode, timing_stamp_t *t_user,
+                struct gpio_int_event *event, int *notifications);
+
+/** @brief Writes an annotation to the ftrace buffer
+ *  The markers appear in the kernel trace next to the driver tracepoints,
+ *  as "tracing_mark_write: gpio_mon: ...".
+ *  @param fmt printf() format of the annotation
+ *  @return none
+ */
+void
+write_marker (const char *fmt, ...);
+
+/** @brief Arms a wait strategy and clears the statistics of a set or window
+ *  @param mode The wait strategy used for every sample
+ *  @return none
+ */
+void
+begin_set (wait_mode_t mode);
+
+/** @brief Appends one sample to the trace (-f)
+ *  @param found Records found by the wait, or WAIT_TIMED_OUT
+ *  @param event The newest record, if found > 0
+ *  @param t_assert Pin assert time (CLOCK_MONOTONIC)
+ *  @param t_wake User wake-up time (CLOCK_MONOTONIC)
+ *  @return none
+ */
+void
+trace_sample (int found, const struct gpio_int_event *event,
+              uint64_t t_assert, uint64_t t_wake);
+
+/** @brief Measures the latency of one interrupt
+ *  Asserts the pin, waits for the interrupt with the given strategy,
+ *  deasserts the pin and adds the sample to the statistics.
+ *  @param mode The wait strategy
+ *  @return 0 on success, -1 if the monitor was asked to stop
+ */
+int
+measure_sample (wait_mode_t mode);
+
+/** @brief Disarms the wait strategy of a set and stops its load
+ *  @return none
+ */
+void
+end_set (void);
+
+/** @brief Runs one set of NUM_SAMPLES latency measurements
+ *  @param mode The wait strategy used for every sample
+ *  @param run_hist The total latency of the set is merged into it
+ *  @return none
+ */
+void
+run_set (wait_mode_t mode, histogram_t *run_hist);
+
+/** @brief Runs until SIGINT/SIGHUP, printing a summary per window
+ *  The process, the mappings and the armed wait strategy are kept between
+ *  windows, so only the first samples of the run see cold caches.
+ *  @param mode The wait strategy used for every sample
+ *  @param window_samples A window ends after this many samples (0: no limit)
+ *  @param window_secs A window ends after this many seconds (0: no limit)
+ *  @param run_hist The total latency of every window is merged into it
+ *  @param fp The CSV file receiving the min/max of every window
+ *  @return none
+ */
+void
+run_soak (wait_mode_t mode, unsigned long window_samples,
+          unsigned int window_secs, histogram_t *run_hist, FILE *fp);
+
+/** @brief Applies an execution profile to the measurement thread and IRQ
+ *  With the FPGA emulator the emulator thread stands in for the IRQ: it is
+ *  placed on irq_cpu and runs one priority level above the monitor.
+ *  @param profile The profile to apply
+ *  @param desc Filled with the description of the profile
+ *  @param len Size of desc
+ *  @return 0 on success, -1 if a setting could not be applied
+ */
+int
+apply_profile (const rt_profile_t *profile, char *desc, size_t len);
+
+/** @brief Sweeps same-core/cross-core placements and priorities
+ *  One set is run per profile and the latency distributions are tabulated.
+ *  @param mode The wait strategy used for every sample
+ *  @param base The profile giving the measurement CPU
+ *  @return none
+ */
+void
+run_matrix (wait_mode_t mode, const rt_profile_t *base);
+
+/** @brief Runs the wait modes with the hard and the threaded IRQ handler
+ *  The driver is switched with GPIO_IOC_SET_IRQ_MODE before each pass and
+ *  restored afterwards; the latency distributions are tabulated side by
+ *  side. On PREEMPT_RT the hard handler is force-threaded by the kernel
+ *  and is labelled "forced".
+ *  @param first_mode The first wait strategy
+ *  @param last_mode The last wait strategy
+ *  @param saved_irq_mode The IRQ mode restored at the end
+ *  @param preempt_rt TRUE if the driver reports GPIO_FEAT_PREEMPT_RT
+ *  @return none
+ */
+void
+run_irq_modes (wait_mode_t first_mode, wait_mode_t last_mode,
+               unsigned int saved_irq_mode, int preempt_rt);
+
+/** @brief Runs the wait modes under each background load profile
+ *  The load of a profile runs during each of its sets only; the latency
+ *  distributions are tabulated per profile and wait mode.
+ *  @param profiles The load profiles
+ *  @param num_profiles The number of load profiles
+ *  @param first_mode The first wait strategy
+ *  @param last_mode The last wait strategy
+ *  @return none
+ */
+void
+run_load_profiles (load_profile_t *profiles, int num_profiles,
+                   wait_mode_t first_mode, wait_mode_t last_mode);
+
+/** @brief Measures the latency against the offered load of a pattern
+ *  A generator thread asserts the pin at the times drawn from the pattern,
+ *  whatever the consumer is doing, and the consumer matches the records
+ *  with the assert times. The offered load is doubled until the served
+ *  load falls behind it (saturation) and the steps are tabulated.
+ *  @param mode The wait strategy draining the records
+ *  @param stim The arrival pattern
+ *  @param secs Length of each step
+ *  @return none
+ */
+void
+run_stimulus (wait_mode_t mode, stimulus_t *stim, unsigned int secs);
+
+/** @brief Applies a coalescing setting to the driver or the emulator
+ *  @param count Notify once per count records
+ *  @param time_us Or time_us after the first pending one (0: no limit)
+ *  @return 0 on success, -1 on failure
+ */
+int
+set_coalesce (unsigned int count, unsigned int time_us);
+
+/** @brief Parses the coalescing settings of -B, e.g. "1,8,32/100"
+ *  @param arg The comma-separated list of count[/time_us]
+ *  @param steps Filled with the settings
+ *  @return The number of settings, -1 if the list is invalid
+ */
+int
+parse_coalesce_steps (const char *arg, coalesce_step_t *steps);
+
+/** @brief Measures the sustained event rate under coalescing settings
+ *  A thread toggles the pin at the given rate while this thread drains
+ *  every batch with the wait strategy. For each setting the events per
+ *  second, the consumer CPU time per event and the IRQ entry to user
+ *  latency of every record are reported; the latency added by a setting is
+ *  its mean minus that of the first one.
+ *  @param mode The wait strategy: ring, read, poll, epoll or eventfd
+ *  @param steps The coalescing settings
+ *  @param num_steps Number of settings
+ *  @param rate Edges per second, 0: as fast as possible
+ *  @param secs Length of each step
+ *  @return none
+ */
+void
+run_throughput (wait_mode_t mode, coalesce_step_t *steps, int num_steps,
+                unsigned long rate, unsigned int secs);
+
+/** @brief Names the statistics entry of a driver instance
+ *  /dev/gpio_intN reports in /proc/gpio-interruptN; any other name, such as
+ *  the /dev/gpio_int link to instance 0, in /proc/gpio-interrupt.
+ *  @param device The device node
+ *  @param name Filled with the /proc file name
+ *  @param len Size of name
+ *  @return none
+ */
+void
+proc_gpio_name (const char *device, char *name, size_t len);
+
+/** @brief Reads the total count of the GPIO IRQ
+ *  The driver's /proc/gpio-interrupt ("total" line) is used when present,
+ *  otherwise the IRQ line of /proc/interrupts. The file is kept open and
+ *  read again from the start on each call.
+ *  @param fd_proc The opened /proc/gpio-interrupt or /proc/interrupts
+ *  @param count Filled with the sum of the per-CPU counts
+ *  @param print TRUE to print the IRQ line
+ *  @return 0 on success, -1 if the IRQ line was not found
+ */
+int
+read_irq_count (FILE *fd_proc, unsigned long long *count, int print);
+
+/* ******************* STATIC AND GLOBAL VARIABLES  *********************** */
+
+static volatile sig_atomic_t det_int = 0;
+static int num_int = 0;
+static volatile sig_atomic_t KeepRunning = TRUE;
+static FILE *fd_proc = NULL;
+static timing_t timing;
+static timing_stamp_t GPIO_t1;
+static timing_stamp_t GPIO_t2;
+static int fd_gpio = -1;
+static const char *gpio_device = GPIO_DEVICE;  /* /dev/gpio_intN, -d      */
+static unsigned int gpio_irq = GPIO_IRQ_NUMBER; /* As reported by driver */
+static int use_shadow = FALSE;
+static gpio_map_t gpio_map;
+static gpio_ring_t gpio_ring;
+static int fd_epoll = -1;
+static int fd_eventfd = -1;           /* Registered with the driver  */
+static notify_counters_t notify_counters;
+static trace_t trace;                 /* Per-sample trace (-f)       */
+static int use_trace = FALSE;
+static unsigned int set_number;       /* Label of trace checkpoints  */
+static int fd_marker = -1;            /* ftrace trace_marker (-M)    */
+static unsigned long marker_sample;   /* Tag of the sample markers   */
+static fpga_emu_t fpga_emu;           /* Userspace FPGA emulator (-e) */
+static int use_emulator = FALSE;
+static load_profile_t *active_load;   /* Run around each set (-W)    */
+static jitter_t jitter;               /* Counter deltas per sample (-J) */
+static int use_jitter = FALSE;
+static double jitter_percentile;      /* Tail attributed by -J        */
+static const char *wait_mode_name[NUM_WAIT_MODES] =
+  { "signal", "ring", "read", "poll", "epoll", "rtsig", "eventfd" };
+static latency_stats_t total_stats;   /* Pin assert to user wake-up  */
+static latency_stats_t hw_isr_stats;  /* Pin assert to IRQ entry     */
+static latency_stats_t isr_user_stats;/* IRQ entry to user wake-up   */
+
+/* ********************** FUNCTION IMPLEMENTATION ************************* */
+
+/* ============================ Signal Handler ============================ */
+void
+sighandler (int signo)
+{
+  switch (signo)
+    {
+    case SIGIO:
+      {
+        //printf ("GPIO_MONITOR: Interrupt captured by SIGIO\n");
+        GPIO_t2 = timing_read (&timing);
+        // Publish the timestamp before the flag seen by the main loop
+        __atomic_store_n (&det_int, 1, __ATOMIC_RELEASE);
+
+        break;
+      }
+    case SIGHUP:
+    case SIGINT:
+      {
+        KeepRunning = FALSE;
+        break;
+      }
+    }
+  return; /* Return to main loop */
+}
+
+/* ==================== Functions to Handle CSV files ====================== */
+
+FILE*
+create_csv_file (char *filename)
+{
+  FILE *fp = NULL;
+
+  fp = fopen (filename, "a+");
+  return fp;
+
+}
+
+void
+update_csv_file (FILE *fp, unsigned long min, unsigned long max)
+{
+  fprintf (fp, "%lu,%lu\n", min, max);
+}
+
+void
+close_csv_file (FILE *fp)
+{
+  fclose (fp);
+}
+
+/* ====================== Latency Statistics ============================== */
+
+/* Removes the cost of the clock read contained in a measured interval */
+static inline uint64_t
+baseline_corrected (uint64_t latency_ns)
+{
+  if (latency_ns < timing.read_cost_ns)
+    return 0;
+  return latency_ns - timing.read_cost_ns;
+}
+
+void
+stats_reset (latency_stats_t *stats, const char *name)
+{
+  stats->name = name;
+  hist_reset (&stats->hist);
+}
+
+void
+stats_add (latency_stats_t *stats, unsigned long value_ns)
+{
+  hist_add (&stats->hist, value_ns);
+}
+
+void
+stats_print (latency_stats_t *stats)
+{
+  histogram_t *hist = &stats->hist;
+
+  printf ("%s:\n", stats->name);
+  if (hist->count == 0)
+  {
+    printf ("  No samples\n");
+    return;
+  }
+
+  printf ("  Minimum Latency:    %.3fus\n", hist->min / NSEC_PER_USEC);
+  printf ("  Maximum Latency:    %.3fus\n", hist->max / NSEC_PER_USEC);
+  printf ("  Average Latency:    %.3fus\n", hist->mean / NSEC_PER_USEC);
+  printf ("  Standard Deviation: %.3fus\n",
+          hist_std_dev (hist) / NSEC_PER_USEC);
+  printf ("  Percentiles (us):   p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f"
+          "  p99.99 %.3f\n",
+          hist_percentile (hist, 50) / NSEC_PER_USEC,
+          hist_percentile (hist, 90) / NSEC_PER_USEC,
+          hist_percentile (hist, 99) / NSEC_PER_USEC,
+          hist_percentile (hist, 99.9) / NSEC_PER_USEC,
+          hist_percentile (hist, 99.99) / NSEC_PER_USEC);
+  printf ("  Number of samples:  %llu\n", (unsigned long long) hist->count);
+}
+
+void
+print_mode_table (histogram_t *mode_hist, wait_mode_t first_mode,
+                  wait_mode_t last_mode)
+{
+  wait_mode_t mode;
+
+  printf ("\n%-8s %10s %10s %10s %10s %10s %10s %10s\n", "Mode", "Min(us)",
+          "Avg(us)", "p50(us)", "p99(us)", "p99.9(us)", "Max(us)",
+          "StdDev(us)");
+  for (mode = first_mode; mode <= last_mode; mode++)
+  {
+    histogram_t *hist = &mode_hist[mode];
+
+    if (hist->count == 0)
+      continue;
+    printf ("%-8s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+            wait_mode_name[mode],
+            hist->min / NSEC_PER_USEC,
+            hist->mean / NSEC_PER_USEC,
+            hist_percentile (hist, 50) / NSEC_PER_USEC,
+            hist_percentile (hist, 99) / NSEC_PER_USEC,
+            hist_percentile (hist, 99.9) / NSEC_PER_USEC,
+            hist->max / NSEC_PER_USEC,
+            hist_std_dev (hist) / NSEC_PER_USEC);
+  }
+}
+
+int
+save_histogram (const char *filename, const histogram_t *hist)
+{
+  static uint8_t buf[HIST_MAX_SERIALIZED];
+  size_t len = hist_serialize (hist, buf, sizeof(buf));
+  FILE *fp;
+  int rc = 0;
+
+  if (len == 0 || (fp = fopen (filename, "ab")) == NULL)
+    return -1;
+  if (fwrite (buf, 1, len, fp) != len)
+    rc = -1;
+  if (fclose (fp) != 0)
+    rc = -1;
+  return rc;
+}
+
+/* ================== Kernel Interrupt Records ============================ */
+
+int
+read_last_event (int fd, struct gpio_int_event *event)
+{
+  struct gpio_int_event events[32];
+  ssize_t n;
+  int total = 0;
+
+  for (;;)
+  {
+    n = read (fd, events, sizeof(events));
+    if (n <= 0)
+      break;
+    n /= sizeof(struct gpio_int_event);
+    *event = events[n - 1];
+    total += n;
+  }
+  return total;
+}
+
+/* ========================= Wait Strategies ============================== */
+
+int
+set_async_notification (int fd, int on)
+{
+  int flags = fcntl (fd, F_GETFL);
+
+  if (flags == -1)
+    return -1;
+  flags = on ? (flags | O_ASYNC) : (flags & ~O_ASYNC);
+  return fcntl (fd, F_SETFL, flags);
+}
+
+void
+set_wait_mode (wait_mode_t mode)
+{
+  sigset_t rt_set;
+
+  sigemptyset (&rt_set);
+  sigaddset (&rt_set, GPIO_RT_SIGNAL);
+  sigaddset (&rt_set, SIGIO);
+
+  /*
+   * In rtsig mode the signals are blocked and taken synchronously; F_SETSIG
+   * makes kill_fasync() queue one siginfo per interrupt. In the other modes
+   * plain SIGIO goes to the asynchronous handler.
+   */
+  if (mode == WAIT_RTSIG)
+  {
+    sigprocmask (SIG_BLOCK, &rt_set, NULL);
+    fcntl (fd_gpio, F_SETSIG, GPIO_RT_SIGNAL);
+  }
+  else
+  {
+    fcntl (fd_gpio, F_SETSIG, 0);
+    sigprocmask (SIG_UNBLOCK, &rt_set, NULL);
+  }
+  set_async_notification (fd_gpio, mode == WAIT_SIGNAL || mode == WAIT_RTSIG);
+}
+
+int
+wait_readable (int fd)
+{
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  int n;
+
+  do
+  {
+    n = poll (&pfd, 1, RT_WAIT_TIMEOUT_S * 1000);
+  }
+  while (n == -1 && errno == EINTR && KeepRunning);
+  if (!KeepRunning)
+    return WAIT_STOPPED;
+  return n > 0 ? 0 : WAIT_TIMED_OUT;
+}
+
+int
+spin_timed_out (unsigned long spins, struct timespec *deadline)
+{
+  struct timespec now;
+
+  if ((spins & SPIN_CLOCK_MASK) != 0)
+    return FALSE;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  if (spins == SPIN_CLOCK_MASK + 1)
+  {
+    *deadline = now;
+    deadline->tv_sec += RT_WAIT_TIMEOUT_S;
+    return FALSE;
+  }
+  return now.tv_sec > deadline->tv_sec
+      || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+int
+wait_interrupt (wait_mode_t mode, timing_stamp_t *t_user,
+                struct gpio_int_event *event, int *notifications)
+{
+  struct gpio_int_event ev;
+  struct timespec deadline;
+  unsigned long spins = 0;
+  int found = 0, rc;
+
+  /*
+   * Every strategy gives up after RT_WAIT_TIMEOUT_S, so a lost interrupt
+   * is reported as WAIT_TIMED_OUT whatever the mode
+   */
+  *notifications = 1;
+
+  switch (mode)
+  {
+    case WAIT_RING:
+      /* No system call: spin on the ring head written by the handler */
+      while (!gpio_ring_pending (&gpio_ring))
+      {
+        if (!KeepRunning)
+          return WAIT_STOPPED;
+        if (spin_timed_out (++spins, &deadline))
+        {
+          *t_user = timing_read (&timing);
+          return WAIT_TIMED_OUT;
+        }
+      }
+      *t_user = timing_read (&timing);
+      while (gpio_ring_pop (&gpio_ring, &ev))
+      {
+        *event = ev;
+        found++;
+      }
+      break;
+
+    case WAIT_READ:
+      {
+        struct gpio_int_event events[32];
+        ssize_t n;
+
+        /* Sleep until a record, then take it with one read() */
+        rc = wait_readable (fd_gpio);
+        if (rc != 0)
+        {
+          *t_user = timing_read (&timing);
+          return rc;
+        }
+        n = read (fd_gpio, events, sizeof(events));
+        *t_user = timing_read (&timing);
+        if (n > 0)
+        {
+          found = n / sizeof(struct gpio_int_event);
+          *event = events[found - 1];
+        }
+        break;
+      }
+
+    case WAIT_POLL:
+      {
+        rc = wait_readable (fd_gpio);
+        *t_user = timing_read (&timing);
+        if (rc != 0)
+          return rc;
+        found = read_last_event (fd_gpio, event);
+        break;
+      }
+
+    case WAIT_EPOLL:
+      {
+        struct epoll_event epev;
+
+        do
+        {
+          rc = epoll_wait (fd_epoll, &epev, 1, RT_WAIT_TIMEOUT_S * 1000);
+        }
+        while (rc == -1 && errno == EINTR && KeepRunning);
+        *t_user = timing_read (&timing);
+        if (!KeepRunning)
+          return WAIT_STOPPED;
+        if (rc <= 0)
+          return WAIT_TIMED_OUT;
+        found = read_last_event (fd_gpio, event);
+        break;
+      }
+
+    case WAIT_RTSIG:
+      {
+        struct timespec timeout = { RT_WAIT_TIMEOUT_S, 0 };
+        siginfo_t info;
+        sigset_t rt_set;
+        int sig;
+
+        sigemptyset (&rt_set);
+        sigaddset (&rt_set, GPIO_RT_SIGNAL);
+        sigaddset (&rt_set, SIGIO);
+
+        /* Synchronous delivery: no handler runs, the siginfo is dequeued */
+        do
+        {
+          sig = sigtimedwait (&rt_set, &info, &timeout);
+        }
+        while (sig == -1 && errno == EINTR && KeepRunning);
+        *t_user = timing_read (&timing);
+        if (sig == -1)
+          return KeepRunning ? WAIT_TIMED_OUT : WAIT_STOPPED;
+        if (sig == SIGIO)
+          notify_counters.overflows++; // RT queue was full, kernel fell back
+        found = read_last_event (fd_gpio, event);
+
+        /* Take the signals queued for the records read along with this one */
+        timeout.tv_sec = 0;
+        while (*notifications < found
+               && sigtimedwait (&rt_set, &info, &timeout) > 0)
+          (*notifications)++;
+        break;
+      }
+
+    case WAIT_EVENTFD:
+      {
+        uint64_t count;
+        ssize_t n;
+
+        /* The counter holds the notifications since the last read */
+        rc = wait_readable (fd_eventfd);
+        if (rc != 0)
+        {
+          *t_user = timing_read (&timing);
+          return rc;
+        }
+        n = read (fd_eventfd, &count, sizeof(count));
+        *t_user = timing_read (&timing);
+        if (n == -1)
+          return WAIT_TIMED_OUT;
+        *notifications = count;
+        found = read_last_event (fd_gpio, event);
+        break;
+      }
+
+    case WAIT_SIGNAL:
+    default:
+      while (__atomic_load_n (&det_int, __ATOMIC_ACQUIRE) == 0)
+      {
+        if (!KeepRunning)
+          return WAIT_STOPPED;
+        if (spin_timed_out (++spins, &deadline))
+        {
+          *t_user = timing_read (&timing);
+          return WAIT_TIMED_OUT;
+        }
+      }
+      *t_user = GPIO_t2;
+      det_int = 0;
+      found = read_last_event (fd_gpio, event);
+      break;
+  }
+  return found;
+}
+
+/* ========================== Measurement Set ============================= */
+
+void
+write_marker (const char *fmt, ...)
+{
+  char buf[160];
+  va_list args;
+  int len;
+
+  va_start (args, fmt);
+  len = vsnprintf (buf, sizeof(buf), fmt, args);
+  va_end (args);
+  if (len > 0 && write (fd_marker, buf, len) == -1)
+  {
+    printf ("GPIO_MONITOR: Unable to write to trace_marker, markers "
+            "stopped\n");
+    close (fd_marker);
+    fd_marker = -1;
+  }
+}
+
+void
+begin_set (wait_mode_t mode)
+{
+  struct gpio_int_event event;
+
+  stats_reset (&total_stats, "Pin assert to user (total)");
+  stats_reset (&hw_isr_stats, "Pin assert to IRQ entry");
+  stats_reset (&isr_user_stats, "IRQ entry to user");
+
+  /*
+   * Only the selected strategy is armed, so the other paths add no cost.
+   * The records of interrupts that happened before this set are discarded.
+   */
+  read_last_event (fd_gpio, &event);
+  while (gpio_ring_pop (&gpio_ring, &event))
+    ;
+  if (fd_eventfd != -1)
+  {
+    uint64_t count;
+
+    /* Non-blocking: clears the counter */
+    if (read (fd_eventfd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+      printf ("GPIO_MONITOR: Unable to clear the eventfd\n");
+  }
+  set_wait_mode (mode);
+  if (mode == WAIT_RTSIG)
+  {
+    struct timespec no_wait = { 0, 0 };
+    sigset_t rt_set;
+
+    sigemptyset (&rt_set);
+    sigaddset (&rt_set, GPIO_RT_SIGNAL);
+    sigaddset (&rt_set, SIGIO);
+    while (sigtimedwait (&rt_set, NULL, &no_wait) > 0)
+      ;
+  }
+  det_int = 0;
+  memset (&notify_counters, 0, sizeof(notify_counters));
+  if (use_jitter)
+    jit_reset (&jitter);
+
+  /* The load starts last: nothing above is measured under it */
+  if (active_load != NULL && load_start (active_load) == -1)
+    printf ("GPIO_MONITOR: Unable to start the load %s, set run without "
+            "it\n", active_load->name);
+}
+
+void
+trace_sample (int found, const struct gpio_int_event *event,
+              uint64_t t_assert, uint64_t t_wake)
+{
+  trace_record_t record;
+
+  record.t_assert = t_assert;
+  record.t_user = t_wake;
+  record.flags = 0;
+  if (found > 0)
+  {
+    record.t_isr = event->timestamp_ns;
+    record.seq = event->seq;
+    record.cpu = event->cpu;
+    record.flags |= TRACE_FLAG_ISR;
+    if (found > 1)
+      record.flags |= TRACE_FLAG_COALESCED;
+  }
+  else
+  {
+    record.t_isr = 0;
+    record.seq = 0;
+    record.cpu = 0;
+    if (found == WAIT_TIMED_OUT)
+      record.flags |= TRACE_FLAG_LOST;
+  }
+  if (trace_append (&trace, &record) == -1)
+  {
+    printf ("GPIO_MONITOR: Unable to extend the trace, tracing stopped\n");
+    use_trace = FALSE;
+  }
+}
+
+int
+measure_sample (wait_mode_t mode)
+{
+  struct gpio_int_event event;
+  timing_stamp_t t_user;
+  uint64_t latency, t_assert, t_wake;
+  int notifications;
+  int found;
+
+  /* The markers are written outside of the measured interval */
+  marker_sample++;
+  if (fd_marker != -1)
+    write_marker ("gpio_mon: assert sample=%lu", marker_sample);
+
+  /* The counter snapshots surround the sample, outside of its interval */
+  if (use_jitter)
+    jit_begin (&jitter);
+
+  timing_anchor (&timing);
+  GPIO_t1 = timing_read (&timing);
+  if (use_shadow)
+    gpio_shadow_set_bit (&gpio_map, 0);  // Set output pin
+  else
+    gpio_set_pin (&gpio_map, 0, 1);  // Set output pin
+
+  found = wait_interrupt (mode, &t_user, &event, &notifications);
+
+  if (use_shadow)
+    gpio_shadow_clear_bit (&gpio_map, 0);  // Clear output pin
+  else
+    gpio_set_pin (&gpio_map, 0, 0);  // Clear output pin
+
+  if (found == WAIT_STOPPED)
+    return -1;
+  if (use_jitter && found > 0)
+    jit_end (&jitter, marker_sample,
+             baseline_corrected (timing_delta_ns (&timing, GPIO_t1, t_user)),
+             event.cpu);
+  if (fd_marker != -1)
+  {
+    if (found > 0)
+      write_marker ("gpio_mon: wake sample=%lu seq=%u t_assert=%llu "
+                    "t_user=%llu", marker_sample, event.seq,
+                    (unsigned long long) timing_to_monotonic (&timing,
+                                                              GPIO_t1),
+                    (unsigned long long) timing_to_monotonic (&timing,
+                                                              t_user));
+    else
+      write_marker ("gpio_mon: wake sample=%lu %s", marker_sample,
+                    found == WAIT_TIMED_OUT ? "lost" : "no-record");
+  }
+  t_assert = timing_to_monotonic (&timing, GPIO_t1);
+  t_wake = timing_to_monotonic (&timing, t_user);
+
+  /* A lost interrupt has no latency: the wait only gave up at its limit */
+  if (found == WAIT_TIMED_OUT)
+  {
+    notify_counters.lost++;
+    if (use_trace)
+      trace_sample (found, &event, t_assert, t_wake);
+    return 0;
+  }
+  notify_counters.wakeups += notifications;
+  notify_counters.records += found;
+  if (found > notifications)
+    notify_counters.coalesced += found - notifications;
+
+  /*
+   * The measured interval contains one clock read; that calibrated
+   * baseline is removed from the total and from the part ending in user
+   * space, so both parts still add up to the total.
+   */
+  latency = timing_delta_ns (&timing, GPIO_t1, t_user);
+  stats_add (&total_stats, baseline_corrected (latency));
+
+  /*
+   * Split the latency at the IRQ entry timestamp recorded by the kernel
+   * module (CLOCK_MONOTONIC). Samples whose record is missing only count
+   * in the total.
+   */
+  if (found > 0 && event.timestamp_ns >= t_assert
+      && event.timestamp_ns <= t_wake)
+  {
+    stats_add (&hw_isr_stats, event.timestamp_ns - t_assert);
+    stats_add (&isr_user_stats,
+               baseline_corrected (t_wake - event.timestamp_ns));
+  }
+
+  /* Raw timestamps are traced; the reader applies the same baseline */
+  if (use_trace)
+    trace_sample (found, &event, t_assert, t_wake);
+  return 0;
+}
+
+void
+end_set (void)
+{
+  if (active_load != NULL)
+    load_stop (active_load);
+  set_wait_mode (WAIT_SIGNAL);
+  set_async_notification (fd_gpio, FALSE);
+}
+
+void
+run_set (wait_mode_t mode, histogram_t *run_hist)
+{
+  int i;
+
+  begin_set (mode);
+  printf ("GPIO_MONITOR: Wait mode: %s, load: %s\n", wait_mode_name[mode],
+          active_load != NULL ? active_load->name : "none");
+  if (use_trace)
+    trace_checkpoint (&trace, set_number++, mode);
+
+  for (i = 0; i < NUM_SAMPLES; i++)
+  {
+    if (measure_sample (mode) == -1)
+      break;
+  }
+
+  stats_print (&total_stats);
+  stats_print (&hw_isr_stats);
+  stats_print (&isr_user_stats);
+  if (gpio_ring.overruns != 0)
+    printf ("  Ring overruns:      %lu\n", gpio_ring.overruns);
+  printf ("Notifications:\n");
+  printf ("  Wake-ups:           %lu\n", notify_counters.wakeups);
+  printf ("  Kernel records:     %lu\n", notify_counters.records);
+  printf ("  Coalesced:          %lu\n", notify_counters.coalesced);
+  printf ("  Lost (timed out):   %lu\n", notify_counters.lost);
+  if (mode == WAIT_RTSIG)
+    printf ("  RT queue overflows: %lu\n", notify_counters.overflows);
+  if (use_jitter)
+    jit_report (&jitter, jitter_percentile);
+  hist_merge (run_hist, &total_stats.hist);
+  end_set ();
+}
+
+/* ============================ Soak Mode ================================= */
+
+void
+run_soak (wait_mode_t mode, unsigned long window_samples,
+          unsigned int window_secs, histogram_t *run_hist, FILE *fp)
+{
+  unsigned long long irq_start = 0, irq_end = 0;
+  unsigned long window = 0, iterations, lost;
+  struct timespec now, start;
+  double elapsed;
+  histogram_t *hist = &total_stats.hist;
+
+  printf ("GPIO_MONITOR: Soak mode, wait mode %s, load %s, window of %lu "
+          "samples / %us, stop with SIGINT or SIGHUP\n", wait_mode_name[mode],
+          active_load != NULL ? active_load->name : "none", window_samples,
+          window_secs);
+  printf ("%-8s %10s %10s %10s %10s %10s %10s %10s %10s %8s\n", "Window",
+          "Samples", "Rate(/s)", "Min(us)", "p50(us)", "p99(us)",
+          "p99.9(us)", "Max(us)", "IRQ delta", "Lost");
+
+  begin_set (mode);
+  while (KeepRunning)
+  {
+    /* Only the statistics restart: the armed strategy stays warm */
+    stats_reset (&total_stats, "Pin assert to user (total)");
+    stats_reset (&hw_isr_stats, "Pin assert to IRQ entry");
+    stats_reset (&isr_user_stats, "IRQ entry to user");
+    memset (&notify_counters, 0, sizeof(notify_counters));
+    read_irq_count (fd_proc, &irq_start, FALSE);
+    if (use_trace)
+      trace_checkpoint (&trace, set_number++, mode);
+    clock_gettime (CLOCK_MONOTONIC, &start);
+
+    for (iterations = 1, lost = 0; ; iterations++)
+    {
+      if (measure_sample (mode) == -1)
+        break;
+      if (window_samples != 0 && hist->count >= window_samples)
+        break;
+      /*
+       * The clock is only looked at every 64 samples, and after each lost
+       * one, which already took a whole wait timeout
+       */
+      if (window_secs != 0
+          && ((iterations & 63) == 0 || notify_counters.lost != lost))
+      {
+        lost = notify_counters.lost;
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - start.tv_sec >= (time_t) window_secs)
+          break;
+      }
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    read_irq_count (fd_proc, &irq_end, FALSE);
+    elapsed = (now.tv_sec - start.tv_sec)
+        + (now.tv_nsec - start.tv_nsec) / (double) NSEC_PER_SEC;
+    if (hist->count == 0)
+    {
+      /* Stopped before the first sample of the window */
+      if (notify_counters.lost == 0)
+        continue;
+      /* Only lost samples: the window is still reported */
+      printf ("%-8lu %10d %10.1f %10s %10s %10s %10s %10s %10llu %8lu\n",
+              window++, 0, 0.0, "-", "-", "-", "-", "-", irq_end - irq_start,
+              notify_counters.lost);
+      fflush (stdout);
+      continue;
+    }
+
+    printf ("%-8lu %10llu %10.1f %10.3f %10.3f %10.3f %10.3f %10.3f %10llu"
+            " %8lu\n", window++, (unsigned long long) hist->count,
+            elapsed > 0 ? hist->count / elapsed : 0,
+            hist->min / NSEC_PER_USEC,
+            hist_percentile (hist, 50) / NSEC_PER_USEC,
+            hist_percentile (hist, 99) / NSEC_PER_USEC,
+            hist_percentile (hist, 99.9) / NSEC_PER_USEC,
+            hist->max / NSEC_PER_USEC, irq_end - irq_start,
+            notify_counters.lost);
+    fflush (stdout);
+    update_csv_file (fp, hist->min / 1000, hist->max / 1000);
+    fflush (fp);
+    hist_merge (run_hist, hist);
+  }
+  end_set ();
+}
+
+/* ======================= Real-time Profiles ============================= */
+
+int
+apply_profile (const rt_profile_t *profile, char *desc, size_t len)
+{
+  int rc = 0;
+
+  rt_describe (profile, desc, len);
+  if (rt_apply_thread (profile) == -1)
+  {
+    printf ("GPIO_MONITOR: Unable to apply %s to the monitor thread\n", desc);
+    rc = -1;
+  }
+  if (use_emulator)
+  {
+    int priority = profile->priority > 0 ? profile->priority + 1 : 0;
+
+    if (priority > sched_get_priority_max (SCHED_FIFO))
+      priority = sched_get_priority_max (SCHED_FIFO);
+    if (fpga_emu_set_sched (&fpga_emu, profile->irq_cpu, priority) == -1)
+    {
+      printf ("GPIO_MONITOR: Unable to place the FPGA emulator thread\n");
+      rc = -1;
+    }
+  }
+  else if (profile->irq_cpu >= 0
+           && rt_set_irq_cpu (gpio_irq, profile->irq_cpu) == -1)
+  {
+    printf ("GPIO_MONITOR: Unable to route IRQ %u to CPU %d\n",
+            gpio_irq, profile->irq_cpu);
+    rc = -1;
+  }
+  return rc;
+}
+
+void
+run_matrix (wait_mode_t mode, const rt_profile_t *base)
+{
+  static const int priorities[] = { 0, 50, 90 };
+  static histogram_t matrix_hist[MAX_MATRIX];
+  rt_profile_t profiles[MAX_MATRIX];
+  char desc[MAX_MATRIX][64];
+  int failed[MAX_MATRIX];
+  long num_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  int cpu, other, p, cross, n = 0, i;
+
+  /* The monitor stays on one CPU; the IRQ joins it or runs next to it */
+  cpu = base->cpu >= 0 ? base->cpu : (int) num_cpus - 1;
+  other = cpu == 0 ? 1 : 0;
+  for (cross = 0; cross <= (num_cpus > 1 ? 1 : 0); cross++)
+  {
+    for (p = 0; p < (int) (sizeof(priorities) / sizeof(priorities[0])); p++)
+    {
+      profiles[n].priority = priorities[p];
+      profiles[n].cpu = cpu;
+      profiles[n].irq_cpu = cross ? other : cpu;
+      profiles[n].lock_memory = TRUE;
+      n++;
+    }
+  }
+  if (num_cpus == 1)
+    printf ("GPIO_MONITOR: Single CPU, cross-core profiles skipped\n");
+
+  for (i = 0; i < n && KeepRunning; i++)
+  {
+    hist_reset (&matrix_hist[i]);
+    failed[i] = apply_profile (&profiles[i], desc[i], sizeof(desc[i]));
+    printf ("GPIO_MONITOR: Profile: %s\n", desc[i]);
+    run_set (mode, &matrix_hist[i]);
+  }
+  n = i;
+
+  printf ("\n%-40s %10s %10s %10s %10s %10s %10s\n", "Profile", "Min(us)",
+          "p50(us)", "p99(us)", "p99.9(us)", "Max(us)", "StdDev(us)");
+  for (i = 0; i < n; i++)
+  {
+    histogram_t *hist = &matrix_hist[i];
+
+    if (hist->count == 0)
+      continue;
+    printf ("%-40s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f%s\n", desc[i],
+            hist->min / NSEC_PER_USEC,
+            hist_percentile (hist, 50) / NSEC_PER_USEC,
+            hist_percentile (hist, 99) / NSEC_PER_USEC,
+            hist_percentile (hist, 99.9) / NSEC_PER_USEC,
+            hist->max / NSEC_PER_USEC,
+            hist_std_dev (hist) / NSEC_PER_USEC,
+            failed[i] ? " (not applied)" : "");
+  }
+}
+
+/* ========================= IRQ Handler Modes ============================ */
+
+void
+run_irq_modes (wait_mode_t first_mode, wait_mode_t last_mode,
+               unsigned int saved_irq_mode, int preempt_rt)
+{
+  const char *irq_mode_name[] =
+    { preempt_rt ? "forced" : "hard", "threaded" };
+  static histogram_t irq_hist[2][NUM_WAIT_MODES];
+  unsigned int irq_mode;
+  wait_mode_t mode;
+
+  if (preempt_rt)
+    printf ("GPIO_MONITOR: PREEMPT_RT kernel: the hard handler is "
+            "force-threaded (\"forced\"), both handlers run in a thread\n");
+
+  for (irq_mode = GPIO_IRQ_MODE_HARD; irq_mode <= GPIO_IRQ_MODE_THREADED;
+       irq_mode++)
+  {
+    for (mode = first_mode; mode <= last_mode; mode++)
+      hist_reset (&irq_hist[irq_mode][mode]);
+    if (!KeepRunning)
+      continue;
+    if (gpio_ctl_set_irq_mode (fd_gpio, irq_mode) == -1)
+    {
+      printf ("GPIO_MONITOR: Unable to select the %s IRQ handler: %s\n",
+              irq_mode_name[irq_mode], strerror (errno));
+      continue;
+    }
+    printf ("GPIO_MONITOR: IRQ handler: %s\n", irq_mode_name[irq_mode]);
+    for (mode = first_mode; mode <= last_mode && KeepRunning; mode++)
+    {
+      if (mode == WAIT_EVENTFD && fd_eventfd == -1)
+        continue;
+      run_set (mode, &irq_hist[irq_mode][mode]);
+    }
+  }
+  gpio_ctl_set_irq_mode (fd_gpio, saved_irq_mode);
+
+  printf ("\n%-8s %-9s %10s %10s %10s %10s %10s %10s\n", "Mode", "IRQ",
+          "Min(us)", "p50(us)", "p99(us)", "p99.9(us)", "Max(us)",
+          "StdDev(us)");
+  for (mode = first_mode; mode <= last_mode; mode++)
+  {
+    for (irq_mode = GPIO_IRQ_MODE_HARD; irq_mode <= GPIO_IRQ_MODE_THREADED;
+         irq_mode++)
+    {
+      histogram_t *hist = &irq_hist[irq_mode][mode];
+
+      if (hist->count == 0)
+        continue;
+      printf ("%-8s %-9s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+              wait_mode_name[mode], irq_mode_name[irq_mode],
+              hist->min / NSEC_PER_USEC,
+              hist_percentile (hist, 50) / NSEC_PER_USEC,
+              hist_percentile (hist, 99) / NSEC_PER_USEC,
+              hist_percentile (hist, 99.9) / NSEC_PER_USEC,
+              hist->max / NSEC_PER_USEC,
+              hist_std_dev (hist) / NSEC_PER_USEC);
+    }
+  }
+}
+
+/* ======================== Background Load ============================== */
+
+void
+run_load_profiles (load_profile_t *profiles, int num_profiles,
+                   wait_mode_t first_mode, wait_mode_t last_mode)
+{
+  static histogram_t load_hist[MAX_LOAD_PROFILES][NUM_WAIT_MODES];
+  wait_mode_t mode;
+  int p;
+
+  for (p = 0; p < num_profiles; p++)
+  {
+    for (mode = first_mode; mode <= last_mode; mode++)
+      hist_reset (&load_hist[p][mode]);
+    active_load = &profiles[p];
+    for (mode = first_mode; mode <= last_mode && KeepRunning; mode++)
+    {
+      if (mode == WAIT_EVENTFD && fd_eventfd == -1)
+        continue;
+      run_set (mode, &load_hist[p][mode]);
+    }
+  }
+  active_load = NULL;
+
+  printf ("\n%-24s %-8s %10s %10s %10s %10s %10s %10s\n", "Load", "Mode",
+          "Min(us)", "p50(us)", "p99(us)", "p99.9(us)", "Max(us)",
+          "StdDev(us)");
+  for (mode = first_mode; mode <= last_mode; mode++)
+  {
+    for (p = 0; p < num_profiles; p++)
+    {
+      histogram_t *hist = &load_hist[p][mode];
+
+      if (hist->count == 0)
+        continue;
+      printf ("%-24s %-8s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+              profiles[p].name, wait_mode_name[mode],
+              hist->min / NSEC_PER_USEC,
+              hist_percentile (hist, 50) / NSEC_PER_USEC,
+              hist_percentile (hist, 99) / NSEC_PER_USEC,
+              hist_percentile (hist, 99.9) / NSEC_PER_USEC,
+              hist->max / NSEC_PER_USEC,
+              hist_std_dev (hist) / NSEC_PER_USEC);
+    }
+  }
+}
+
+/* ========================== Throughput Mode ============================= */
+
+static uint64_t
+monotonic_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static uint64_t
+thread_cpu_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void
+sleep_until (uint64_t deadline_ns)
+{
+  struct timespec ts;
+
+  ts.tv_sec = deadline_ns / NSEC_PER_SEC;
+  ts.tv_nsec = deadline_ns % NSEC_PER_SEC;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+    ;
+}
+
+/* The pin is high for the first half of each period */
+static void *
+edge_generator (void *arg)
+{
+  edge_generator_t *gen = (edge_generator_t *) arg;
+  uint64_t period = gen->rate ? NSEC_PER_SEC / gen->rate : 0;
+  uint64_t next = monotonic_ns ();
+
+  while (!gen->stop)
+  {
+    if (use_shadow)
+      gpio_shadow_set_bit (&gpio_map, 0);
+    else
+      gpio_set_pin (&gpio_map, 0, 1);
+    if (period != 0)
+      sleep_until (next + period / 2);
+    if (use_shadow)
+      gpio_shadow_clear_bit (&gpio_map, 0);
+    else
+      gpio_set_pin (&gpio_map, 0, 0);
+    gen->edges++;
+    if (period != 0)
+    {
+      next += period;
+      sleep_until (next);
+    }
+  }
+  return NULL;
+}
+
+int
+set_coalesce (unsigned int count, unsigned int time_us)
+{
+  if (use_emulator)
+    return fpga_emu_set_coalesce (&fpga_emu, count, time_us);
+  return gpio_ctl_set_coalesce (fd_gpio, count, time_us);
+}
+
+int
+parse_coalesce_steps (const char *arg, coalesce_step_t *steps)
+{
+  char *end;
+  int n = 0;
+
+  while (*arg != '\0')
+  {
+    if (n == MAX_COALESCE)
+      return -1;
+    memset (&steps[n], 0, sizeof(steps[n]));
+    steps[n].count = strtoul (arg, &end, 0);
+    if (end == arg || steps[n].count == 0)
+      return -1;
+    if (*end == '/')
+      steps[n].time_us = strtoul (end + 1, &end, 0);
+    if (*end == ',')
+      end++;
+    else if (*end != '\0')
+      return -1;
+    arg = end;
+    n++;
+  }
+  return n;
+}
+
+/*
+ * Waits for a batch, returns FALSE if the monitor was asked to stop. The
+ * sleeping waits give up after RT_WAIT_TIMEOUT_S, so the caller looks at
+ * its clock again.
+ */
+static int
+wait_batch (wait_mode_t mode)
+{
+  struct epoll_event epev;
+  uint64_t count;
 
-/* ******************* STATIC AND GLOBAL VARIABLES  *********************** */
+  switch (mode)
+  {
+    case WAIT_RING:
+      while (!gpio_ring_pending (&gpio_ring))
+      {
+        if (!KeepRunning)
+          return FALSE;
+      }
+      break;
+    case WAIT_EPOLL:
+      while (epoll_wait (fd_epoll, &epev, 1, RT_WAIT_TIMEOUT_S * 1000) == -1
+             && errno == EINTR)
+      {
+        if (!KeepRunning)
+          return FALSE;
+      }
+      break;
+    case WAIT_EVENTFD:
+      if (wait_readable (fd_eventfd) == WAIT_STOPPED)
+        return FALSE;
+      /* Clears the counter: the records make the batch */
+      if (read (fd_eventfd, &count, sizeof(count)) == -1 && !KeepRunning)
+        return FALSE;
+      break;
+    default:
+      /* WAIT_READ and WAIT_POLL: the device stays non-blocking */
+      if (wait_readable (fd_gpio) == WAIT_STOPPED)
+        return FALSE;
+      break;
+  }
+  return KeepRunning;
+}
 
-static int det_int = 0;
-static int num_int = 0;
-static int KeepRunning = TRUE;
-static FILE *fd_proc = NULL;
-static struct timeval GPIO_t1;
-static struct timeval GPIO_t2;
-unsigned long buff[NUM_SAMPLES];
+/* Reads the next records without waiting, returns how many */
+static ssize_t
+read_batch (wait_mode_t mode, struct gpio_int_event *events, size_t max)
+{
+  ssize_t n = 0;
 
-/* ********************** FUNCTION IMPLEMENTATION ************************* */
+  if (mode == WAIT_RING)
+  {
+    while ((size_t) n < max && gpio_ring_pop (&gpio_ring, &events[n]))
+      n++;
+    return n;
+  }
+  n = read (fd_gpio, events, max * sizeof(events[0]));
+  return n > 0 ? n / (ssize_t) sizeof(events[0]) : 0;
+}
+
+/* Consumes every available record, returns how many */
+static unsigned long
+drain_batch (wait_mode_t mode, histogram_t *latency)
+{
+  struct gpio_int_event events[THROUGHPUT_BATCH];
+  unsigned long found = 0;
+  uint64_t t_user = 0;
+  ssize_t n, i;
+
+  /* In read mode one read() is the whole batch */
+  do
+  {
+    n = read_batch (mode, events, THROUGHPUT_BATCH);
+    if (n <= 0)
+      break;
+    if (t_user == 0)
+      t_user = monotonic_ns ();
+    for (i = 0; i < n; i++)
+      hist_add (latency, t_user - events[i].timestamp_ns);
+    found += n;
+  }
+  while (mode != WAIT_READ);
+  return found;
+}
 
-/* ============================ Signal Handler ============================ */
 void
-sighandler (int signo)
+run_throughput (wait_mode_t mode, coalesce_step_t *steps, int num_steps,
+                unsigned long rate, unsigned int secs)
 {
-  switch (signo)
+  edge_generator_t gen;
+  coalesce_step_t *step;
+  sigset_t all, saved;
+  uint64_t t_start, t_end, cpu_start, t_wake;
+  double base_mean = 0;
+  unsigned long found;
+  int i;
+
+  printf ("GPIO_MONITOR: Throughput mode, wait mode %s, load %s, %lu "
+          "edges/s, %us per setting\n", wait_mode_name[mode],
+          active_load != NULL ? active_load->name : "none", rate, secs);
+  for (i = 0; i < num_steps && KeepRunning; i++)
+  {
+    step = &steps[i];
+    hist_reset (&step->latency);
+    if (set_coalesce (step->count, step->time_us) == -1)
     {
-    case SIGIO:
-      {
-        //printf ("GPIO_MONITOR: Interrupt captured by SIGIO\n");
-        det_int = 1;
-        gettimeofday (&GPIO_t2, NULL);
+      printf ("GPIO_MONITOR: Coalescing %u/%uus refused: %s\n", step->count,
+              step->time_us, strerror (errno));
+      step->failed = TRUE;
+      continue;
+    }
 
-        break;
-      }
-    case SIGHUP:
-    case SIGINT:
-      {
-        KeepRunning = FALSE;
-        break;
-      }
+    begin_set (mode);
+    memset (&gen, 0, sizeof(gen));
+    gen.rate = rate;
+    /* The generator blocks every signal, so SIGIO stays with this thread */
+    sigfillset (&all);
+    pthread_sigmask (SIG_SETMASK, &all, &saved);
+    if (pthread_create (&gen.thread, NULL, edge_generator, &gen) != 0)
+    {
+      pthread_sigmask (SIG_SETMASK, &saved, NULL);
+      printf ("GPIO_MONITOR: Unable to start the edge generator\n");
+      end_set ();
+      break;
     }
-  return; /* Return to main loop */
+    pthread_sigmask (SIG_SETMASK, &saved, NULL);
+
+    t_start = t_wake = monotonic_ns ();
+    t_end = t_start + (uint64_t) secs * NSEC_PER_SEC;
+    cpu_start = thread_cpu_ns ();
+    while (t_wake < t_end && wait_batch (mode))
+    {
+      found = drain_batch (mode, &step->latency);
+      t_wake = monotonic_ns ();
+      if (found == 0)
+        continue;
+      step->events += found;
+      step->wakeups++;
+    }
+    step->cpu_ns = thread_cpu_ns () - cpu_start;
+    step->elapsed_ns = t_wake - t_start;
+
+    gen.stop = TRUE;
+    pthread_join (gen.thread, NULL);
+    end_set ();
+    printf ("GPIO_MONITOR: Coalescing %u/%uus: %lu edges, %lu events, "
+            "%lu wake-ups\n", step->count, step->time_us, gen.edges,
+            step->events, step->wakeups);
+  }
+
+  printf ("\n%-12s %10s %10s %12s %10s %10s %10s %10s %10s\n", "Coalesce",
+          "Events", "Ev/wake", "Events/s", "CPU/ev(us)", "Mean(us)",
+          "p99(us)", "Max(us)", "Added(us)");
+  for (i = 0; i < num_steps; i++)
+  {
+    char name[24];
+
+    step = &steps[i];
+    if (step->failed || step->events == 0)
+      continue;
+    if (base_mean == 0)
+      base_mean = step->latency.mean;
+    snprintf (name, sizeof(name), "%u/%uus", step->count, step->time_us);
+    printf ("%-12s %10lu %10.1f %12.0f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+            name, step->events, (double) step->events / step->wakeups,
+            step->events * 1e9 / step->elapsed_ns,
+            step->cpu_ns / NSEC_PER_USEC / step->events,
+            step->latency.mean / NSEC_PER_USEC,
+            hist_percentile (&step->latency, 99) / NSEC_PER_USEC,
+            step->latency.max / NSEC_PER_USEC,
+            (step->latency.mean - base_mean) / NSEC_PER_USEC);
+  }
 }
 
-/* ==================== Functions to Handle CSV files ====================== */
+/* =========================== Stimulus Mode ============================== */
 
-FILE*
-create_csv_file (char *filename)
+/* Asserts the pin on the schedule of the pattern, high for half a gap */
+static void *
+stim_generator (void *arg)
 {
-  FILE *fp = NULL;
+  stim_generator_t *gen = (stim_generator_t *) arg;
+  uint64_t next = monotonic_ns (), gap, now;
 
-  fp = fopen (filename, "a+");
-  return fp;
+  while (!gen->stop)
+  {
+    gap = stim_next_gap (gen->stim);
+    sleep_until (next);
+
+    /* Queued before the edge, so its record always finds it */
+    now = monotonic_ns ();
+    if (gen->head - __atomic_load_n (&gen->tail, __ATOMIC_ACQUIRE)
+        < STIM_QUEUE_SIZE)
+    {
+      gen->t_assert[gen->head % STIM_QUEUE_SIZE] = now;
+      __atomic_store_n (&gen->head, gen->head + 1, __ATOMIC_RELEASE);
+    }
+    else
+      gen->overflows++;
+    if (use_shadow)
+      gpio_shadow_set_bit (&gpio_map, 0);
+    else
+      gpio_set_pin (&gpio_map, 0, 1);
+    hist_add (&gen->lateness, now - next);
 
+    /* A late generator catches up: the arrivals keep their schedule */
+    sleep_until (next + gap / 2);
+    if (use_shadow)
+      gpio_shadow_clear_bit (&gpio_map, 0);
+    else
+      gpio_set_pin (&gpio_map, 0, 0);
+    gen->edges++;
+    next += gap;
+  }
+  return NULL;
+}
+
+/*
+ * Matches a record with the latest assert time before its IRQ entry. The
+ * older assert times had no record of their own: their edges were merged
+ * into one interrupt or their records were lost.
+ */
+static void
+stim_match (stim_generator_t *gen, stim_step_t *step,
+            const struct gpio_int_event *event, uint64_t t_user)
+{
+  unsigned long head = __atomic_load_n (&gen->head, __ATOMIC_ACQUIRE);
+  unsigned long tail = gen->tail;
+  uint64_t t_assert = 0;
+  int found = FALSE;
+
+  while (tail != head
+         && gen->t_assert[tail % STIM_QUEUE_SIZE] <= event->timestamp_ns)
+  {
+    if (found)
+      step->missed++;
+    t_assert = gen->t_assert[tail % STIM_QUEUE_SIZE];
+    found = TRUE;
+    tail++;
+  }
+  __atomic_store_n (&gen->tail, tail, __ATOMIC_RELEASE);
+  step->records++;
+  if (!found)
+    return;
+  step->served++;
+  hist_add (&step->latency, t_user - t_assert);
+  hist_add (&step->irq, event->timestamp_ns - t_assert);
 }
 
 void
-update_csv_file (FILE *fp, unsigned long min, unsigned long max)
+run_stimulus (wait_mode_t mode, stimulus_t *stim, unsigned int secs)
 {
-  fprintf (fp, "%lu,%lu\n", min, max);
+  static stim_generator_t gen;
+  static stim_step_t steps[STIM_MAX_STEPS];
+  struct gpio_int_event events[THROUGHPUT_BATCH];
+  stim_step_t *step;
+  sigset_t all, saved;
+  uint64_t t_start, t_end, t_wake;
+  ssize_t n, k;
+  int i, num_steps = 0;
+
+  printf ("GPIO_MONITOR: Stimulus mode, pattern %s, wait mode %s, load %s, "
+          "%us per offered load\n", stim->name, wait_mode_name[mode],
+          active_load != NULL ? active_load->name : "none", secs);
+  for (i = 0; i < STIM_MAX_STEPS && KeepRunning; i++)
+  {
+    step = &steps[i];
+    memset (step, 0, sizeof(*step));
+    hist_reset (&step->latency);
+    hist_reset (&step->irq);
+    stim_reset (stim, (double) (1UL << i));
+    step->offered = stim_rate (stim);
+
+    begin_set (mode);
+    memset (&gen, 0, sizeof(gen));
+    hist_reset (&gen.lateness);
+    gen.stim = stim;
+    /* The generator blocks every signal, so SIGIO stays with this thread */
+    sigfillset (&all);
+    pthread_sigmask (SIG_SETMASK, &all, &saved);
+    if (pthread_create (&gen.thread, NULL, stim_generator, &gen) != 0)
+    {
+      pthread_sigmask (SIG_SETMASK, &saved, NULL);
+      printf ("GPIO_MONITOR: Unable to start the stimulus generator\n");
+      end_set ();
+      break;
+    }
+    pthread_sigmask (SIG_SETMASK, &saved, NULL);
+
+    t_start = t_wake = monotonic_ns ();
+    t_end = t_start + (uint64_t) secs * NSEC_PER_SEC;
+    while (t_wake < t_end && wait_batch (mode))
+    {
+      /* In read mode one read() is the whole batch */
+      do
+      {
+        n = read_batch (mode, events, THROUGHPUT_BATCH);
+        t_wake = monotonic_ns ();
+        for (k = 0; k < n; k++)
+          stim_match (&gen, step, &events[k], t_wake);
+      }
+      while (n > 0 && mode != WAIT_READ);
+    }
+    step->elapsed_ns = t_wake - t_start;
+
+    gen.stop = TRUE;
+    pthread_join (gen.thread, NULL);
+    end_set ();
+    step->edges = gen.edges;
+    step->backlog = gen.head - gen.tail;
+    step->missed += gen.overflows;
+    step->lateness = gen.lateness;
+    step->saturated = step->served * (double) NSEC_PER_SEC / step->elapsed_ns
+        < STIM_SATURATION * step->offered;
+    num_steps++;
+    printf ("GPIO_MONITOR: Offered %.0f/s: %lu edges, %lu records, %lu "
+            "served\n", step->offered, step->edges, step->records,
+            step->served);
+    if (step->saturated)
+      break;
+  }
+
+  printf ("\n%12s %10s %12s %8s %8s %10s %10s %10s %10s %10s %10s\n",
+          "Offered(/s)", "Edges", "Served(/s)", "Missed", "Backlog",
+          "p50(us)", "p99(us)", "p99.9(us)", "Max(us)", "IRQ p99", "Late p99");
+  for (i = 0; i < num_steps; i++)
+  {
+    step = &steps[i];
+    if (step->served == 0)
+    {
+      printf ("%12.0f %10lu %12s %8lu %8lu%s\n", step->offered, step->edges,
+              "0", step->missed, step->backlog, " (saturated)");
+      continue;
+    }
+    printf ("%12.0f %10lu %12.0f %8lu %8lu %10.3f %10.3f %10.3f %10.3f "
+            "%10.3f %10.3f%s\n", step->offered, step->edges,
+            step->served * (double) NSEC_PER_SEC / step->elapsed_ns,
+            step->missed, step->backlog,
+            hist_percentile (&step->latency, 50) / NSEC_PER_USEC,
+            hist_percentile (&step->latency, 99) / NSEC_PER_USEC,
+            hist_percentile (&step->latency, 99.9) / NSEC_PER_USEC,
+            step->latency.max / NSEC_PER_USEC,
+            hist_percentile (&step->irq, 99) / NSEC_PER_USEC,
+            hist_percentile (&step->lateness, 99) / NSEC_PER_USEC,
+            step->saturated ? " (saturated)" : "");
+  }
 }
 
+/* ====================== /proc/interrupts Parsing ======================== */
+
 void
-close_csv_file (FILE *fp)
+proc_gpio_name (const char *device, char *name, size_t len)
 {
-  fclose (fp);
+  size_t n = strlen (device);
+
+  while (n > 0 && isdigit ((unsigned char) device[n - 1]))
+    n--;
+  snprintf (name, len, "%s%s", PROC_GPIO_FILENAME, device + n);
+}
+
+int
+read_irq_count (FILE *fd_proc, unsigned long long *count, int print)
+{
+  static char *line = NULL;
+  static size_t len = 0;
+  unsigned int irq;
+  int found = -1;
+
+  *count = 0;
+  fseek (fd_proc, 0, SEEK_SET);
+  while (getline (&line, &len, fd_proc) != -1)
+  {
+    char *p = line, *end;
+
+    /* Driver statistics: per-CPU lines, then their sum */
+    if (strncmp (line, "total", 5) == 0)
+    {
+      if (print)
+        printf ("%s", line);
+      *count = strtoull (line + 5, NULL, 10);
+      found = 0;
+      break;
+    }
+
+    if (sscanf (line, " %u:", &irq) != 1 || irq != gpio_irq)
+      continue;
+    if (print)
+      printf ("%s", line);
+
+    /* The per-CPU counts follow the "NNN:" column */
+    p = strchr (line, ':') + 1;
+    for (;;)
+    {
+      unsigned long long value = strtoull (p, &end, 10);
+
+      if (end == p)
+        break;
+      *count += value;
+      p = end;
+    }
+    found = 0;
+    break;
+  }
+  clearerr (fd_proc);
+  return found;
 }
 
 /* *************************** MAIN FUNCTION ****************************** */
@@ -150,22 +1991,284 @@ main (int argc, char **argv)
   fd_proc = NULL;
   time_t current_time;
   FILE *fp;
-  int fd;
   int rc;
   int fc;
-  int fd_mem;
-  unsigned long max, min, sum;
-  float avg, std_dev;
-  int set, i;
+  struct gpio_int_info driver_info = { 0 };
+  int opt;
+  char *mem_device = NULL;
+  char proc_filename[64];
+  uint64_t emu_delay_ns = 0, emu_jitter_ns = 0;
+  int run_all_modes = FALSE;
+  wait_mode_t wait_mode = WAIT_SIGNAL;
+  wait_mode_t mode, first_mode, last_mode;
+  static histogram_t mode_hist[NUM_WAIT_MODES];
+  char *hist_filename = NULL;
+  char *trace_filename = NULL;
+  timing_clock_t clock = TIMING_MONOTONIC;
+  int soak = FALSE;
+  unsigned long window_samples = 0;
+  unsigned int window_secs = 0;
+  unsigned long long irq_count;
+  rt_profile_t profile = { 0, -1, -1, FALSE };
+  int use_profile = FALSE, run_matrix_mode = FALSE, run_irq_mode = FALSE;
+  coalesce_step_t coalesce_steps[MAX_COALESCE];
+  int num_coalesce_steps = 0;
+  unsigned long throughput_rate = THROUGHPUT_RATE;
+  char profile_desc[64];
+  static load_profile_t load_profiles[MAX_LOAD_PROFILES];
+  static stimulus_t stim;
+  int use_stimulus = FALSE;
+  int num_load_profiles = 0;
+  char *load_spec;
+  int set;
+
+  /*
+   * Parse the command line. A plain file may be given in place of /dev/mem
+   * so the register accesses can be exercised without the FPGA.
+   */
+  while ((opt = getopt (argc, argv, "A:B:C:cd:e:f:I:J:LMm:n:o:P:Qr:RsT:t:W:Xw:")) != -1)
+  {
+    switch (opt)
+    {
+      case 't':
+        clock = timing_clock_by_name (optarg);  // Timing backend
+        if (clock < NUM_TIMING_CLOCKS)
+          break;
+        printf ("GPIO_MONITOR: Unknown clock %s\n", optarg);
+        exit (-1);
+      case 'P':
+        profile.priority = atoi (optarg);  // SCHED_FIFO priority, 0: OTHER
+        use_profile = TRUE;
+        break;
+      case 'C':
+        profile.cpu = atoi (optarg);  // CPU of the measurement thread
+        use_profile = TRUE;
+        break;
+      case 'I':
+        profile.irq_cpu = atoi (optarg);  // CPU servicing the GPIO IRQ
+        use_profile = TRUE;
+        break;
+      case 'L':
+        profile.lock_memory = TRUE;  // mlockall() and prefault
+        use_profile = TRUE;
+        break;
+      case 'R':
+        use_profile = TRUE;  // Real-time profile with the defaults below
+        profile.lock_memory = TRUE;
+        if (profile.priority == 0)
+          profile.priority = RT_DEFAULT_PRIO;
+        break;
+      case 'X':
+        run_matrix_mode = TRUE;  // Sweep placements and priorities
+        break;
+      case 'Q':
+        run_irq_mode = TRUE;  // Hard and threaded IRQ handler side by side
+        break;
+      case 'B':
+        // Throughput under these coalescing settings, count[/us],...
+        num_coalesce_steps = parse_coalesce_steps (optarg, coalesce_steps);
+        if (num_coalesce_steps > 0)
+          break;
+        printf ("GPIO_MONITOR: Invalid coalescing settings %s\n", optarg);
+        exit (-1);
+      case 'A':
+        // Open-loop stimulus: fixed, poisson, burst or trace arrivals
+        if (stim_parse (&stim, optarg) == 0)
+        {
+          use_stimulus = TRUE;
+          break;
+        }
+        printf ("GPIO_MONITOR: Invalid stimulus pattern %s\n", optarg);
+        exit (-1);
+      case 'r':
+        throughput_rate = strtoul (optarg, NULL, 0);  // Edges/s of -B
+        break;
+      case 'W':
+        // Background load profiles, e.g. none/cpu:2@1,membw
+        for (load_spec = strtok (optarg, "/"); load_spec != NULL;
+             load_spec = strtok (NULL, "/"))
+        {
+          if (num_load_profiles < MAX_LOAD_PROFILES
+              && load_parse (&load_profiles[num_load_profiles],
+                             load_spec) == 0)
+          {
+            num_load_profiles++;
+            continue;
+          }
+          printf ("GPIO_MONITOR: Invalid load profile %s\n", load_spec);
+          exit (-1);
+        }
+        break;
+      case 'c':
+        soak = TRUE;  // Run until SIGINT/SIGHUP in rolling windows
+        break;
+      case 'e':
+        use_emulator = TRUE;  // Userspace FPGA: delay_ns[,jitter_ns]
+        emu_delay_ns = strtoull (optarg, &optarg, 0);
+        if (*optarg == ',')
+          emu_jitter_ns = strtoull (optarg + 1, NULL, 0);
+        break;
+      case 'J':
+        // Counter deltas of the samples above this percentile, e.g. 99
+        jitter_percentile = atof (optarg);
+        if (jitter_percentile > 0 && jitter_percentile < 100)
+        {
+          use_jitter = TRUE;
+          break;
+        }
+        printf ("GPIO_MONITOR: Invalid percentile %s\n", optarg);
+        exit (-1);
+      case 'M':
+        // Sample markers in the ftrace buffer, next to the tracepoints
+        fd_marker = open (TRACE_MARKER, O_WRONLY);
+        if (fd_marker == -1)
+          fd_marker = open (TRACE_MARKER_OLD, O_WRONLY);
+        if (fd_marker != -1)
+          break;
+        printf ("GPIO_MONITOR: Unable to open trace_marker: %s\n",
+                strerror (errno));
+        exit (-1);
+      case 'f':
+        trace_filename = optarg;  // Append every sample to this trace
+        break;
+      case 'n':
+        window_samples = strtoul (optarg, NULL, 0);  // Samples per window
+        break;
+      case 'T':
+        window_secs = strtoul (optarg, NULL, 0);  // Seconds per window
+        break;
+      case 'o':
+        hist_filename = optarg;  // Append the run histograms to this file
+        break;
+      case 'd':
+        gpio_device = optarg;  // Another instance, e.g. /dev/gpio_int1
+        break;
+      case 'm':
+        mem_device = optarg;
+        break;
+      case 's':
+        use_shadow = TRUE;  // Write-only access through the shadow register
+        break;
+      case 'w':
+        if (strcmp (optarg, "all") == 0)
+        {
+          run_all_modes = TRUE;  // Benchmark every wait mode
+          break;
+        }
+        for (wait_mode = 0; wait_mode < NUM_WAIT_MODES; wait_mode++)
+        {
+          if (strcmp (optarg, wait_mode_name[wait_mode]) == 0)
+            break;
+        }
+        if (wait_mode < NUM_WAIT_MODES)
+          break;
+        printf ("GPIO_MONITOR: Unknown wait mode %s\n", optarg);
+        /* fall through */
+      default:
+        printf ("Usage: %s [-c [-n window_samples] [-T window_secs]] "
+                "[-R] [-P fifo_prio] [-C cpu] [-I irq_cpu] [-L] [-X] [-Q] "
+                "[-B count[/us],... [-r edges_per_s]] "
+                "[-A fixed:rate|poisson:rate|burst:rate,on_us,off_us|"
+                "trace:file] "
+                "[-d device] [-e delay_ns[,jitter_ns]] [-f trace_file] [-J percentile] [-M] [-m mem_device] [-o hist_file] [-s] "
+                "[-t mono|mono_raw|cycles] "
+                "[-W kind[:threads][@cpu[-cpu]],.../...] "
+                "[-w signal|ring|read|poll|epoll|rtsig|eventfd|all]\n", argv[0]);
+        exit (-1);
+    }
+  }
+  if ((soak || run_matrix_mode) && run_all_modes)
+  {
+    printf ("GPIO_MONITOR: Soak and matrix modes run a single wait mode\n");
+    exit (-1);
+  }
+  if (run_irq_mode && (soak || run_matrix_mode || use_emulator))
+  {
+    printf ("GPIO_MONITOR: -Q needs the kernel module and excludes -c and -X\n");
+    exit (-1);
+  }
+  if (num_coalesce_steps > 0
+      && (soak || run_matrix_mode || run_irq_mode || run_all_modes
+          || wait_mode == WAIT_SIGNAL || wait_mode == WAIT_RTSIG))
+  {
+    printf ("GPIO_MONITOR: -B drains batches with -w ring, read, poll, epoll "
+            "or eventfd and excludes -c, -X and -Q\n");
+    exit (-1);
+  }
+  if (use_stimulus
+      && (soak || run_matrix_mode || run_irq_mode || run_all_modes
+          || num_coalesce_steps > 0 || wait_mode == WAIT_SIGNAL
+          || wait_mode == WAIT_RTSIG))
+  {
+    printf ("GPIO_MONITOR: -A drains batches with -w ring, read, poll, epoll "
+            "or eventfd and excludes -c, -X, -Q and -B\n");
+    exit (-1);
+  }
+  if (num_load_profiles > 1
+      && (soak || run_matrix_mode || run_irq_mode || num_coalesce_steps > 0
+          || use_stimulus))
+  {
+    printf ("GPIO_MONITOR: Several load profiles (-W a/b) are only compared "
+            "by the measurement sets\n");
+    exit (-1);
+  }
+  if (use_jitter && (soak || num_coalesce_steps > 0 || use_stimulus))
+  {
+    printf ("GPIO_MONITOR: -J attributes the tail of the measurement sets "
+            "and excludes -c, -B and -A\n");
+    exit (-1);
+  }
+  if (num_load_profiles == 1)
+    active_load = &load_profiles[0];
+  if (soak && window_samples == 0 && window_secs == 0)
+    window_samples = WINDOW_SAMPLES;
+  if (mem_device == NULL)
+    mem_device = use_emulator ? EMU_MEM_FILE : MEM_DEVICE;
 
   // Print pid, so that we can send signals from other shells
   printf ("GPIO_MONITOR: Process Id (Pid) is: %d\n", getpid ());
 
+  /*
+   * Select the clock and measure its own cost before any sample is taken.
+   */
+  if (timing_init (&timing, clock) == -1)
+  {
+    printf ("GPIO_MONITOR: Clock %s is not available\n", timing.name);
+    if (clock == TIMING_CYCLES)
+      printf ("GPIO_MONITOR: Enable user access to the cycle counter\n");
+    exit (-1);
+  }
+  printf ("GPIO_MONITOR: Clock %s: resolution %lluns, read cost %lluns "
+          "(min %lluns) subtracted from latencies\n", timing.name,
+          (unsigned long long) timing.resolution_ns,
+          (unsigned long long) timing.read_cost_ns,
+          (unsigned long long) timing.read_cost_min_ns);
+  if (clock == TIMING_CYCLES)
+    printf ("GPIO_MONITOR: Cycle counter period %.4fns\n", timing.ns_per_tick);
+
+  /*
+   * The trace is preallocated and mapped before the measurements start.
+   */
+  if (trace_filename != NULL)
+  {
+    if (trace_create (&trace, trace_filename, timing.name,
+                      timing.read_cost_ns, timing.resolution_ns) == -1)
+    {
+      printf ("GPIO_MONITOR: Unable to open the trace %s\n", trace_filename);
+      exit (-1);
+    }
+    use_trace = TRUE;
+    printf ("GPIO_MONITOR: Tracing every sample to %s\n", trace_filename);
+  }
+
   /*
    * Open /proc filesystem
    */
-  fd_proc = fopen(PROC_FS_FILENAME,"r");
-  if(fp == NULL)
+  proc_gpio_name (gpio_device, proc_filename, sizeof(proc_filename));
+  fd_proc = fopen(proc_filename,"r");
+  if(fd_proc == NULL)
+    fd_proc = fopen(PROC_FS_FILENAME,"r");
+  if(fd_proc == NULL)
   {
     printf("GPIO_MONITOR: Unable to open %s\n", PROC_FS_FILENAME);
     exit(-1);
@@ -190,48 +2293,84 @@ main (int argc, char **argv)
   // Setup the signal handle
   action.sa_handler = sighandler;
 
+  // Block every signal during the handler
+  sigfillset (&action.sa_mask);
+
   // Restart the system call, if at all possible
   action.sa_flags = SA_RESTART;
   if (sigaction (SIGIO, &action, NULL) == -1)
   {
     perror ("Error: cannot handle SIGIO"); // Should not happen
   }
-  /*  if(sigaction(SIGHUP, &action, NULL) == -1)
-   {
-   perror("Error: cannot handle SIGHUP"); // Should not happen
-   }*/
-  /*  if(sigaction(SIGINT, &action, NULL) == -1)
-   {
-   perror("Error: cannot handle SIGINT"); // Should not happen
-   }*/
 
-  // Block every signal during the handler
-  sigfillset (&action.sa_mask);
+  // SIGHUP and SIGINT interrupt blocking waits so the run ends cleanly
+  action.sa_flags = 0;
+  if(sigaction(SIGHUP, &action, NULL) == -1)
+  {
+    perror("Error: cannot handle SIGHUP"); // Should not happen
+  }
+  if(sigaction(SIGINT, &action, NULL) == -1)
+  {
+    perror("Error: cannot handle SIGINT"); // Should not happen
+  }
 
   /*
    * Opening the gpio device that was created by the command
-   * mknod /dev/gpio_int c 243 0 during the kernel module development
+   * mknod /dev/gpio_int c 243 0 during the kernel module development.
+   * With -e the emulator's pipe stands in for it and no module is needed.
    */
-  fd = open (GPIO_DEVICE, O_RDWR);
-
-  if (fd == -1)
+  if (use_emulator)
   {
-    printf ("GPIO_MONITOR: Unable to open %s\n", GPIO_DEVICE);
-    rc = fd;
-    exit (-1);
+    if (fpga_emu_start (&fpga_emu, mem_device, INT_LATENCY_ADDR,
+                        emu_delay_ns, emu_jitter_ns) == -1)
+    {
+      printf ("GPIO_MONITOR: Unable to start the FPGA emulator on %s\n",
+              mem_device);
+      exit (-1);
+    }
+    fd_gpio = fpga_emu.fd;
+    printf ("GPIO_MONITOR: FPGA emulator on %s, delay %lluns, jitter %lluns\n",
+            mem_device, (unsigned long long) emu_delay_ns,
+            (unsigned long long) emu_jitter_ns);
+  }
+  else
+  {
+    fd_gpio = open (gpio_device, O_RDWR | O_NONBLOCK);
+
+    if (fd_gpio == -1)
+    {
+      printf ("GPIO_MONITOR: Unable to open %s\n", gpio_device);
+      exit (-1);
+    }
+    printf ("GPIO_MONITOR: %s opened successfully\n", gpio_device);
+
+    /* Drivers without the control plane answer ENOTTY and are used as is */
+    if (gpio_ctl_info (fd_gpio, &driver_info) == 0)
+    {
+      printf ("GPIO_MONITOR: Driver %u.%u, IRQ %u (%s), coalesce %u%s\n",
+              driver_info.version >> 8, driver_info.version & 0xff,
+              driver_info.irq, gpio_ctl_trigger_name (driver_info.trigger),
+              driver_info.coalesce_count,
+              driver_info.features & GPIO_FEAT_SIMULATION
+                  ? ", simulation" : "");
+      if (driver_info.irq != 0)
+        gpio_irq = driver_info.irq;
+      if (driver_info.notify != GPIO_NOTIFY_ALL
+          || driver_info.coalesce_count != 1)
+        printf ("GPIO_MONITOR: Warning: notifications are masked or "
+                "coalesced, some wait modes will time out\n");
+    }
   }
-  printf ("GPIO_MONITOR: %s opened successfully\n", GPIO_DEVICE);
 
   /*
    * Now, The process associated with the opened GPIO device is configured to
    * owner of the device and handle the SIG_GPIO signals.
    */
-  fc = fcntl (fd, F_SETOWN, getpid ());
+  fc = fcntl (fd_gpio, F_SETOWN, getpid ());
 
   if (fc == -1)
   {
     printf ("GPIO_MONITOR: SETOWN failed\n");
-    rc = fd;
     exit (-1);
   }
   printf ("GPIO_MONITOR: SETOWN configured successfully\n");
@@ -241,105 +2380,208 @@ main (int argc, char **argv)
    * It obtains the current file status and append the flag O_ASYNC to enable
    * the generation of signals through the opened device.
    */
-  fc = fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_ASYNC);
+  fc = set_async_notification (fd_gpio, TRUE);
 
   if (fc == -1)
   {
     printf ("GPIO_MONITOR: SETFL failed\n");
-    rc = fd;
     exit (-1);
   }
   printf ("GPIO_MONITOR: SETFL configured successfully\n");
 
-  fd_mem = gpio_open_memory_map(MEM_DEVICE);
-  if (fd_mem == -1)
+  /*
+   * Map the event ring written by the kernel interrupt handler.
+   */
+  if (use_emulator)
+  {
+    gpio_ring_attach (&gpio_ring, fpga_emu.ring);
+    rc = 0;
+  }
+  else
+    rc = gpio_ring_map (&gpio_ring, fd_gpio);
+  if (rc == -1)
+  {
+    printf ("GPIO_MONITOR: Unable to map the event ring of %s\n", gpio_device);
+    exit (-1);
+  }
+  printf ("GPIO_MONITOR: Event ring mapped successfully\n");
+
+  /*
+   * The epoll instance watching the GPIO device is created once, so
+   * epoll_wait() is the only system call on the hot path in that mode.
+   */
+  fd_epoll = epoll_create1 (0);
+  if (fd_epoll != -1)
+  {
+    struct epoll_event epev = { .events = EPOLLIN, .data.fd = fd_gpio };
+
+    if (epoll_ctl (fd_epoll, EPOLL_CTL_ADD, fd_gpio, &epev) == -1)
+    {
+      close (fd_epoll);
+      fd_epoll = -1;
+    }
+  }
+  if (fd_epoll == -1)
   {
-    printf ("GPIO_MONITOR: Unable to open %s.  Ensure it exists (major=1, minor=1)\n", MEM_DEVICE);
+    printf ("GPIO_MONITOR: Unable to create the epoll instance\n");
     exit (-1);
   }
-  printf ("GPIO_MONITOR: Memory Map %s opened successfully\n", MEM_DEVICE);
 
   /*
-   * This while loop emulates a program running the main loop i.e. sleep().
-   * The main loop is interrupted when the Linux SIG_GPIO signal is received
+   * The eventfd signalled on each notification. A driver without the
+   * control plane refuses it and the eventfd mode is then unavailable.
    */
-  KeepRunning = TRUE;
-  rc = gpio_set_pin (fd_mem, INT_LATENCY_ADDR, 0, 0);  // Clear output pin
-  if (rc != 0)
+  fd_eventfd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fd_eventfd != -1)
   {
-    perror ("gpio_set_pin() failed");
-    return -1;
+    if (use_emulator)
+      fpga_emu.efd = fd_eventfd;
+    else if (gpio_ctl_set_eventfd (fd_gpio, fd_eventfd) == -1)
+    {
+      close (fd_eventfd);
+      fd_eventfd = -1;
+    }
+  }
+  if (fd_eventfd == -1)
+  {
+    printf ("GPIO_MONITOR: No eventfd notification, eventfd mode unavailable\n");
+    if (wait_mode == WAIT_EVENTFD && !run_all_modes)
+      exit (-1);
   }
 
-  for (set = 0; set < NUM_SETS; set++)
+  rc = gpio_open_memory_map (&gpio_map, mem_device, INT_LATENCY_ADDR);
+  if (rc == -1)
   {
-    max = 0;
-    min = ULONG_MAX;
-    sum = 0;
-    avg = 0;
-    std_dev = 0;
-    int hi = 1;
-    int lo = 0;
+    printf ("GPIO_MONITOR: Unable to map %s.  Ensure it exists (major=1, minor=1)\n", mem_device);
+    exit (-1);
+  }
+  printf ("GPIO_MONITOR: Memory Map %s opened successfully\n", mem_device);
 
-    for (i = 0; i < NUM_SAMPLES; i++)
+  /*
+   * The attribution sources are opened by the measurement thread, whose
+   * counters they read, before the memory is locked.
+   */
+  if (use_jitter)
+  {
+    if (jit_open (&jitter, NUM_SAMPLES, gpio_irq) == -1)
     {
-      gettimeofday (&GPIO_t1, NULL);
-      rc = gpio_set_pin (fd_mem, INT_LATENCY_ADDR, 0, 1);  // Set output pin
-      if (rc != 0)
-      {
-        perror ("gpio_set_pin() failed");
-        return -1;
-      }
+      printf ("GPIO_MONITOR: Unable to allocate the jitter attribution\n");
+      exit (-1);
+    }
+    printf ("GPIO_MONITOR: Jitter attribution above p%g: getrusage%s, "
+            "%d perf counters\n", jitter_percentile,
+            jitter.fd_irq != -1 ? ", /proc/interrupts" : "", jitter.num_perf);
+  }
 
-      while (det_int == 0) ;
-      rc = gpio_set_pin (fd_mem, INT_LATENCY_ADDR, 0, 0);  // Clear output pin
-      if (rc != 0)
-      {
-        perror ("gpio_set_pin() failed");
-        return -1;
-      }
+  /*
+   * The real-time profile is applied last, once every page the measurement
+   * loop touches exists, so mlockall() locks them all.
+   */
+  if (profile.lock_memory || run_matrix_mode)
+  {
+    if (rt_lock_memory () == -1)
+      printf ("GPIO_MONITOR: Unable to lock the memory\n");
+    else
+      printf ("GPIO_MONITOR: Memory locked and prefaulted\n");
+  }
+  if (use_profile && !run_matrix_mode)
+  {
+    apply_profile (&profile, profile_desc, sizeof(profile_desc));
+    printf ("GPIO_MONITOR: Profile: %s\n", profile_desc);
+  }
 
-      unsigned long diff = (GPIO_t2.tv_sec - GPIO_t1.tv_sec) * 1000000
-          + (GPIO_t2.tv_usec - GPIO_t1.tv_usec);
-      buff[i] = diff;
-      sum += diff;
-      if (max < diff)
-        max = diff;
-      if (min > diff)
-        min = diff;
-      det_int = 0;
-    }
+  /*
+   * This while loop emulates a program running the main loop i.e. sleep().
+   * The main loop is interrupted when the Linux SIG_GPIO signal is received
+   */
+  KeepRunning = TRUE;
+  gpio_set_pin (&gpio_map, 0, 0);  // Clear output pin
+
+  first_mode = run_all_modes ? 0 : wait_mode;
+  last_mode = run_all_modes ? NUM_WAIT_MODES - 1 : wait_mode;
+
+  for (mode = 0; mode < NUM_WAIT_MODES; mode++)
+    hist_reset (&mode_hist[mode]);
+
+  if (soak)
+    run_soak (wait_mode, window_samples, window_secs, &mode_hist[wait_mode],
+              fp);
+  if (run_matrix_mode)
+    run_matrix (wait_mode, &profile);
+  if (run_irq_mode)
+    run_irq_modes (first_mode, last_mode, driver_info.irq_mode,
+                   (driver_info.features & GPIO_FEAT_PREEMPT_RT) != 0);
+  if (num_coalesce_steps > 0)
+  {
+    run_throughput (wait_mode, coalesce_steps, num_coalesce_steps,
+                    throughput_rate, window_secs ? window_secs
+                                                 : THROUGHPUT_SECS);
+    if (use_emulator)
+      set_coalesce (1, 0);
+    else
+      set_coalesce (driver_info.coalesce_count ? driver_info.coalesce_count
+                                               : 1, driver_info.coalesce_us);
+  }
+  if (use_stimulus)
+  {
+    run_stimulus (wait_mode, &stim, window_secs ? window_secs
+                                                : THROUGHPUT_SECS);
+    stim_free (&stim);
+  }
 
-    avg = sum / NUM_SAMPLES;
-    for (i = 0; i < NUM_SAMPLES; i++)
+  if (num_load_profiles > 1)
+    run_load_profiles (load_profiles, num_load_profiles, first_mode,
+                       last_mode);
+
+  for (set = 0; set < NUM_SETS && !soak && !run_matrix_mode && !run_irq_mode
+       && num_coalesce_steps == 0 && num_load_profiles <= 1 && !use_stimulus
+       && KeepRunning;
+       set++)
+  {
+    for (mode = first_mode; mode <= last_mode && KeepRunning; mode++)
     {
-      std_dev += pow (buff[i] - avg, 2);
+      if (mode == WAIT_EVENTFD && fd_eventfd == -1)
+        continue;
+      run_set (mode, &mode_hist[mode]);
     }
-    std_dev = sqrt (std_dev / NUM_SAMPLES);
-
-    printf ("Minimum Latency:    %luus\n", min);
-    printf ("Maximum Latency:    %luus\n", max);
-    printf ("Average Latency:    %fus\n", avg);
-    printf ("Standard Deviation: %fus\n", std_dev);
-    printf ("Number of samples: %d\n", NUM_SAMPLES);
-
-    char * line = NULL;
-    size_t len = 0;
-    ssize_t read;
-    int num_line = 0;
-    while ((read = getline (&line, &len, fd_proc)) != -1)
+
+    read_irq_count (fd_proc, &irq_count, TRUE);
+    update_csv_file (fp, total_stats.hist.min / 1000,
+                     total_stats.hist.max / 1000);
+
+    if (run_all_modes)
+      print_mode_table (mode_hist, first_mode, last_mode);
+  }
+
+  /*
+   * The histograms of the whole run (all sets) are saved for later merging.
+   */
+  if (hist_filename != NULL)
+  {
+    for (mode = first_mode; mode <= last_mode; mode++)
     {
-      if (line[0] == '1' && line[1] == '6' && line[2] == '4')
-        printf ("%s", line);
-      num_line++;
+      if (save_histogram (hist_filename, &mode_hist[mode]) == -1)
+        printf ("GPIO_MONITOR: Unable to save the histogram to %s\n",
+                hist_filename);
     }
-    fseek(fd_proc, 0, SEEK_SET);
-    update_csv_file (fp, min, max);
-
   }
-  gpio_close_memory_map(fd_mem);
+  if (trace_filename != NULL)
+    trace_close (&trace);
+  if (fd_marker != -1)
+    close (fd_marker);
+  if (use_jitter)
+    jit_close (&jitter);
+  rt_restore_irq (gpio_irq);
+  gpio_close_memory_map (&gpio_map);
+  gpio_ring_unmap (&gpio_ring);
+  close (fd_epoll);
+  if (fd_eventfd != -1)
+    close (fd_eventfd);
+  if (use_emulator)
+    fpga_emu_stop (&fpga_emu);
+  else
+    close (fd_gpio);
   fclose (fd_proc);
   close_csv_file (fp);
   printf ("\nGPIO_MONITOR: Monitoring GPIO interrupt has finished.\n");
 }
-
@@ -0,0 +1,445 @@
+/*
+ ============================================================================
+ Name        : gpio_multichan.c
+ Author      : Advanced MCU - Spring 2018 - Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Multi-channel benchmark of the GPIO kernel module. A channel
+ is one int_latency core: its device node, its register and its IRQ. With
+ 1, 2, 4 ... channels active at once, one worker thread per channel toggles
+ its own trigger and waits for its own interrupt, back to back, and the
+ per-channel and aggregate latency and throughput are tabulated.
+ ============================================================================
+ */
+
+/* *************************** INCLUDES *********************************** */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "gpio.h"
+#include "histogram.h"
+#include "timing.h"
+#include "fpga_emu.h"
+#include "gpio_interrupt.h"
+
+/* ******************* MACROS AND TYPE DEFINITIONS ************************* */
+
+#define GPIO_DEVICE       "/dev/gpio_int0"
+#define MEM_DEVICE        "/dev/mem"
+#define EMU_MEM_FILE      "/dev/shm/gpio_emu"  /* .N appended per channel  */
+#define INT_LATENCY_ADDR  0x43C10000
+
+#define MAX_CHANNELS      8         /* One per int_latency core           */
+#define CHAN_STEP_SECS    2         /* Length of each step of the sweep   */
+#define CHAN_TIMEOUT_MS   1000      /* A sample is lost after this long   */
+#define CHAN_BATCH        32        /* Records per read()                 */
+
+#define NSEC_PER_SEC      1000000000ULL
+#define NSEC_PER_USEC     1000.0
+
+/*
+ * One channel and its worker. Everything but the published counters is
+ * only touched by the worker while it runs; the main thread reads the
+ * histograms after pthread_join(). The counters are published with release
+ * stores, so they can be read at the end of a step without any lock. Each
+ * channel starts on its own cache lines.
+ */
+typedef struct
+{
+  char device[64];          /* Device node, or emuN with -e              */
+  char mem_device[64];      /* Where its register is mapped from         */
+  unsigned int addr;        /* Register address                          */
+  int fd;                   /* Its own open file, its own read() cursor  */
+  gpio_map_t map;           /* Its own mapping of its register           */
+  fpga_emu_t *emu;          /* Emulated core with -e, NULL otherwise     */
+  timing_t timing;          /* Its own clock anchor and baseline         */
+  pthread_t thread;
+  histogram_t latency;      /* Pin assert to worker wake-up              */
+  histogram_t hw_isr;       /* Pin assert to IRQ entry                   */
+  unsigned long samples;    /* Published: completed samples              */
+  unsigned long lost;       /* Published: samples that timed out         */
+} __attribute__((aligned(64))) channel_t;
+
+/* ******************* STATIC AND GLOBAL VARIABLES  *********************** */
+
+static channel_t channels[MAX_CHANNELS];
+static fpga_emu_t emus[MAX_CHANNELS];
+static volatile int stop_workers = 0;
+
+/* ********************** FUNCTION IMPLEMENTATION ************************* */
+
+static uint64_t
+monotonic_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* Keeps the newest record available on the channel's file */
+static int
+read_last_event (int fd, struct gpio_int_event *event)
+{
+  struct gpio_int_event events[CHAN_BATCH];
+  ssize_t n;
+  int found = 0;
+
+  while ((n = read (fd, events, sizeof(events))) > 0)
+  {
+    n /= sizeof(events[0]);
+    *event = events[n - 1];
+    found += n;
+  }
+  return found;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * The worker of a channel: asserts the trigger, waits for the interrupt on
+ * its own file, deasserts the trigger, until the stop flag is set. The
+ * trigger is written through the shadow register with atomic bit updates,
+ * so the other bits of the register are never read back nor clobbered.
+ *
+ */
+
+static void *
+channel_worker (void *arg)
+{
+  channel_t *chan = (channel_t *) arg;
+  struct pollfd pfd = { .fd = chan->fd, .events = POLLIN };
+  struct gpio_int_event event;
+  timing_stamp_t t1, t2;
+  uint64_t latency, t_assert, t_wake;
+  unsigned long samples = 0, lost = 0;
+  int ready;
+
+  while (!stop_workers)
+  {
+    timing_anchor (&chan->timing);
+    t1 = timing_read (&chan->timing);
+    gpio_shadow_set_bit (&chan->map, 0);
+    ready = poll (&pfd, 1, CHAN_TIMEOUT_MS);
+    t2 = timing_read (&chan->timing);
+    gpio_shadow_clear_bit (&chan->map, 0);
+
+    if (ready <= 0 || read_last_event (chan->fd, &event) == 0)
+    {
+      __atomic_store_n (&chan->lost, ++lost, __ATOMIC_RELEASE);
+      continue;
+    }
+
+    latency = timing_delta_ns (&chan->timing, t1, t2);
+    hist_add (&chan->latency, latency > chan->timing.read_cost_ns
+                              ? latency - chan->timing.read_cost_ns : 0);
+    t_assert = timing_to_monotonic (&chan->timing, t1);
+    t_wake = timing_to_monotonic (&chan->timing, t2);
+    if (event.timestamp_ns >= t_assert && event.timestamp_ns <= t_wake)
+      hist_add (&chan->hw_isr, event.timestamp_ns - t_assert);
+    __atomic_store_n (&chan->samples, ++samples, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Opens the file (the pipe of its emulated core with -e) and maps the
+ * register of a channel. It returns 0 on success and -1 on failure.
+ *
+ */
+
+static int
+channel_open (channel_t *chan, timing_clock_t clock)
+{
+  if (timing_init (&chan->timing, clock) == -1)
+  {
+    printf ("GPIO_MULTICHAN: Clock %s is not available\n", chan->timing.name);
+    return -1;
+  }
+  if (chan->emu != NULL)
+  {
+    chan->fd = chan->emu->fd;
+  }
+  else
+  {
+    chan->fd = open (chan->device, O_RDONLY | O_NONBLOCK);
+    if (chan->fd == -1)
+    {
+      printf ("GPIO_MULTICHAN: Unable to open %s: %s\n", chan->device,
+              strerror (errno));
+      return -1;
+    }
+  }
+  if (gpio_open_memory_map (&chan->map, chan->mem_device, chan->addr) == -1)
+  {
+    printf ("GPIO_MULTICHAN: Unable to map %s\n", chan->mem_device);
+    if (chan->emu == NULL)
+      close (chan->fd);
+    return -1;
+  }
+  gpio_shadow_clear_bit (&chan->map, 0);
+  return 0;
+}
+
+/* Prints one line of the table */
+static void
+print_row (int num_chans, const char *name, const histogram_t *latency,
+           const histogram_t *hw_isr, unsigned long samples,
+           unsigned long lost, double elapsed)
+{
+  if (latency->count == 0)
+  {
+    printf ("%5d %-16s %10lu %10s %10s %10s %10s %10s %10s %8lu\n", num_chans,
+            name, samples, "-", "-", "-", "-", "-", "-", lost);
+    return;
+  }
+  printf ("%5d %-16s %10lu %10.1f %10.3f %10.3f %10.3f %10.3f %10.3f %8lu\n",
+          num_chans, name, samples, samples / elapsed,
+          hist_percentile (latency, 50) / NSEC_PER_USEC,
+          hist_percentile (latency, 99) / NSEC_PER_USEC,
+          hist_percentile (latency, 99.9) / NSEC_PER_USEC,
+          latency->max / NSEC_PER_USEC,
+          hw_isr->count ? hist_percentile (hw_isr, 99) / NSEC_PER_USEC : 0,
+          lost);
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * One step of the sweep: channels 0..num_chans-1 run for secs seconds.
+ *
+ */
+
+static int
+run_step (int num_chans, unsigned int secs)
+{
+  static histogram_t all_latency, all_hw_isr;
+  unsigned long samples[MAX_CHANNELS], lost[MAX_CHANNELS];
+  unsigned long all_samples = 0, all_lost = 0;
+  struct gpio_int_event stale;
+  struct timespec period;
+  uint64_t t_start;
+  double elapsed;
+  int i, started = 0;
+
+  hist_reset (&all_latency);
+  hist_reset (&all_hw_isr);
+  stop_workers = 0;
+  for (i = 0; i < num_chans; i++)
+  {
+    channel_t *chan = &channels[i];
+
+    hist_reset (&chan->latency);
+    hist_reset (&chan->hw_isr);
+    chan->samples = chan->lost = 0;
+    read_last_event (chan->fd, &stale);  // Records of earlier steps
+    if (pthread_create (&chan->thread, NULL, channel_worker, chan) != 0)
+    {
+      printf ("GPIO_MULTICHAN: Unable to start the worker of %s\n",
+              chan->device);
+      break;
+    }
+    started++;
+  }
+
+  t_start = monotonic_ns ();
+  if (started == num_chans)
+  {
+    period.tv_sec = secs;
+    period.tv_nsec = 0;
+    while (nanosleep (&period, &period) == -1 && errno == EINTR)
+      ;
+  }
+
+  /* The counters at the deadline give the rates; later samples are dropped */
+  elapsed = (monotonic_ns () - t_start) / (double) NSEC_PER_SEC;
+  for (i = 0; i < started; i++)
+  {
+    samples[i] = __atomic_load_n (&channels[i].samples, __ATOMIC_ACQUIRE);
+    lost[i] = __atomic_load_n (&channels[i].lost, __ATOMIC_ACQUIRE);
+  }
+  stop_workers = 1;
+  for (i = 0; i < started; i++)
+    pthread_join (channels[i].thread, NULL);
+  if (started != num_chans)
+    return -1;
+
+  for (i = 0; i < num_chans; i++)
+  {
+    print_row (num_chans, channels[i].device, &channels[i].latency,
+               &channels[i].hw_isr, samples[i], lost[i], elapsed);
+    hist_merge (&all_latency, &channels[i].latency);
+    hist_merge (&all_hw_isr, &channels[i].hw_isr);
+    all_samples += samples[i];
+    all_lost += lost[i];
+  }
+  if (num_chans > 1)
+    print_row (num_chans, "all", &all_latency, &all_hw_isr, all_samples,
+               all_lost, elapsed);
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Parses the channel list, device[@addr],... It returns the number of
+ * channels, or -1 if the list is invalid.
+ *
+ */
+
+static int
+parse_channels (char *list, const char *mem_device, int sim)
+{
+  char *item, *at, *end;
+  int n = 0, i;
+
+  for (item = strtok (list, ","); item != NULL; item = strtok (NULL, ","))
+  {
+    if (n == MAX_CHANNELS)
+      return -1;
+    channels[n].addr = INT_LATENCY_ADDR;
+    if ((at = strchr (item, '@')) != NULL)
+    {
+      *at++ = '\0';
+      channels[n].addr = strtoul (at, &end, 0);
+      if (end == at || *end != '\0')
+        return -1;
+    }
+    snprintf (channels[n].device, sizeof(channels[n].device), "%s", item);
+    /* The simulation module maps each register through its own node */
+    snprintf (channels[n].mem_device, sizeof(channels[n].mem_device), "%s",
+              sim ? item : mem_device);
+
+    /* Two channels on one trigger would take each other's interrupts */
+    for (i = 0; i < n; i++)
+    {
+      if (strcmp (channels[i].mem_device, channels[n].mem_device) == 0
+          && channels[i].addr == channels[n].addr)
+        return -1;
+    }
+    n++;
+  }
+  return n;
+}
+
+/* *************************** MAIN FUNCTION ****************************** */
+
+int
+main (int argc, char **argv)
+{
+  char default_list[] = GPIO_DEVICE;
+  char *list = default_list;
+  const char *mem_device = MEM_DEVICE;
+  timing_clock_t clock = TIMING_MONOTONIC;
+  uint64_t emu_delay_ns = 0, emu_jitter_ns = 0;
+  unsigned int secs = CHAN_STEP_SECS;
+  int use_emulator = 0, sim = 0, num_chans = 0, max_chans = 0;
+  int n, i, opt;
+
+  while ((opt = getopt (argc, argv, "c:e:m:N:ST:t:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'c':
+        list = optarg;  // Channels, device[@addr],...
+        break;
+      case 'e':
+        use_emulator = 1;  // One emulated core per channel
+        emu_delay_ns = strtoull (optarg, &optarg, 0);
+        if (*optarg == ',')
+          emu_jitter_ns = strtoull (optarg + 1, NULL, 0);
+        break;
+      case 'm':
+        mem_device = optarg;
+        break;
+      case 'N':
+        max_chans = atoi (optarg);  // Last step of the sweep
+        break;
+      case 'S':
+        sim = 1;  // Simulation module: registers mapped from each node
+        break;
+      case 'T':
+        secs = strtoul (optarg, NULL, 0);
+        break;
+      case 't':
+        clock = timing_clock_by_name (optarg);
+        if (clock < NUM_TIMING_CLOCKS)
+          break;
+        /* fall through */
+      default:
+        printf ("Usage: %s [-c device[@addr],...] [-m mem_device] [-S] "
+                "[-e delay_ns[,jitter_ns]] [-N max_channels (1-%d)] "
+                "[-T step_secs] [-t mono|mono_raw|cycles]\n", argv[0],
+                MAX_CHANNELS);
+        exit (-1);
+    }
+  }
+
+  if (use_emulator)
+  {
+    /* Emulated cores: each watches its own register file */
+    num_chans = max_chans > 0 && max_chans <= MAX_CHANNELS ? max_chans
+                                                           : MAX_CHANNELS;
+    for (i = 0; i < num_chans; i++)
+    {
+      snprintf (channels[i].device, sizeof(channels[i].device), "emu%d", i);
+      snprintf (channels[i].mem_device, sizeof(channels[i].mem_device),
+                "%s.%d", EMU_MEM_FILE, i);
+      channels[i].addr = INT_LATENCY_ADDR;
+      channels[i].emu = &emus[i];
+      if (fpga_emu_start (&emus[i], channels[i].mem_device, INT_LATENCY_ADDR,
+                          emu_delay_ns, emu_jitter_ns) == -1)
+      {
+        printf ("GPIO_MULTICHAN: Unable to start the emulator of %s\n",
+                channels[i].device);
+        exit (-1);
+      }
+    }
+  }
+  else
+  {
+    num_chans = parse_channels (list, mem_device, sim);
+    if (num_chans <= 0)
+    {
+      printf ("GPIO_MULTICHAN: Invalid channels, one register each\n");
+      exit (-1);
+    }
+    if (max_chans > 0 && max_chans < num_chans)
+      num_chans = max_chans;
+  }
+  for (i = 0; i < num_chans; i++)
+  {
+    if (channel_open (&channels[i], clock) == -1)
+      exit (-1);
+  }
+
+  printf ("GPIO_MULTICHAN: %d channels, clock %s, %us per step\n\n",
+          num_chans, channels[0].timing.name, secs);
+  printf ("%5s %-16s %10s %10s %10s %10s %10s %10s %10s %8s\n", "Chans",
+          "Channel", "Samples", "Rate(/s)", "p50(us)", "p99(us)", "p99.9(us)",
+          "Max(us)", "IRQ p99", "Lost");
+  for (n = 1; n <= num_chans; n = n < num_chans && n * 2 > num_chans
+                                      ? num_chans : n * 2)
+  {
+    if (run_step (n, secs) == -1)
+      break;
+    if (n == num_chans)
+      break;
+  }
+
+  for (i = 0; i < num_chans; i++)
+  {
+    gpio_close_memory_map (&channels[i].map);
+    if (channels[i].emu != NULL)
+      fpga_emu_stop (channels[i].emu);
+    else
+      close (channels[i].fd);
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include <sys/mman.h>
+#include <stddef.h>
+#include <unistd.h>
+#include "gpio_ring.h"
+
+/* -----------------------------------------------------------------------------
+ *
+ * Maps the event ring of the opened GPIO device.
+ *
+ */
+
+int
+gpio_ring_map (gpio_ring_t *ring, int fd)
+{
+  long page_size = sysconf (_SC_PAGESIZE);
+  void *addr;
+
+  ring->length = (sizeof(struct gpio_int_ring) + page_size - 1)
+      & ~(page_size - 1);
+  ring->overruns = 0;
+
+  addr = mmap (NULL, ring->length, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED)
+  {
+    ring->ring = NULL;
+    return -1;
+  }
+
+  ring->ring = (const struct gpio_int_ring *) addr;
+  ring->tail = gpio_ring_head (ring);
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Consumes a ring that is already in memory.
+ *
+ */
+
+void
+gpio_ring_attach (gpio_ring_t *ring, const struct gpio_int_ring *events)
+{
+  ring->ring = events;
+  ring->length = 0;
+  ring->overruns = 0;
+  ring->tail = gpio_ring_head (ring);
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Unmaps the event ring.
+ *
+ */
+
+int
+gpio_ring_unmap (gpio_ring_t *ring)
+{
+  int rc = 0;
+
+  if (ring->ring != NULL && ring->length != 0)
+  {
+    rc = munmap ((void *) ring->ring, ring->length);
+    ring->ring = NULL;
+  }
+  return rc;
+}
@@ -0,0 +1,119 @@
+/*
+ * gpio_ring.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _GPIO_RING_H_
+#define _GPIO_RING_H_
+
+#include <stddef.h>
+#include "gpio_interrupt.h"
+
+/* -----------------------------------------------------------------------------
+ *
+ * Consumer of the event ring exported by the GPIO kernel module. The ring is
+ * mapped once with gpio_ring_map(); afterwards records are taken with
+ * gpio_ring_pop() without any system call.
+ *
+ */
+typedef struct
+{
+  const struct gpio_int_ring *ring; /* Mapped ring (read-only)            */
+  size_t length;                    /* Length of the mapping               */
+  unsigned int tail;                /* Sequence number of the next record  */
+  unsigned long overruns;           /* Records overwritten before read     */
+} gpio_ring_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Maps the event ring of the opened GPIO device. The consumer starts at the
+ * current head, so only interrupts after this call are returned.
+ * It returns 0 on success and -1 on failure.
+ *
+ */
+int
+gpio_ring_map (gpio_ring_t *ring, int fd);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Consumes a ring that is already in memory (e.g. written by the FPGA
+ * emulator) instead of mapping the device's. gpio_ring_unmap() leaves it.
+ *
+ */
+void
+gpio_ring_attach (gpio_ring_t *ring, const struct gpio_int_ring *events);
+
+/** @brief gpio_ring_head routine: Reads the producer index of the ring.
+ *  @param ring Mapped event ring
+ *  @return Sequence number of the next interrupt to be recorded
+ */
+static inline unsigned int
+gpio_ring_head (gpio_ring_t *ring)
+{
+  return __atomic_load_n (&ring->ring->head, __ATOMIC_ACQUIRE);
+}
+
+/** @brief gpio_ring_pending routine: Tells whether records are available.
+ *  @param ring Mapped event ring
+ *  @return Non-zero if gpio_ring_pop() would return a record
+ */
+static inline int
+gpio_ring_pending (gpio_ring_t *ring)
+{
+  return gpio_ring_head (ring) != ring->tail;
+}
+
+/** @brief gpio_ring_pop routine: Takes the oldest available record.
+ *  Records overwritten by the producer before they were read are skipped
+ *  and counted in ring->overruns.
+ *  @param ring Mapped event ring
+ *  @param event Filled with the record
+ *  @return 1 if a record was returned, 0 if the ring is empty
+ */
+static inline int
+gpio_ring_pop (gpio_ring_t *ring, struct gpio_int_event *event)
+{
+  const struct gpio_int_event *slot;
+  unsigned int head;
+
+  for (;;)
+  {
+    head = gpio_ring_head (ring);
+    if (head - ring->tail > GPIO_EVENT_RING_SIZE)
+    {
+      ring->overruns += head - ring->tail - GPIO_EVENT_RING_SIZE;
+      ring->tail = head - GPIO_EVENT_RING_SIZE;
+    }
+    if (head == ring->tail)
+      return 0;
+
+    slot = &ring->ring->events[ring->tail & GPIO_EVENT_RING_MASK];
+    if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) == ring->tail)
+    {
+      event->timestamp_ns = slot->timestamp_ns;
+      event->cpu = slot->cpu;
+      __atomic_thread_fence (__ATOMIC_ACQUIRE);
+      event->seq = __atomic_load_n (&slot->seq, __ATOMIC_RELAXED);
+      if (event->seq == ring->tail)
+      {
+        ring->tail++;
+        return 1;
+      }
+    }
+    /* Overwritten while it was being copied */
+    ring->overruns++;
+    ring->tail++;
+  }
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Unmaps the event ring.
+ *
+ */
+int
+gpio_ring_unmap (gpio_ring_t *ring);
+
+#endif /* _GPIO_RING_H_ */
@@ -0,0 +1,424 @@
+/*
+ ============================================================================
+ Name        : gpio_timeline.c
+ Author      : Advanced MCU - Spring 2018 - Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Per-sample stage breakdown of the interrupt latency. It joins
+ the samples of gpio_interrupt_monitor (the -f trace, or the -M markers)
+ with the gpio_interrupt tracepoints of a saved ftrace buffer, by the
+ sequence number of the kernel record, and splits every sample in:
+   hardware  pin assert to IRQ entry (gpio_int_irq)
+   handler   IRQ entry to notification (gpio_int_notify): top half,
+             IRQ thread or coalescing delay
+   wake-up   notification to the waiter running in the driver
+             (gpio_int_wake): scheduling
+   to user   driver to user space: return, copy and signal delivery
+ Without a gpio_int_wake event (signal and eventfd waits) the last two are
+ reported together as wake-up. The stage that dominates each tail sample
+ is flagged.
+ ============================================================================
+ */
+
+/* *************************** INCLUDES *********************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "histogram.h"
+#include "trace.h"
+
+/* ******************* MACROS AND TYPE DEFINITIONS ************************* */
+
+#define NSEC_PER_USEC     1000.0
+#define TAIL_PERCENTILE   99.0      /* Samples above it are the tail      */
+#define TAIL_PRINTED      20        /* Tail samples listed                */
+#define WAKE_SCAN         64        /* Events after the seq searched      */
+
+typedef enum
+{
+  STAGE_HW,
+  STAGE_HANDLER,
+  STAGE_WAKEUP,
+  STAGE_USER,
+  NUM_STAGES
+} stage_t;
+
+/* One tracepoint: the newest record it covers and when it was hit */
+typedef struct
+{
+  uint32_t seq;
+  uint64_t ts;
+} tp_event_t;
+
+typedef struct
+{
+  tp_event_t *events;
+  size_t count;
+  size_t capacity;
+} tp_list_t;
+
+/* One sample of the monitor, from its trace or its markers */
+typedef struct
+{
+  unsigned long index;      /* Record index, or sample tag of the marker  */
+  uint64_t t_assert;
+  uint64_t t_isr;           /* 0 if not known                             */
+  uint64_t t_user;
+  uint32_t seq;
+} sample_t;
+
+/* ******************* STATIC AND GLOBAL VARIABLES  *********************** */
+
+static const char *stage_name[NUM_STAGES] =
+  { "hardware", "handler", "wake-up", "to user" };
+
+static tp_list_t irq_list, notify_list, wake_list;
+static sample_t *samples;
+static size_t num_samples, max_samples;
+static uint64_t read_cost_ns;
+static histogram_t total_hist;
+static histogram_t stage_hist[NUM_STAGES];
+
+/* ********************** FUNCTION IMPLEMENTATION ************************* */
+
+static void *
+grow (void *array, size_t *capacity, size_t size)
+{
+  void *bigger;
+
+  *capacity = *capacity ? *capacity * 2 : 4096;
+  bigger = realloc (array, *capacity * size);
+  if (bigger == NULL)
+  {
+    printf ("GPIO_TIMELINE: Out of memory\n");
+    exit (-1);
+  }
+  return bigger;
+}
+
+static void
+tp_append (tp_list_t *list, uint32_t seq, uint64_t ts)
+{
+  if (list->count == list->capacity)
+    list->events = grow (list->events, &list->capacity, sizeof(tp_event_t));
+  list->events[list->count].seq = seq;
+  list->events[list->count].ts = ts;
+  list->count++;
+}
+
+static sample_t *
+sample_append (void)
+{
+  if (num_samples == max_samples)
+    samples = grow (samples, &max_samples, sizeof(sample_t));
+  memset (&samples[num_samples], 0, sizeof(sample_t));
+  return &samples[num_samples++];
+}
+
+static int
+tp_compare (const void *a, const void *b)
+{
+  const tp_event_t *x = a, *y = b;
+
+  if (x->seq != y->seq)
+    return x->seq < y->seq ? -1 : 1;
+  if (x->ts != y->ts)
+    return x->ts < y->ts ? -1 : 1;
+  return 0;
+}
+
+/* First event covering seq at or after min_ts, 0 if there is none */
+static uint64_t
+tp_find (const tp_list_t *list, uint32_t seq, uint64_t min_ts, int exact)
+{
+  size_t low = 0, high = list->count, i;
+
+  while (low < high)
+  {
+    size_t mid = (low + high) / 2;
+
+    if (list->events[mid].seq < seq)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  for (i = low; i < list->count && i < low + WAKE_SCAN; i++)
+  {
+    if (exact && list->events[i].seq != seq)
+      break;
+    if (list->events[i].ts >= min_ts)
+      return list->events[i].ts;
+  }
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Reads the text of the ftrace buffer: the tracepoints of device dev and,
+ * when use_markers is set, the samples from the wake-up markers.
+ *
+ */
+
+static int
+read_ftrace (const char *filename, unsigned int dev, int use_markers)
+{
+  char line[512], *p;
+  unsigned int index, seq, notify;
+  unsigned long sample;
+  unsigned long long ts, t_assert, t_user;
+  sample_t *s;
+  FILE *fp;
+
+  if ((fp = fopen (filename, "r")) == NULL)
+    return -1;
+  while (fgets (line, sizeof(line), fp) != NULL)
+  {
+    if ((p = strstr (line, "gpio_int_irq: ")) != NULL)
+    {
+      if (sscanf (p, "gpio_int_irq: dev=%u seq=%u ts=%llu", &index, &seq,
+                  &ts) == 3 && index == dev)
+        tp_append (&irq_list, seq, ts);
+    }
+    else if ((p = strstr (line, "gpio_int_notify: ")) != NULL)
+    {
+      if (sscanf (p, "gpio_int_notify: dev=%u seq=%u notify=%x ts=%llu",
+                  &index, &seq, &notify, &ts) == 4 && index == dev)
+        tp_append (&notify_list, seq, ts);
+    }
+    else if ((p = strstr (line, "gpio_int_wake: ")) != NULL)
+    {
+      if (sscanf (p, "gpio_int_wake: dev=%u seq=%u path=%*s ts=%llu", &index,
+                  &seq, &ts) == 3 && index == dev)
+        tp_append (&wake_list, seq, ts);
+    }
+    else if (use_markers && (p = strstr (line, "gpio_mon: wake ")) != NULL)
+    {
+      if (sscanf (p, "gpio_mon: wake sample=%lu seq=%u t_assert=%llu "
+                  "t_user=%llu", &sample, &seq, &t_assert, &t_user) == 4)
+      {
+        s = sample_append ();
+        s->index = sample;
+        s->seq = seq;
+        s->t_assert = t_assert;
+        s->t_user = t_user;
+      }
+    }
+  }
+  fclose (fp);
+
+  qsort (irq_list.events, irq_list.count, sizeof(tp_event_t), tp_compare);
+  qsort (notify_list.events, notify_list.count, sizeof(tp_event_t),
+         tp_compare);
+  qsort (wake_list.events, wake_list.count, sizeof(tp_event_t), tp_compare);
+  return 0;
+}
+
+/* Reads the samples of the monitor trace that carry a kernel record */
+static int
+read_samples (const char *filename)
+{
+  const trace_header_t *header;
+  const trace_record_t *records;
+  long long count, i;
+  size_t length;
+  sample_t *s;
+
+  count = trace_map (filename, &header, &records, &length);
+  if (count < 0)
+    return -1;
+  read_cost_ns = header->read_cost_ns;
+  for (i = 0; i < count; i++)
+  {
+    if (records[i].flags & TRACE_FLAG_CHECKPOINT
+        || !(records[i].flags & TRACE_FLAG_ISR))
+      continue;
+    s = sample_append ();
+    s->index = i;
+    s->t_assert = records[i].t_assert;
+    s->t_isr = records[i].t_isr;
+    s->t_user = records[i].t_user;
+    s->seq = records[i].seq;
+  }
+  trace_unmap (header, length);
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Splits a sample in stages. It returns -1 if the tracepoints needed are
+ * missing, 0 if the wake-up stage includes the way back to user space and
+ * 1 if both were traced.
+ *
+ */
+
+static int
+split_sample (const sample_t *s, uint64_t stage[NUM_STAGES])
+{
+  uint64_t irq, notify, wake, user;
+
+  irq = tp_find (&irq_list, s->seq, 0, 1);
+  if (irq == 0)
+    irq = s->t_isr;
+  if (irq == 0 || irq < s->t_assert)
+    return -1;
+  notify = tp_find (&notify_list, s->seq, irq, 0);
+  if (notify == 0 || notify > s->t_user)
+    return -1;
+  wake = tp_find (&wake_list, s->seq, notify, 0);
+  if (wake > s->t_user)
+    wake = 0;
+
+  /* The clock baseline is taken from the last stage, like the monitor */
+  user = s->t_user > read_cost_ns ? s->t_user - read_cost_ns : 0;
+  stage[STAGE_HW] = irq - s->t_assert;
+  stage[STAGE_HANDLER] = notify - irq;
+  if (wake != 0)
+  {
+    stage[STAGE_WAKEUP] = wake - notify;
+    stage[STAGE_USER] = user > wake ? user - wake : 0;
+    return 1;
+  }
+  stage[STAGE_WAKEUP] = user > notify ? user - notify : 0;
+  stage[STAGE_USER] = 0;
+  return 0;
+}
+
+static void
+print_percentiles (const char *name, const histogram_t *hist)
+{
+  if (hist->count == 0)
+    return;
+  printf ("%-12s %9llu %10.3f %10.3f %10.3f %10.3f %10.3f\n", name,
+          (unsigned long long) hist->count, hist_percentile (hist, 50)
+          / NSEC_PER_USEC, hist_percentile (hist, 99) / NSEC_PER_USEC,
+          hist_percentile (hist, 99.9) / NSEC_PER_USEC,
+          hist->max / NSEC_PER_USEC, hist->mean / NSEC_PER_USEC);
+}
+
+/* *************************** MAIN FUNCTION ****************************** */
+
+int
+main (int argc, char **argv)
+{
+  const char *sample_file = NULL;
+  double percentile = TAIL_PERCENTILE;
+  unsigned long max_printed = TAIL_PRINTED, printed = 0;
+  unsigned long dominant[NUM_STAGES] = { 0 }, tail = 0;
+  unsigned long unmatched = 0, merged = 0;
+  unsigned int dev = 0;
+  uint64_t stage[NUM_STAGES], total, threshold;
+  size_t i;
+  int opt, rc, s, top;
+
+  while ((opt = getopt (argc, argv, "d:k:p:s:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'd':
+        dev = strtoul (optarg, NULL, 0);  // N of /dev/gpio_intN
+        break;
+      case 'k':
+        max_printed = strtoul (optarg, NULL, 0);  // Tail samples listed
+        break;
+      case 'p':
+        percentile = atof (optarg);  // The tail starts there
+        break;
+      case 's':
+        sample_file = optarg;  // Monitor trace (-f), else the markers
+        break;
+      default:
+        optind = argc + 1;
+        break;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    printf ("Usage: %s [-s sample_trace] [-d device_index] [-p percentile] "
+            "[-k max_listed] ftrace_file\n", argv[0]);
+    exit (-1);
+  }
+
+  if (sample_file != NULL && read_samples (sample_file) == -1)
+  {
+    printf ("GPIO_TIMELINE: %s is not a valid trace\n", sample_file);
+    exit (-1);
+  }
+  if (read_ftrace (argv[optind], dev, sample_file == NULL) == -1)
+  {
+    printf ("GPIO_TIMELINE: Unable to read %s\n", argv[optind]);
+    exit (-1);
+  }
+  printf ("GPIO_TIMELINE: %zu samples, %zu IRQ, %zu notification and %zu "
+          "wake-up events of gpio_int%u\n", num_samples, irq_list.count,
+          notify_list.count, wake_list.count, dev);
+
+  hist_reset (&total_hist);
+  for (s = 0; s < NUM_STAGES; s++)
+    hist_reset (&stage_hist[s]);
+  for (i = 0; i < num_samples; i++)
+  {
+    rc = split_sample (&samples[i], stage);
+    if (rc == -1)
+    {
+      unmatched++;
+      continue;
+    }
+    if (rc == 0)
+      merged++;
+    for (s = 0, total = 0; s < NUM_STAGES; s++)
+    {
+      total += stage[s];
+      if (rc == 1 || s != STAGE_USER)
+        hist_add (&stage_hist[s], stage[s]);
+    }
+    hist_add (&total_hist, total);
+  }
+  printf ("GPIO_TIMELINE: %lu samples without tracepoints, %lu with "
+          "wake-up and to user together\n\n", unmatched, merged);
+  if (total_hist.count == 0)
+    return 0;
+
+  printf ("%-12s %9s %10s %10s %10s %10s %10s\n", "Stage", "Samples",
+          "p50(us)", "p99(us)", "p99.9(us)", "Max(us)", "Mean(us)");
+  print_percentiles ("total", &total_hist);
+  for (s = 0; s < NUM_STAGES; s++)
+    print_percentiles (stage_name[s], &stage_hist[s]);
+
+  /* The tail: every sample above the percentile of the total */
+  threshold = hist_percentile (&total_hist, percentile);
+  printf ("\nSamples above p%g (%.3f us):\n", percentile,
+          threshold / NSEC_PER_USEC);
+  printf ("%-10s %10s %10s %10s %10s %10s %10s  %s\n", "Sample", "Seq",
+          "Total(us)", "HW(us)", "ISR(us)", "Wake(us)", "User(us)",
+          "Dominant");
+  for (i = 0; i < num_samples; i++)
+  {
+    if (split_sample (&samples[i], stage) == -1)
+      continue;
+    for (s = 0, total = 0, top = 0; s < NUM_STAGES; s++)
+    {
+      total += stage[s];
+      if (stage[s] > stage[top])
+        top = s;
+    }
+    if (total < threshold)
+      continue;
+    tail++;
+    dominant[top]++;
+    if (printed++ >= max_printed)
+      continue;
+    printf ("%-10lu %10u %10.3f %10.3f %10.3f %10.3f %10.3f  %s\n",
+            samples[i].index, samples[i].seq, total / NSEC_PER_USEC,
+            stage[STAGE_HW] / NSEC_PER_USEC,
+            stage[STAGE_HANDLER] / NSEC_PER_USEC,
+            stage[STAGE_WAKEUP] / NSEC_PER_USEC,
+            stage[STAGE_USER] / NSEC_PER_USEC, stage_name[top]);
+  }
+  printf ("\n%lu tail samples, dominated by:", tail);
+  for (s = 0; s < NUM_STAGES; s++)
+    printf (" %s %lu%s", stage_name[s], dominant[s],
+            s + 1 < NUM_STAGES ? "," : "\n");
+  return 0;
+}
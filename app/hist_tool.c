@@ -0,0 +1,113 @@
+/*
+ ============================================================================
+ Name        : hist_tool.c
+ Author      : Advanced MCU - Spring 2018 - Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Merges the latency histograms saved by gpio_interrupt_monitor
+ (-o option) across sets, runs and processes and prints the percentiles.
+ ============================================================================
+ */
+
+/* *************************** INCLUDES *********************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "histogram.h"
+
+/* ******************* MACROS AND TYPE DEFINITIONS ************************* */
+
+#define NSEC_PER_USEC     1000.0
+
+/* ******************* STATIC AND GLOBAL VARIABLES  *********************** */
+
+static histogram_t merged;
+static histogram_t hist;
+
+/* ********************** FUNCTION IMPLEMENTATION ************************* */
+
+/* Merges every histogram stored in a file, returns how many were found */
+static int
+merge_file (const char *filename)
+{
+  uint8_t *data;
+  size_t size, pos = 0, n;
+  long length;
+  int found = 0;
+  FILE *fp = fopen (filename, "rb");
+
+  if (fp == NULL)
+    return -1;
+  fseek (fp, 0, SEEK_END);
+  length = ftell (fp);
+  fseek (fp, 0, SEEK_SET);
+  if (length <= 0 || (data = malloc (length)) == NULL)
+  {
+    fclose (fp);
+    return length == 0 ? 0 : -1;
+  }
+  size = fread (data, 1, length, fp);
+  fclose (fp);
+
+  while (pos < size && (n = hist_deserialize (&hist, data + pos,
+                                              size - pos)) != 0)
+  {
+    hist_merge (&merged, &hist);
+    pos += n;
+    found++;
+  }
+  if (pos != size)
+    printf ("HIST_TOOL: %s: trailing data at offset %zu ignored\n",
+            filename, pos);
+  free (data);
+  return found;
+}
+
+/* *************************** MAIN FUNCTION ****************************** */
+
+int
+main (int argc, char **argv)
+{
+  int i, found;
+
+  if (argc < 2)
+  {
+    printf ("Usage: %s hist_file [hist_file...]\n", argv[0]);
+    exit (-1);
+  }
+
+  hist_reset (&merged);
+  for (i = 1; i < argc; i++)
+  {
+    found = merge_file (argv[i]);
+    if (found < 0)
+    {
+      printf ("HIST_TOOL: Unable to read %s\n", argv[i]);
+      exit (-1);
+    }
+    printf ("HIST_TOOL: %s: %d histogram(s)\n", argv[i], found);
+  }
+
+  if (merged.count == 0)
+  {
+    printf ("No samples\n");
+    return 0;
+  }
+  printf ("Number of samples:  %llu\n", (unsigned long long) merged.count);
+  printf ("Minimum Latency:    %.3fus\n", merged.min / NSEC_PER_USEC);
+  printf ("Maximum Latency:    %.3fus\n", merged.max / NSEC_PER_USEC);
+  printf ("Average Latency:    %.3fus\n", merged.mean / NSEC_PER_USEC);
+  printf ("Standard Deviation: %.3fus\n",
+          hist_std_dev (&merged) / NSEC_PER_USEC);
+  printf ("p50:                %.3fus\n",
+          hist_percentile (&merged, 50) / NSEC_PER_USEC);
+  printf ("p90:                %.3fus\n",
+          hist_percentile (&merged, 90) / NSEC_PER_USEC);
+  printf ("p99:                %.3fus\n",
+          hist_percentile (&merged, 99) / NSEC_PER_USEC);
+  printf ("p99.9:              %.3fus\n",
+          hist_percentile (&merged, 99.9) / NSEC_PER_USEC);
+  printf ("p99.99:             %.3fus\n",
+          hist_percentile (&merged, 99.99) / NSEC_PER_USEC);
+  return 0;
+}
@@ -0,0 +1,308 @@
+#include <string.h>
+#include <math.h>
+#include "histogram.h"
+
+#define HIST_MAGIC            0x54534847UL  /* "GHST" little-endian */
+#define HIST_VERSION          1
+#define HIST_HEADER_SIZE      48
+
+/* -----------------------------------------------------------------------------
+ *
+ * Clears a histogram.
+ *
+ */
+
+void
+hist_reset (histogram_t *hist)
+{
+  memset (hist, 0, sizeof(*hist));
+  hist->min = UINT64_MAX;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Lowest and highest values counted by a bucket.
+ *
+ */
+
+static uint64_t
+hist_bucket_low (unsigned int index)
+{
+  unsigned int shift;
+
+  if (index < (1 << HIST_PRECISION_BITS))
+    return index;
+  shift = (index >> (HIST_PRECISION_BITS - 1)) - 1;
+  return (uint64_t) (index - (shift << (HIST_PRECISION_BITS - 1))) << shift;
+}
+
+static uint64_t
+hist_bucket_high (unsigned int index)
+{
+  if (index + 1 >= HIST_NUM_BUCKETS)
+    return UINT64_MAX;
+  return hist_bucket_low (index + 1) - 1;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Adds the samples of src to dst. Mean and variance are combined with the
+ * parallel form of Welford's method (Chan et al.).
+ *
+ */
+
+void
+hist_merge (histogram_t *dst, const histogram_t *src)
+{
+  double delta, total;
+  unsigned int i;
+
+  if (src->count == 0)
+    return;
+
+  for (i = 0; i < HIST_NUM_BUCKETS; i++)
+    dst->buckets[i] += src->buckets[i];
+
+  total = (double) dst->count + src->count;
+  delta = src->mean - dst->mean;
+  dst->mean += delta * src->count / total;
+  dst->m2 += src->m2 + delta * delta * dst->count * src->count / total;
+  dst->count += src->count;
+  if (src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Returns the value at the given percentile.
+ *
+ */
+
+uint64_t
+hist_percentile (const histogram_t *hist, double percentile)
+{
+  uint64_t rank, seen = 0;
+  unsigned int i;
+
+  if (hist->count == 0)
+    return 0;
+  if (percentile <= 0)
+    return hist->min;
+
+  rank = (uint64_t) ceil (percentile / 100.0 * hist->count);
+  if (rank > hist->count)
+    rank = hist->count;
+
+  for (i = 0; i < HIST_NUM_BUCKETS; i++)
+  {
+    seen += hist->buckets[i];
+    if (seen >= rank)
+    {
+      uint64_t value = hist_bucket_high (i);
+
+      if (value > hist->max)
+        value = hist->max;
+      if (value < hist->min)
+        value = hist->min;
+      return value;
+    }
+  }
+  return hist->max;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Returns the population standard deviation of the samples.
+ *
+ */
+
+double
+hist_std_dev (const histogram_t *hist)
+{
+  if (hist->count == 0)
+    return 0;
+  return sqrt (hist->m2 / hist->count);
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Little-endian and varint encoding helpers of the serialized format.
+ *
+ */
+
+static void
+put_u64 (uint8_t *buf, uint64_t value)
+{
+  int i;
+
+  for (i = 0; i < 8; i++)
+    buf[i] = (uint8_t) (value >> (8 * i));
+}
+
+static uint64_t
+get_u64 (const uint8_t *buf)
+{
+  uint64_t value = 0;
+  int i;
+
+  for (i = 0; i < 8; i++)
+    value |= (uint64_t) buf[i] << (8 * i);
+  return value;
+}
+
+static uint64_t
+double_bits (double value)
+{
+  uint64_t bits;
+
+  memcpy (&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static double
+bits_double (uint64_t bits)
+{
+  double value;
+
+  memcpy (&value, &bits, sizeof(value));
+  return value;
+}
+
+static size_t
+put_varint (uint8_t *buf, size_t len, uint64_t value)
+{
+  size_t n = 0;
+
+  do
+  {
+    if (n >= len)
+      return 0;
+    buf[n++] = (uint8_t) ((value & 0x7F) | (value >= 0x80 ? 0x80 : 0));
+    value >>= 7;
+  }
+  while (value != 0);
+  return n;
+}
+
+static size_t
+get_varint (const uint8_t *buf, size_t len, uint64_t *value)
+{
+  size_t n = 0;
+  int shift = 0;
+
+  *value = 0;
+  while (n < len && shift < 64)
+  {
+    *value |= (uint64_t) (buf[n] & 0x7F) << shift;
+    if ((buf[n++] & 0x80) == 0)
+      return n;
+    shift += 7;
+  }
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Serializes a histogram. Header layout (little-endian):
+ *   0 magic, 4 version, 5 precision bits, 6 reserved, 8 count, 16 min,
+ *   24 max, 32 mean, 40 m2, then the number of non-empty buckets and the
+ *   (index delta, count) pairs as varints.
+ *
+ */
+
+size_t
+hist_serialize (const histogram_t *hist, uint8_t *buf, size_t len)
+{
+  unsigned int i, last = 0;
+  uint64_t used = 0;
+  size_t pos, n;
+
+  if (len < HIST_HEADER_SIZE)
+    return 0;
+
+  buf[0] = (uint8_t) HIST_MAGIC;
+  buf[1] = (uint8_t) (HIST_MAGIC >> 8);
+  buf[2] = (uint8_t) (HIST_MAGIC >> 16);
+  buf[3] = (uint8_t) (HIST_MAGIC >> 24);
+  buf[4] = HIST_VERSION;
+  buf[5] = HIST_PRECISION_BITS;
+  buf[6] = 0;
+  buf[7] = 0;
+  put_u64 (buf + 8, hist->count);
+  put_u64 (buf + 16, hist->min);
+  put_u64 (buf + 24, hist->max);
+  put_u64 (buf + 32, double_bits (hist->mean));
+  put_u64 (buf + 40, double_bits (hist->m2));
+  pos = HIST_HEADER_SIZE;
+
+  for (i = 0; i < HIST_NUM_BUCKETS; i++)
+  {
+    if (hist->buckets[i] != 0)
+      used++;
+  }
+  if ((n = put_varint (buf + pos, len - pos, used)) == 0)
+    return 0;
+  pos += n;
+
+  for (i = 0; i < HIST_NUM_BUCKETS; i++)
+  {
+    if (hist->buckets[i] == 0)
+      continue;
+    if ((n = put_varint (buf + pos, len - pos, i - last)) == 0)
+      return 0;
+    pos += n;
+    if ((n = put_varint (buf + pos, len - pos, hist->buckets[i])) == 0)
+      return 0;
+    pos += n;
+    last = i;
+  }
+  return pos;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Rebuilds a histogram from hist_serialize() output.
+ *
+ */
+
+size_t
+hist_deserialize (histogram_t *hist, const uint8_t *buf, size_t len)
+{
+  uint64_t used, delta, count;
+  uint64_t index = 0;
+  size_t pos, n;
+
+  if (len < HIST_HEADER_SIZE
+      || (get_u64 (buf) & 0xFFFFFFFFULL) != HIST_MAGIC
+      || buf[4] != HIST_VERSION || buf[5] != HIST_PRECISION_BITS)
+    return 0;
+
+  hist_reset (hist);
+  hist->count = get_u64 (buf + 8);
+  hist->min = get_u64 (buf + 16);
+  hist->max = get_u64 (buf + 24);
+  hist->mean = bits_double (get_u64 (buf + 32));
+  hist->m2 = bits_double (get_u64 (buf + 40));
+  pos = HIST_HEADER_SIZE;
+
+  if ((n = get_varint (buf + pos, len - pos, &used)) == 0)
+    return 0;
+  pos += n;
+
+  while (used-- > 0)
+  {
+    if ((n = get_varint (buf + pos, len - pos, &delta)) == 0)
+      return 0;
+    pos += n;
+    if ((n = get_varint (buf + pos, len - pos, &count)) == 0)
+      return 0;
+    pos += n;
+    index += delta;
+    if (index >= HIST_NUM_BUCKETS)
+      return 0;
+    hist->buckets[index] = count;
+  }
+  return pos;
+}
@@ -0,0 +1,130 @@
+/*
+ * histogram.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* -----------------------------------------------------------------------------
+ *
+ * Log-bucketed latency histogram (HDR style). Values below 2^P are counted
+ * exactly; above that every power of two is split in 2^(P-1) linear buckets,
+ * so any recorded value is known within 1/2^(P-1) of its magnitude. Memory is
+ * constant whatever the number of samples. The running mean and variance are
+ * kept with Welford's method.
+ *
+ */
+#define HIST_PRECISION_BITS   7
+#define HIST_SUB_BUCKETS      (1 << (HIST_PRECISION_BITS - 1))
+#define HIST_NUM_BUCKETS      ((64 - HIST_PRECISION_BITS) * HIST_SUB_BUCKETS \
+                               + (1 << HIST_PRECISION_BITS))
+
+typedef struct
+{
+  uint64_t count;                      /* Number of samples             */
+  uint64_t min;                        /* Smallest sample               */
+  uint64_t max;                        /* Largest sample                */
+  double mean;                         /* Running mean (Welford)        */
+  double m2;                           /* Sum of squared deviations     */
+  uint64_t buckets[HIST_NUM_BUCKETS];  /* Sample count per bucket       */
+} histogram_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Clears a histogram.
+ *
+ */
+void
+hist_reset (histogram_t *hist);
+
+/** @brief hist_bucket_index routine: Maps a value to its bucket.
+ *  @param value The sample value
+ *  @return Index of the bucket counting value
+ */
+static inline unsigned int
+hist_bucket_index (uint64_t value)
+{
+  unsigned int shift;
+
+  if (value < (1 << HIST_PRECISION_BITS))
+    return (unsigned int) value;
+  shift = 64 - __builtin_clzll (value) - HIST_PRECISION_BITS;
+  return (shift << (HIST_PRECISION_BITS - 1)) + (unsigned int) (value >> shift);
+}
+
+/** @brief hist_add routine: Records one sample in O(1).
+ *  @param hist The histogram
+ *  @param value The sample value
+ */
+static inline void
+hist_add (histogram_t *hist, uint64_t value)
+{
+  double delta;
+
+  hist->buckets[hist_bucket_index (value)]++;
+  hist->count++;
+  if (value < hist->min)
+    hist->min = value;
+  if (value > hist->max)
+    hist->max = value;
+  delta = (double) value - hist->mean;
+  hist->mean += delta / hist->count;
+  hist->m2 += delta * ((double) value - hist->mean);
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Adds the samples of src to dst. Histograms of different sets, threads or
+ * processes (see hist_deserialize) can be merged this way.
+ *
+ */
+void
+hist_merge (histogram_t *dst, const histogram_t *src);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Returns the value below which the given percentage (0-100) of the samples
+ * fall. The result is the upper bound of the bucket holding that rank,
+ * clamped to the recorded maximum.
+ *
+ */
+uint64_t
+hist_percentile (const histogram_t *hist, double percentile);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Returns the population standard deviation of the samples.
+ *
+ */
+double
+hist_std_dev (const histogram_t *hist);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Serializes a histogram in a compact format: a fixed header followed by the
+ * non-empty buckets as (index delta, count) varint pairs. It returns the
+ * number of bytes written, or 0 if buf is too small. HIST_MAX_SERIALIZED
+ * bytes are always enough.
+ *
+ */
+#define HIST_MAX_SERIALIZED   (64 + HIST_NUM_BUCKETS * 2 * 10)
+
+size_t
+hist_serialize (const histogram_t *hist, uint8_t *buf, size_t len);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Rebuilds a histogram from hist_serialize() output. It returns the number
+ * of bytes consumed, or 0 if the data is not a valid histogram.
+ *
+ */
+size_t
+hist_deserialize (histogram_t *hist, const uint8_t *buf, size_t len);
+
+#endif /* _HISTOGRAM_H_ */
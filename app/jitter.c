@@ -0,0 +1,479 @@
+#define _GNU_SOURCE       /* RUSAGE_THREAD, sched_getcpu() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "jitter.h"
+
+#define JIT_IRQ_BUF_LEN       16384   /* Grown while /proc/interrupts fills it */
+#define JIT_USUAL_PERCENTILE  0.9     /* Counts above it are unusual           */
+#define PROC_INTERRUPTS       "/proc/interrupts"
+
+static const char *jit_cause_name[NUM_JIT_CAUSES] =
+  { "voluntary switches", "involuntary switches", "minor faults",
+    "major faults", "IRQs on ISR CPU", "IRQs on own CPU", "migrations",
+    "cache misses", "dTLB misses" };
+
+static const char *jit_cause_short[NUM_JIT_CAUSES] =
+  { "vcsw", "ivcsw", "minflt", "majflt", "irq@isr", "irq@own", "migr",
+    "cmiss", "dtlb" };
+
+static const char *jit_source_name[NUM_JIT_SOURCES] =
+  { "getrusage", "/proc/interrupts", "perf group" };
+
+static inline uint64_t
+jit_now_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Opens a counter of the calling thread in the group of group_fd. Hardware
+ * counters fall back to user space only when the kernel is not allowed.
+ *
+ */
+
+static int
+jit_perf_open (uint32_t type, uint64_t config, int group_fd, int user_only)
+{
+  struct perf_event_attr attr;
+  int fd;
+
+  memset (&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.read_format = PERF_FORMAT_GROUP;
+  attr.exclude_hv = 1;
+  fd = syscall (__NR_perf_event_open, &attr, 0, -1, group_fd,
+                PERF_FLAG_FD_CLOEXEC);
+  if (fd == -1 && user_only)
+  {
+    attr.exclude_kernel = 1;
+    fd = syscall (__NR_perf_event_open, &attr, 0, -1, group_fd,
+                  PERF_FLAG_FD_CLOEXEC);
+  }
+  return fd;
+}
+
+static void
+jit_perf_add (jitter_t *jit, jit_cause_t cause, uint32_t type,
+              uint64_t config, int user_only)
+{
+  int fd;
+
+  fd = jit_perf_open (type, config, jit->num_perf ? jit->fd_perf[0] : -1,
+                      user_only);
+  if (fd == -1)
+    return;
+  jit->fd_perf[jit->num_perf] = fd;
+  jit->perf_cause[jit->num_perf++] = cause;
+  jit->available[cause] = 1;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Sums the interrupts of every CPU, except the GPIO line and the error
+ * counters, from the /proc/interrupts kept open.
+ *
+ */
+
+static int
+jit_read_irq (jitter_t *jit, uint64_t *irq)
+{
+  char *line, *next, *p, *end, *bigger;
+  unsigned long label;
+  ssize_t len;
+  int cpu;
+
+  for (;;)
+  {
+    len = pread (jit->fd_irq, jit->irq_buf, jit->irq_len - 1, 0);
+    if (len < 0)
+      return -1;
+    if ((size_t) len < jit->irq_len - 1)
+      break;
+    bigger = realloc (jit->irq_buf, jit->irq_len * 2);
+    if (bigger == NULL)
+      return -1;
+    jit->irq_buf = bigger;
+    jit->irq_len *= 2;
+  }
+  jit->irq_buf[len] = '\0';
+
+  memset (irq, 0, sizeof(uint64_t) * JIT_MAX_CPUS);
+  line = strchr (jit->irq_buf, '\n');       /* The CPU header */
+  for (; line != NULL; line = next)
+  {
+    next = strchr (++line, '\n');
+    if ((p = strchr (line, ':')) == NULL || (next != NULL && p > next))
+      continue;
+    label = strtoul (line, &end, 10);
+    if (end != line && end == p && label == jit->gpio_irq)
+      continue;
+    if (strstr (line, "ERR:") == line + strspn (line, " ")
+        || strstr (line, "MIS:") == line + strspn (line, " "))
+      continue;
+    for (p++, cpu = 0; cpu < jit->num_cpus; cpu++)
+    {
+      unsigned long long value = strtoull (p, &end, 10);
+
+      if (end == p)
+        break;
+      irq[cpu] += value;
+      p = end;
+    }
+  }
+  return 0;
+}
+
+/* Takes a snapshot and returns its cost, also added per source */
+static uint64_t
+jit_snapshot (jitter_t *jit, jit_snapshot_t *snap)
+{
+  uint64_t t0, t1, t2, t3, values[1 + JIT_MAX_PERF];
+  struct rusage usage;
+  int i;
+
+  t0 = jit_now_ns ();
+  if (getrusage (RUSAGE_THREAD, &usage) == 0)
+  {
+    snap->value[JIT_VCSW] = usage.ru_nvcsw;
+    snap->value[JIT_IVCSW] = usage.ru_nivcsw;
+    snap->value[JIT_MINFLT] = usage.ru_minflt;
+    snap->value[JIT_MAJFLT] = usage.ru_majflt;
+  }
+  t1 = jit_now_ns ();
+  if (jit->fd_irq != -1)
+    jit_read_irq (jit, snap->irq);
+  t2 = jit_now_ns ();
+  if (jit->num_perf > 0
+      && read (jit->fd_perf[0], values, sizeof(values)) > 0)
+  {
+    for (i = 0; i < jit->num_perf && i < (int) values[0]; i++)
+      snap->value[jit->perf_cause[i]] = values[1 + i];
+  }
+  t3 = jit_now_ns ();
+
+  hist_add (&jit->cost[JIT_SRC_RUSAGE], t1 - t0);
+  if (jit->fd_irq != -1)
+    hist_add (&jit->cost[JIT_SRC_IRQ], t2 - t1);
+  if (jit->num_perf > 0)
+    hist_add (&jit->cost[JIT_SRC_PERF], t3 - t2);
+  return t3 - t0;
+}
+
+int
+jit_open (jitter_t *jit, size_t max_samples, unsigned int gpio_irq)
+{
+  char header[4096], *p;
+  ssize_t len;
+
+  memset (jit, 0, sizeof(*jit));
+  jit->fd_irq = -1;
+  jit->gpio_irq = gpio_irq;
+  jit->samples = calloc (max_samples, sizeof(jit_sample_t));
+  jit->irq_len = JIT_IRQ_BUF_LEN;
+  jit->irq_buf = malloc (jit->irq_len);
+  if (jit->samples == NULL || jit->irq_buf == NULL)
+  {
+    jit_close (jit);
+    return -1;
+  }
+  jit->max_samples = max_samples;
+  jit->available[JIT_VCSW] = jit->available[JIT_IVCSW] = 1;
+  jit->available[JIT_MINFLT] = jit->available[JIT_MAJFLT] = 1;
+
+  /* The CPU columns are counted once, from the header line */
+  jit->fd_irq = open (PROC_INTERRUPTS, O_RDONLY | O_CLOEXEC);
+  if (jit->fd_irq != -1
+      && (len = pread (jit->fd_irq, header, sizeof(header) - 1, 0)) > 0)
+  {
+    header[len] = '\0';
+    if ((p = strchr (header, '\n')) != NULL)
+      *p = '\0';
+    for (p = header; (p = strstr (p, "CPU")) != NULL; p += 3)
+      jit->num_cpus++;
+  }
+  if (jit->num_cpus > JIT_MAX_CPUS)
+    jit->num_cpus = JIT_MAX_CPUS;
+  if (jit->num_cpus == 0 && jit->fd_irq != -1)
+  {
+    close (jit->fd_irq);
+    jit->fd_irq = -1;
+  }
+  jit->available[JIT_IRQ_ISR_CPU] = jit->available[JIT_IRQ_OWN_CPU] =
+      jit->fd_irq != -1;
+
+  /* One read() of the group leader returns every counter */
+  jit_perf_add (jit, JIT_MIGRATIONS, PERF_TYPE_SOFTWARE,
+                PERF_COUNT_SW_CPU_MIGRATIONS, 0);
+  if (jit->num_perf > 0)
+  {
+    jit_perf_add (jit, JIT_CACHE_MISSES, PERF_TYPE_HARDWARE,
+                  PERF_COUNT_HW_CACHE_MISSES, 1);
+    jit_perf_add (jit, JIT_DTLB_MISSES, PERF_TYPE_HW_CACHE,
+                  PERF_COUNT_HW_CACHE_DTLB
+                  | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), 1);
+  }
+  jit_reset (jit);
+  return 0;
+}
+
+void
+jit_reset (jitter_t *jit)
+{
+  int s;
+
+  jit->num_samples = 0;
+  jit->dropped = 0;
+  for (s = 0; s < NUM_JIT_SOURCES; s++)
+    hist_reset (&jit->cost[s]);
+  hist_reset (&jit->sample_cost);
+}
+
+void
+jit_begin (jitter_t *jit)
+{
+  jit->begin_cost_ns = jit_snapshot (jit, &jit->before);
+}
+
+void
+jit_end (jitter_t *jit, unsigned long index, uint64_t latency_ns,
+         int isr_cpu)
+{
+  jit_sample_t *sample;
+  uint64_t delta;
+  int c, cpu;
+
+  hist_add (&jit->sample_cost, jit->begin_cost_ns
+            + jit_snapshot (jit, &jit->after));
+  if (jit->num_samples == jit->max_samples)
+  {
+    jit->dropped++;
+    return;
+  }
+  sample = &jit->samples[jit->num_samples++];
+  memset (sample, 0, sizeof(*sample));
+  sample->index = index;
+  sample->latency_ns = latency_ns;
+  for (c = 0; c < NUM_JIT_CAUSES; c++)
+  {
+    delta = jit->after.value[c] - jit->before.value[c];
+    sample->delta[c] = delta > UINT32_MAX ? UINT32_MAX : delta;
+  }
+
+  cpu = sched_getcpu ();
+  sample->isr_cpu = isr_cpu >= 0 && isr_cpu < jit->num_cpus ? isr_cpu : -1;
+  sample->own_cpu = cpu >= 0 && cpu < jit->num_cpus ? cpu : -1;
+  if (sample->isr_cpu != -1)
+    sample->delta[JIT_IRQ_ISR_CPU] = jit->after.irq[sample->isr_cpu]
+        - jit->before.irq[sample->isr_cpu];
+  if (sample->own_cpu != -1)
+    sample->delta[JIT_IRQ_OWN_CPU] = jit->after.irq[sample->own_cpu]
+        - jit->before.irq[sample->own_cpu];
+}
+
+static int
+jit_compare_u32 (const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+static int
+jit_compare_latency (const void *a, const void *b)
+{
+  const jit_sample_t *x = *(const jit_sample_t * const *) a;
+  const jit_sample_t *y = *(const jit_sample_t * const *) b;
+
+  return x->latency_ns < y->latency_ns ? 1 : x->latency_ns > y->latency_ns
+      ? -1 : 0;
+}
+
+static void
+jit_print_cost (const char *name, const histogram_t *hist)
+{
+  if (hist->count == 0)
+    return;
+  printf ("  %-18s %10llu %10llu %10llu %10.0f\n", name,
+          (unsigned long long) hist_percentile (hist, 50),
+          (unsigned long long) hist_percentile (hist, 99),
+          (unsigned long long) hist->max, hist->mean);
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * A count is unusual above the 90th percentile of the samples below the
+ * tail, so a cause present in every sample (the voluntary switch of a
+ * blocking wait) is not blamed for the tail.
+ *
+ */
+
+void
+jit_report (jitter_t *jit, double percentile)
+{
+  uint32_t usual[NUM_JIT_CAUSES], *values;
+  unsigned long tail_hit[NUM_JIT_CAUSES] = { 0 };
+  unsigned long body_hit[NUM_JIT_CAUSES] = { 0 };
+  double tail_sum[NUM_JIT_CAUSES] = { 0 }, body_sum[NUM_JIT_CAUSES] = { 0 };
+  double excess[NUM_JIT_CAUSES];
+  int rank[NUM_JIT_CAUSES], num_rank = 0;
+  jit_sample_t **tail;
+  size_t num_tail = 0, num_body, i, n;
+  unsigned long unexplained = 0;
+  histogram_t latency;
+  uint64_t threshold;
+  int c, j, hit;
+
+  if (jit->num_samples == 0)
+    return;
+  hist_reset (&latency);
+  for (i = 0; i < jit->num_samples; i++)
+    hist_add (&latency, jit->samples[i].latency_ns);
+  threshold = hist_percentile (&latency, percentile);
+
+  tail = malloc (jit->num_samples * sizeof(*tail));
+  values = malloc (jit->num_samples * sizeof(*values));
+  if (tail == NULL || values == NULL)
+  {
+    free (tail);
+    free (values);
+    return;
+  }
+  for (i = 0; i < jit->num_samples; i++)
+  {
+    if (jit->samples[i].latency_ns >= threshold)
+      tail[num_tail++] = &jit->samples[i];
+  }
+  num_body = jit->num_samples - num_tail;
+
+  /* The usual count of each cause, below the tail */
+  for (c = 0; c < NUM_JIT_CAUSES; c++)
+  {
+    usual[c] = 0;
+    if (!jit->available[c] || num_body == 0)
+      continue;
+    for (i = 0, n = 0; i < jit->num_samples; i++)
+    {
+      if (jit->samples[i].latency_ns < threshold)
+        values[n++] = jit->samples[i].delta[c];
+    }
+    qsort (values, n, sizeof(*values), jit_compare_u32);
+    usual[c] = values[(size_t) (JIT_USUAL_PERCENTILE * (n - 1))];
+  }
+
+  for (i = 0; i < jit->num_samples; i++)
+  {
+    const jit_sample_t *sample = &jit->samples[i];
+    int is_tail = sample->latency_ns >= threshold;
+
+    for (c = 0, hit = 0; c < NUM_JIT_CAUSES; c++)
+    {
+      if (!jit->available[c])
+        continue;
+      if (is_tail)
+        tail_sum[c] += sample->delta[c];
+      else
+        body_sum[c] += sample->delta[c];
+      if (sample->delta[c] <= usual[c])
+        continue;
+      hit = 1;
+      if (is_tail)
+        tail_hit[c]++;
+      else
+        body_hit[c]++;
+    }
+    if (is_tail && !hit)
+      unexplained++;
+  }
+
+  /* Ranked by the excess of unusual counts in the tail */
+  for (c = 0; c < NUM_JIT_CAUSES; c++)
+  {
+    if (!jit->available[c])
+      continue;
+    excess[c] = 100.0 * tail_hit[c] / num_tail
+        - (num_body ? 100.0 * body_hit[c] / num_body : 0);
+    for (j = num_rank++; j > 0 && excess[rank[j - 1]] < excess[c]; j--)
+      rank[j] = rank[j - 1];
+    rank[j] = c;
+  }
+
+  printf ("Jitter attribution: %zu of %zu samples at or above p%g "
+          "(%.3f us)\n", num_tail, jit->num_samples, percentile,
+          threshold / 1000.0);
+  if (jit->dropped != 0)
+    printf ("  Samples not attributed (no room): %lu\n", jit->dropped);
+  printf ("  %-22s %8s %8s %9s %10s %10s %10s\n", "Cause", "Usual",
+          "Tail(%)", "Other(%)", "Excess(%)", "Tail mean", "Other mean");
+  for (j = 0; j < num_rank; j++)
+  {
+    c = rank[j];
+    printf ("  %-22s %8u %8.1f %9.1f %10.1f %10.1f %10.1f\n",
+            jit_cause_name[c], usual[c], 100.0 * tail_hit[c] / num_tail,
+            num_body ? 100.0 * body_hit[c] / num_body : 0.0, excess[c],
+            tail_sum[c] / num_tail, num_body ? body_sum[c] / num_body : 0.0);
+  }
+  printf ("  Tail samples without an unusual count: %lu\n", unexplained);
+
+  /* The slowest samples and their deltas */
+  qsort (tail, num_tail, sizeof(*tail), jit_compare_latency);
+  printf ("  %-10s %10s %4s %4s", "Sample", "Total(us)", "ISR", "CPU");
+  for (c = 0; c < NUM_JIT_CAUSES; c++)
+  {
+    if (jit->available[c])
+      printf (" %7s", jit_cause_short[c]);
+  }
+  printf ("\n");
+  for (i = 0; i < num_tail && i < JIT_LISTED; i++)
+  {
+    printf ("  %-10lu %10.3f %4d %4d", tail[i]->index,
+            tail[i]->latency_ns / 1000.0, tail[i]->isr_cpu,
+            tail[i]->own_cpu);
+    for (c = 0; c < NUM_JIT_CAUSES; c++)
+    {
+      if (jit->available[c])
+        printf (" %7u", tail[i]->delta[c]);
+    }
+    printf ("\n");
+  }
+
+  printf ("Snapshot cost (ns), outside of the measured interval:\n");
+  printf ("  %-18s %10s %10s %10s %10s\n", "Source", "p50", "p99", "Max",
+          "Mean");
+  for (c = 0; c < NUM_JIT_SOURCES; c++)
+    jit_print_cost (jit_source_name[c], &jit->cost[c]);
+  jit_print_cost ("per sample (2)", &jit->sample_cost);
+  free (tail);
+  free (values);
+}
+
+void
+jit_close (jitter_t *jit)
+{
+  int i;
+
+  for (i = jit->num_perf - 1; i >= 0; i--)
+    close (jit->fd_perf[i]);
+  jit->num_perf = 0;
+  if (jit->fd_irq != -1)
+    close (jit->fd_irq);
+  jit->fd_irq = -1;
+  free (jit->irq_buf);
+  free (jit->samples);
+  jit->irq_buf = NULL;
+  jit->samples = NULL;
+}
@@ -0,0 +1,148 @@
+/*
+ * jitter.h
+ *
+ *  Created on: Apr 2, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _JITTER_H_
+#define _JITTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+
+#define JIT_MAX_CPUS          64   /* CPU columns of /proc/interrupts     */
+#define JIT_MAX_PERF          3    /* Counters of the perf event group    */
+#define JIT_LISTED            10   /* Tail samples listed by the report   */
+
+/* -----------------------------------------------------------------------------
+ *
+ * Possible causes of a slow sample, counted between a snapshot taken right
+ * before the pin is asserted and one taken right after the wake-up:
+ *  getrusage(RUSAGE_THREAD)  context switches and page faults of the
+ *                            measurement thread
+ *  /proc/interrupts          interrupts other than the GPIO one, on the CPU
+ *                            that ran the handler and on the monitor's CPU
+ *  perf_event_open           migrations, cache and dTLB misses of the
+ *                            thread, when the kernel allows it
+ *
+ */
+typedef enum
+{
+  JIT_VCSW,
+  JIT_IVCSW,
+  JIT_MINFLT,
+  JIT_MAJFLT,
+  JIT_IRQ_ISR_CPU,
+  JIT_IRQ_OWN_CPU,
+  JIT_MIGRATIONS,
+  JIT_CACHE_MISSES,
+  JIT_DTLB_MISSES,
+  NUM_JIT_CAUSES
+} jit_cause_t;
+
+/* Sources of a snapshot, whose cost is measured separately */
+typedef enum
+{
+  JIT_SRC_RUSAGE,
+  JIT_SRC_IRQ,
+  JIT_SRC_PERF,
+  NUM_JIT_SOURCES
+} jit_source_t;
+
+typedef struct
+{
+  uint64_t value[NUM_JIT_CAUSES];  /* Per-thread counters                 */
+  uint64_t irq[JIT_MAX_CPUS];      /* Interrupts per CPU, GPIO one apart  */
+} jit_snapshot_t;
+
+/* The counter deltas of one sample */
+typedef struct
+{
+  unsigned long index;             /* Tag of the sample (-M markers)      */
+  uint64_t latency_ns;
+  uint32_t delta[NUM_JIT_CAUSES];
+  int16_t isr_cpu;                 /* -1 if the record is missing         */
+  int16_t own_cpu;
+} jit_sample_t;
+
+typedef struct
+{
+  unsigned int gpio_irq;           /* Line left out of the IRQ counts     */
+  int fd_irq;                      /* /proc/interrupts, -1 if unavailable */
+  char *irq_buf;
+  size_t irq_len;
+  int num_cpus;
+  int fd_perf[JIT_MAX_PERF];       /* Group leader first, -1 if unused    */
+  jit_cause_t perf_cause[JIT_MAX_PERF];
+  int num_perf;
+  int available[NUM_JIT_CAUSES];
+  jit_snapshot_t before;
+  jit_snapshot_t after;
+  uint64_t begin_cost_ns;          /* Cost of the snapshot before         */
+  jit_sample_t *samples;
+  size_t num_samples;
+  size_t max_samples;
+  unsigned long dropped;           /* Samples beyond max_samples          */
+  histogram_t cost[NUM_JIT_SOURCES]; /* Snapshot cost per source (ns)     */
+  histogram_t sample_cost;         /* Both snapshots of a sample (ns)     */
+} jitter_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Opens the sources for the calling thread, which must be the measurement
+ * thread, and allocates room for max_samples samples. The sources that
+ * cannot be opened are left out. It returns 0 on success and -1 if the
+ * memory cannot be allocated.
+ *
+ */
+int
+jit_open (jitter_t *jit, size_t max_samples, unsigned int gpio_irq);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Forgets the samples and the snapshot costs, at the start of a set.
+ *
+ */
+void
+jit_reset (jitter_t *jit);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Takes the snapshot before a sample.
+ *
+ */
+void
+jit_begin (jitter_t *jit);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Takes the snapshot after a sample and keeps its deltas with its latency.
+ * isr_cpu is the CPU that handled the interrupt, -1 if unknown.
+ *
+ */
+void
+jit_end (jitter_t *jit, unsigned long index, uint64_t latency_ns,
+         int isr_cpu);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Prints the causes ranked by how much more often the samples above the
+ * percentile show an unusual count (above the 90th percentile of the other
+ * samples) than the other samples do, the slowest samples with their
+ * deltas and the cost of the snapshots.
+ *
+ */
+void
+jit_report (jitter_t *jit, double percentile);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Closes the sources and releases the samples.
+ *
+ */
+void
+jit_close (jitter_t *jit);
+
+#endif /* _JITTER_H_ */
@@ -0,0 +1,376 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "load_gen.h"
+
+#define LOAD_MEMBW_BYTES      (32UL << 20)
+#define LOAD_CACHE_BYTES      (8UL << 20)
+#define LOAD_TLB_BYTES        (64UL << 20)
+#define LOAD_IO_BYTES         (1UL << 20)
+#define LOAD_IO_CHUNK         (64UL << 10)
+#define LOAD_LINE             64
+#define LOAD_PAGE             4096
+#define LOAD_IO_DIR           "/dev/shm"
+
+static const char *load_kind_name[NUM_LOAD_KINDS] =
+  { "cpu", "membw", "cache", "tlb", "fork", "io" };
+
+/* Working memory of each kind */
+static const size_t load_kind_bytes[NUM_LOAD_KINDS] =
+  { 0, LOAD_MEMBW_BYTES, LOAD_CACHE_BYTES, LOAD_TLB_BYTES, 0,
+    LOAD_IO_CHUNK };
+
+/* -----------------------------------------------------------------------------
+ *
+ * Parses one kind[:threads][@cpu[-cpu]].
+ *
+ */
+
+static int
+load_parse_worker (load_worker_t *worker, const char *spec, size_t len)
+{
+  char item[32], *p, *end;
+  int kind;
+
+  if (len == 0 || len >= sizeof(item))
+    return -1;
+  memcpy (item, spec, len);
+  item[len] = '\0';
+
+  worker->threads = 1;
+  worker->cpu_first = worker->cpu_last = -1;
+  if ((p = strchr (item, '@')) != NULL)
+  {
+    *p++ = '\0';
+    worker->cpu_first = worker->cpu_last = strtol (p, &end, 10);
+    if (end == p || worker->cpu_first < 0)
+      return -1;
+    if (*end == '-')
+    {
+      p = end + 1;
+      worker->cpu_last = strtol (p, &end, 10);
+      if (end == p || worker->cpu_last < worker->cpu_first)
+        return -1;
+    }
+    if (*end != '\0')
+      return -1;
+  }
+  if ((p = strchr (item, ':')) != NULL)
+  {
+    *p++ = '\0';
+    worker->threads = strtol (p, &end, 10);
+    if (end == p || *end != '\0' || worker->threads < 1)
+      return -1;
+  }
+  for (kind = 0; kind < NUM_LOAD_KINDS; kind++)
+  {
+    if (strcmp (item, load_kind_name[kind]) == 0)
+    {
+      worker->kind = (load_kind_t) kind;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+int
+load_parse (load_profile_t *profile, const char *spec)
+{
+  const char *end;
+  int threads = 0;
+
+  memset (profile, 0, sizeof(*profile));
+  snprintf (profile->name, sizeof(profile->name), "%s", spec);
+  if (strcmp (spec, "none") == 0)
+    return 0;
+
+  while (*spec != '\0')
+  {
+    if (profile->num_workers == LOAD_MAX_WORKERS)
+      return -1;
+    end = strchr (spec, ',');
+    if (end == NULL)
+      end = spec + strlen (spec);
+    if (load_parse_worker (&profile->workers[profile->num_workers], spec,
+                           end - spec) == -1)
+      return -1;
+    threads += profile->workers[profile->num_workers++].threads;
+    spec = *end == ',' ? end + 1 : end;
+  }
+  return profile->num_workers != 0 && threads <= LOAD_MAX_THREADS ? 0 : -1;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * The workers. Each iteration is short, so the stop flag is seen quickly.
+ *
+ */
+
+static void
+load_cpu (load_thread_t *thread)
+{
+  volatile uint64_t x = thread->index + 1;
+  int i;
+
+  for (i = 0; i < 100000; i++)
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+}
+
+static void
+load_membw (load_thread_t *thread)
+{
+  uint64_t *words = thread->buf;
+  size_t i, n = thread->len / sizeof(*words);
+
+  /* Read and write every line: one full pass per iteration */
+  for (i = 0; i < n; i += LOAD_LINE / sizeof(*words))
+    words[i] += 1;
+}
+
+static void
+load_cache (load_thread_t *thread)
+{
+  volatile uint8_t *bytes = thread->buf;
+  size_t lines = thread->len / LOAD_LINE;
+  unsigned int seed = thread->ops + thread->index;
+  int i;
+
+  for (i = 0; i < 65536; i++)
+    bytes[(rand_r (&seed) % lines) * LOAD_LINE]++;
+}
+
+static void
+load_tlb (load_thread_t *thread)
+{
+  volatile uint8_t *bytes = thread->buf;
+  size_t pages = thread->len / LOAD_PAGE, i;
+  /* A stride coprime with the number of pages visits each page once */
+  size_t stride = 4099, page = thread->ops % pages;
+
+  for (i = 0; i < pages; i++)
+  {
+    bytes[page * LOAD_PAGE + (i % (LOAD_PAGE / LOAD_LINE)) * LOAD_LINE]++;
+    page = (page + stride) % pages;
+  }
+}
+
+static void
+load_fork (load_thread_t *thread)
+{
+  pid_t pid = fork ();
+
+  (void) thread;
+  if (pid == 0)
+  {
+    execl ("/bin/true", "true", (char *) NULL);
+    _exit (127);
+  }
+  if (pid > 0)
+    waitpid (pid, NULL, 0);
+}
+
+static void
+load_io (load_thread_t *thread, int fd)
+{
+  off_t offset;
+
+  for (offset = 0; offset < (off_t) LOAD_IO_BYTES; offset += LOAD_IO_CHUNK)
+  {
+    if (pwrite (fd, thread->buf, LOAD_IO_CHUNK, offset) != LOAD_IO_CHUNK)
+      return;
+  }
+  for (offset = 0; offset < (off_t) LOAD_IO_BYTES; offset += LOAD_IO_CHUNK)
+  {
+    if (pread (fd, thread->buf, LOAD_IO_CHUNK, offset) != LOAD_IO_CHUNK)
+      return;
+  }
+  if (ftruncate (fd, 0) == -1)
+    return;
+}
+
+static void *
+load_thread (void *arg)
+{
+  load_thread_t *thread = (load_thread_t *) arg;
+  char path[64];
+  int fd = -1;
+
+  if (thread->worker->kind == LOAD_IO)
+  {
+    snprintf (path, sizeof(path), "%s/gpio_load.%d.%d", LOAD_IO_DIR,
+              (int) getpid (), thread->index);
+    fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd != -1)
+      unlink (path);
+  }
+  pthread_mutex_lock (thread->lock);
+  (*thread->num_ready)++;
+  pthread_cond_signal (thread->ready);
+  pthread_mutex_unlock (thread->lock);
+
+  while (!*thread->stop)
+  {
+    switch (thread->worker->kind)
+    {
+      case LOAD_CPU:
+        load_cpu (thread);
+        break;
+      case LOAD_MEMBW:
+        load_membw (thread);
+        break;
+      case LOAD_CACHE:
+        load_cache (thread);
+        break;
+      case LOAD_TLB:
+        load_tlb (thread);
+        break;
+      case LOAD_FORK:
+        load_fork (thread);
+        break;
+      case LOAD_IO:
+        if (fd != -1)
+          load_io (thread, fd);
+        else
+          usleep (1000);
+        break;
+      default:
+        break;
+    }
+    thread->ops++;
+  }
+  if (fd != -1)
+    close (fd);
+  return NULL;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Starts the threads of every worker.
+ *
+ */
+
+int
+load_start (load_profile_t *profile)
+{
+  load_thread_t *thread;
+  load_worker_t *worker;
+  pthread_attr_t attr;
+  sigset_t all, saved;
+  cpu_set_t set;
+  int total = 0, started, w, i, rc = 0;
+
+  for (w = 0; w < profile->num_workers; w++)
+    total += profile->workers[w].threads;
+  profile->num_threads = 0;
+  if (total == 0)
+    return 0;
+
+  /* Allocate and touch first: the load is not ramping up while measured */
+  memset (profile->threads, 0, sizeof(profile->threads));
+  for (w = 0, i = 0; w < profile->num_workers; w++)
+  {
+    worker = &profile->workers[w];
+    for (started = 0; started < worker->threads; started++, i++)
+    {
+      thread = &profile->threads[i];
+      thread->worker = worker;
+      thread->index = i;
+      thread->stop = &profile->stop;
+      thread->lock = &profile->lock;
+      thread->ready = &profile->ready;
+      thread->num_ready = &profile->num_ready;
+      thread->len = load_kind_bytes[worker->kind];
+      if (thread->len == 0)
+        continue;
+      thread->buf = mmap (NULL, thread->len, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (thread->buf == MAP_FAILED)
+      {
+        thread->buf = NULL;
+        rc = -1;
+        break;
+      }
+      memset (thread->buf, i, thread->len);
+    }
+  }
+
+  profile->stop = 0;
+  profile->num_ready = 0;
+  pthread_mutex_init (&profile->lock, NULL);
+  pthread_cond_init (&profile->ready, NULL);
+
+  /* The threads inherit a mask blocking every signal */
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &saved);
+  for (i = 0; i < total && rc == 0; i++)
+  {
+    thread = &profile->threads[i];
+    pthread_attr_init (&attr);
+    if (thread->worker->cpu_first >= 0)
+    {
+      CPU_ZERO (&set);
+      CPU_SET (thread->worker->cpu_first
+               + i % (thread->worker->cpu_last - thread->worker->cpu_first
+                      + 1), &set);
+      pthread_attr_setaffinity_np (&attr, sizeof(set), &set);
+    }
+    if (pthread_create (&profile->tids[i], &attr, load_thread, thread) != 0)
+      rc = -1;
+    else
+      profile->num_threads++;
+    pthread_attr_destroy (&attr);
+  }
+  pthread_sigmask (SIG_SETMASK, &saved, NULL);
+
+  /* Only the threads actually created are waited for */
+  if (rc == -1)
+    profile->stop = 1;
+  pthread_mutex_lock (&profile->lock);
+  while (profile->num_ready < profile->num_threads)
+    pthread_cond_wait (&profile->ready, &profile->lock);
+  pthread_mutex_unlock (&profile->lock);
+  if (rc == 0)
+    return 0;
+  load_stop (profile);
+  return -1;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Stops the threads and releases their memory.
+ *
+ */
+
+unsigned long
+load_stop (load_profile_t *profile)
+{
+  unsigned long ops = 0;
+  int i;
+
+  profile->stop = 1;
+  for (i = 0; i < profile->num_threads; i++)
+    pthread_join (profile->tids[i], NULL);
+  if (profile->num_workers != 0)
+  {
+    pthread_cond_destroy (&profile->ready);
+    pthread_mutex_destroy (&profile->lock);
+  }
+  for (i = 0; i < LOAD_MAX_THREADS; i++)
+  {
+    ops += profile->threads[i].ops;
+    if (profile->threads[i].buf != NULL)
+      munmap (profile->threads[i].buf, profile->threads[i].len);
+    profile->threads[i].buf = NULL;
+    profile->threads[i].ops = 0;
+  }
+  profile->num_threads = 0;
+  return ops;
+}
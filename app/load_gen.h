@@ -0,0 +1,115 @@
+/*
+ * load_gen.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _LOAD_GEN_H_
+#define _LOAD_GEN_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define LOAD_MAX_WORKERS      8    /* Worker kinds in one profile         */
+#define LOAD_MAX_THREADS      64   /* Threads of all the workers          */
+#define LOAD_NAME_LEN         96
+
+/* -----------------------------------------------------------------------------
+ *
+ * Kinds of background load:
+ *  cpu    spins on integer arithmetic
+ *  membw  streams a 32 MiB buffer (read and write), memory bandwidth
+ *  cache  random cache-line accesses in an 8 MiB buffer, cache misses
+ *  tlb    one access per page across 64 MiB in a random page order
+ *  fork   fork() and exec of /bin/true, page table copies and scheduling
+ *  io     writes, reads back and truncates a 1 MiB file in /dev/shm
+ *
+ */
+typedef enum
+{
+  LOAD_CPU,
+  LOAD_MEMBW,
+  LOAD_CACHE,
+  LOAD_TLB,
+  LOAD_FORK,
+  LOAD_IO,
+  NUM_LOAD_KINDS
+} load_kind_t;
+
+/* One kind of load, run by threads pinned round-robin to cpu_first..last */
+typedef struct
+{
+  load_kind_t kind;
+  int threads;
+  int cpu_first;    /* -1: not pinned */
+  int cpu_last;
+} load_worker_t;
+
+/* A thread of a running profile and its working memory */
+typedef struct
+{
+  const load_worker_t *worker;
+  int index;                       /* Among all the threads           */
+  void *buf;
+  size_t len;
+  volatile int *stop;
+  pthread_mutex_t *lock;
+  pthread_cond_t *ready;
+  int *num_ready;
+  unsigned long ops;               /* Iterations done                 */
+} load_thread_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * A load profile, e.g. "cpu:2@1,membw:1,io:1@0-1": the workers started by
+ * load_start() and stopped by load_stop(). A profile without workers
+ * ("none") starts nothing.
+ *
+ */
+typedef struct
+{
+  load_worker_t workers[LOAD_MAX_WORKERS];
+  int num_workers;
+  char name[LOAD_NAME_LEN];        /* The profile as given            */
+  load_thread_t threads[LOAD_MAX_THREADS];
+  pthread_t tids[LOAD_MAX_THREADS];
+  int num_threads;                 /* Running, 0 when stopped         */
+  volatile int stop;
+  pthread_mutex_t lock;            /* Protects num_ready              */
+  pthread_cond_t ready;            /* Signalled by each thread up     */
+  int num_ready;
+} load_profile_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Parses a profile: "none", or a comma-separated list of
+ * kind[:threads][@cpu[-cpu]], e.g. "cpu:2@1,membw,fork:1@0-3". A kind
+ * without a count runs one thread. It returns 0 on success and -1 if the
+ * profile is invalid.
+ *
+ */
+int
+load_parse (load_profile_t *profile, const char *spec);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Allocates and touches the working memory of every thread, starts the
+ * threads with every signal blocked and returns once all of them run, so
+ * the load is at its steady state when the measurement begins. It returns
+ * 0 on success and -1 on failure, with nothing left running.
+ *
+ */
+int
+load_start (load_profile_t *profile);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Stops the threads and returns once all of them have finished, then frees
+ * their memory. It returns the iterations done by all the threads.
+ *
+ */
+unsigned long
+load_stop (load_profile_t *profile);
+
+#endif /* _LOAD_GEN_H_ */
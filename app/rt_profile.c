@@ -0,0 +1,166 @@
+#define _GNU_SOURCE
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "rt_profile.h"
+
+static char saved_irq_affinity[256];
+static int irq_affinity_saved = 0;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Touches the stack so its pages are mapped (and locked) before measuring.
+ *
+ */
+
+static void
+prefault_stack (void)
+{
+  volatile unsigned char stack[RT_PREFAULT_STACK];
+  size_t i;
+
+  for (i = 0; i < sizeof(stack); i += 4096)
+    stack[i] = 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Locks every page in memory.
+ *
+ */
+
+int
+rt_lock_memory (void)
+{
+  if (mlockall (MCL_CURRENT | MCL_FUTURE) == -1)
+    return -1;
+
+  /* Freed memory stays in the heap and no allocation gets its own mmap */
+  mallopt (M_TRIM_THRESHOLD, -1);
+  mallopt (M_MMAP_MAX, 0);
+  prefault_stack ();
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Applies the policy, priority and CPU of a profile to the calling thread.
+ *
+ */
+
+int
+rt_apply_thread (const rt_profile_t *profile)
+{
+  struct sched_param param;
+  cpu_set_t set;
+  int rc = 0;
+
+  memset (&param, 0, sizeof(param));
+  param.sched_priority = profile->priority;
+  if (pthread_setschedparam (pthread_self (),
+                             profile->priority > 0 ? SCHED_FIFO : SCHED_OTHER,
+                             &param) != 0)
+    rc = -1;
+
+  CPU_ZERO (&set);
+  if (profile->cpu >= 0)
+    CPU_SET (profile->cpu, &set);
+  else
+  {
+    int cpu;
+
+    /* Unpinned: any CPU the process may use */
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      CPU_SET (cpu, &set);
+  }
+  if (pthread_setaffinity_np (pthread_self (), sizeof(set), &set) != 0
+      && profile->cpu >= 0)
+    rc = -1;
+  return rc;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Routes an IRQ to a single CPU.
+ *
+ */
+
+int
+rt_set_irq_cpu (unsigned int irq, int cpu)
+{
+  char path[64];
+  FILE *fp;
+  int rc = 0;
+
+  snprintf (path, sizeof(path), "/proc/irq/%u/smp_affinity_list", irq);
+  if (!irq_affinity_saved)
+  {
+    if ((fp = fopen (path, "r")) == NULL)
+      return -1;
+    if (fgets (saved_irq_affinity, sizeof(saved_irq_affinity), fp) != NULL)
+      irq_affinity_saved = 1;
+    fclose (fp);
+  }
+
+  if ((fp = fopen (path, "w")) == NULL)
+    return -1;
+  if (fprintf (fp, "%d\n", cpu) < 0)
+    rc = -1;
+  if (fclose (fp) != 0)
+    rc = -1;
+  return rc;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Restores the saved IRQ affinity.
+ *
+ */
+
+void
+rt_restore_irq (unsigned int irq)
+{
+  char path[64];
+  FILE *fp;
+
+  if (!irq_affinity_saved)
+    return;
+  snprintf (path, sizeof(path), "/proc/irq/%u/smp_affinity_list", irq);
+  if ((fp = fopen (path, "w")) != NULL)
+  {
+    fputs (saved_irq_affinity, fp);
+    fclose (fp);
+  }
+  irq_affinity_saved = 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Formats a profile for the output.
+ *
+ */
+
+void
+rt_describe (const rt_profile_t *profile, char *buf, size_t len)
+{
+  char sched[16], cpu[16], irq_cpu[16];
+
+  if (profile->priority > 0)
+    snprintf (sched, sizeof(sched), "fifo:%d", profile->priority);
+  else
+    snprintf (sched, sizeof(sched), "other");
+  if (profile->cpu >= 0)
+    snprintf (cpu, sizeof(cpu), "%d", profile->cpu);
+  else
+    snprintf (cpu, sizeof(cpu), "any");
+  if (profile->irq_cpu >= 0)
+    snprintf (irq_cpu, sizeof(irq_cpu), "%d", profile->irq_cpu);
+  else
+    snprintf (irq_cpu, sizeof(irq_cpu), "default");
+
+  snprintf (buf, len, "sched=%s cpu=%s irq_cpu=%s mlock=%s", sched, cpu,
+            irq_cpu, profile->lock_memory ? "yes" : "no");
+}
@@ -0,0 +1,77 @@
+/*
+ * rt_profile.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _RT_PROFILE_H_
+#define _RT_PROFILE_H_
+
+#include <stddef.h>
+
+#define RT_PREFAULT_STACK     (256 * 1024)  /* Stack touched by rt_lock_memory */
+
+/* -----------------------------------------------------------------------------
+ *
+ * Execution profile of the measurement thread: scheduling policy and
+ * priority, the CPU it runs on and the CPU that services the GPIO IRQ.
+ * A negative CPU leaves the current placement untouched.
+ *
+ */
+typedef struct
+{
+  int priority;     /* SCHED_FIFO priority, 0 for SCHED_OTHER        */
+  int cpu;          /* CPU of the measurement thread, -1: any        */
+  int irq_cpu;      /* CPU of the IRQ (/proc/irq/N/smp_affinity), -1 */
+  int lock_memory;  /* mlockall() and prefault before measuring      */
+} rt_profile_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Locks every current and future page in memory, stops malloc() from
+ * returning memory to the system and touches RT_PREFAULT_STACK bytes of
+ * stack, so no page fault is taken during the measurements.
+ * It returns 0 on success and -1 on failure.
+ *
+ */
+int
+rt_lock_memory (void);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Applies the policy, priority and CPU of a profile to the calling thread.
+ * It returns 0 on success and -1 on failure (e.g. no CAP_SYS_NICE).
+ *
+ */
+int
+rt_apply_thread (const rt_profile_t *profile);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Routes an IRQ to a single CPU through /proc/irq/<irq>/smp_affinity_list.
+ * The first call saves the original affinity for rt_restore_irq().
+ * It returns 0 on success and -1 on failure.
+ *
+ */
+int
+rt_set_irq_cpu (unsigned int irq, int cpu);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Restores the affinity saved by the first rt_set_irq_cpu().
+ *
+ */
+void
+rt_restore_irq (unsigned int irq);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Formats a profile for the output, e.g.
+ * "sched=fifo:80 cpu=1 irq_cpu=0 mlock=yes".
+ *
+ */
+void
+rt_describe (const rt_profile_t *profile, char *buf, size_t len);
+
+#endif /* _RT_PROFILE_H_ */
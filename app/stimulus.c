@@ -0,0 +1,173 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stimulus.h"
+
+#define NSEC_PER_SEC          1000000000.0
+#define STIM_MIN_GAP_NS       1       /* Keeps the schedule moving forward */
+#define STIM_SEED             0x1234
+
+/* -----------------------------------------------------------------------------
+ *
+ * Loads a recorded trace: one inter-arrival time in ns per line.
+ *
+ */
+
+static int
+stim_load_trace (stimulus_t *stim, const char *filename)
+{
+  char line[128], *p, *end;
+  size_t capacity = 0;
+  uint64_t *gaps, gap;
+  FILE *fp;
+
+  if ((fp = fopen (filename, "r")) == NULL)
+    return -1;
+  while (fgets (line, sizeof(line), fp) != NULL)
+  {
+    if ((p = strchr (line, '#')) != NULL)
+      *p = '\0';
+    for (p = line; *p == ' ' || *p == '\t'; p++)
+      ;
+    if (*p == '\n' || *p == '\0')
+      continue;
+    gap = strtoull (p, &end, 10);
+    if (end == p || gap == 0)
+      break;
+    if (stim->num_gaps == capacity)
+    {
+      capacity = capacity ? capacity * 2 : 1024;
+      gaps = realloc (stim->gaps, capacity * sizeof(*gaps));
+      if (gaps == NULL)
+        break;
+      stim->gaps = gaps;
+    }
+    stim->gaps[stim->num_gaps++] = gap;
+    stim->gaps_sum_ns += gap;
+  }
+  /* A line that is not a gap ends the parsing early: the trace is invalid */
+  if (!feof (fp) || stim->num_gaps == 0)
+  {
+    fclose (fp);
+    stim_free (stim);
+    return -1;
+  }
+  fclose (fp);
+  return 0;
+}
+
+int
+stim_parse (stimulus_t *stim, const char *spec)
+{
+  unsigned long on_us, off_us;
+  char extra;
+
+  memset (stim, 0, sizeof(*stim));
+  snprintf (stim->name, sizeof(stim->name), "%s", spec);
+  stim->scale = 1;
+
+  if (sscanf (spec, "fixed:%lf%c", &stim->rate, &extra) == 1)
+    stim->kind = STIM_FIXED;
+  else if (sscanf (spec, "poisson:%lf%c", &stim->rate, &extra) == 1)
+    stim->kind = STIM_POISSON;
+  else if (sscanf (spec, "burst:%lf,%lu,%lu%c", &stim->rate, &on_us, &off_us,
+                   &extra) == 3 && on_us != 0)
+  {
+    stim->kind = STIM_BURST;
+    stim->on_ns = on_us * 1000ULL;
+    stim->off_ns = off_us * 1000ULL;
+  }
+  else if (strncmp (spec, "trace:", 6) == 0)
+  {
+    stim->kind = STIM_TRACE;
+    return stim_load_trace (stim, spec + 6);
+  }
+  else
+    return -1;
+  return stim->rate > 0 ? 0 : -1;
+}
+
+void
+stim_reset (stimulus_t *stim, double scale)
+{
+  stim->scale = scale;
+  stim->next_gap = 0;
+  stim->phase_ns = 0;
+  stim->xsubi[0] = STIM_SEED;
+  stim->xsubi[1] = STIM_SEED >> 4;
+  stim->xsubi[2] = STIM_SEED >> 8;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * The next inter-arrival time. In a burst the edges keep the fixed period
+ * until the next one would fall past the on phase; that one moves to the
+ * start of the next burst.
+ *
+ */
+
+uint64_t
+stim_next_gap (stimulus_t *stim)
+{
+  double gap_ns;
+  uint64_t period;
+
+  switch (stim->kind)
+  {
+    case STIM_POISSON:
+      gap_ns = -log (1.0 - erand48 (stim->xsubi)) * NSEC_PER_SEC
+          / (stim->rate * stim->scale);
+      break;
+    case STIM_BURST:
+      period = NSEC_PER_SEC / (stim->rate * stim->scale);
+      if (period < STIM_MIN_GAP_NS)
+        period = STIM_MIN_GAP_NS;
+      if (stim->phase_ns + period < stim->on_ns)
+      {
+        stim->phase_ns += period;
+        return period;
+      }
+      gap_ns = stim->on_ns + stim->off_ns - stim->phase_ns;
+      stim->phase_ns = 0;
+      break;
+    case STIM_TRACE:
+      gap_ns = stim->gaps[stim->next_gap] / stim->scale;
+      stim->next_gap = (stim->next_gap + 1) % stim->num_gaps;
+      break;
+    default:
+      gap_ns = NSEC_PER_SEC / (stim->rate * stim->scale);
+      break;
+  }
+  return gap_ns > STIM_MIN_GAP_NS ? (uint64_t) gap_ns : STIM_MIN_GAP_NS;
+}
+
+double
+stim_rate (const stimulus_t *stim)
+{
+  uint64_t period, edges;
+
+  switch (stim->kind)
+  {
+    case STIM_BURST:
+      /* Edges at 0, period, ... while still inside the on phase */
+      period = NSEC_PER_SEC / (stim->rate * stim->scale);
+      if (period < STIM_MIN_GAP_NS)
+        period = STIM_MIN_GAP_NS;
+      edges = (stim->on_ns - 1) / period + 1;
+      return edges * NSEC_PER_SEC / (stim->on_ns + stim->off_ns);
+    case STIM_TRACE:
+      return stim->num_gaps * NSEC_PER_SEC * stim->scale / stim->gaps_sum_ns;
+    default:
+      return stim->rate * stim->scale;
+  }
+}
+
+void
+stim_free (stimulus_t *stim)
+{
+  free (stim->gaps);
+  stim->gaps = NULL;
+  stim->num_gaps = 0;
+  stim->gaps_sum_ns = 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * stimulus.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _STIMULUS_H_
+#define _STIMULUS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STIM_NAME_LEN         64
+
+/* -----------------------------------------------------------------------------
+ *
+ * Arrival patterns of the interrupt stimulus:
+ *  fixed:<rate>                 one edge every 1/rate s
+ *  poisson:<rate>               exponential inter-arrival times, mean 1/rate
+ *  burst:<rate>,<on_us>,<off_us> fixed rate during on_us, then off_us idle
+ *  trace:<file>                 replay of recorded inter-arrival times, one
+ *                               per line in ns ('#' starts a comment),
+ *                               looped when the end is reached
+ *
+ */
+typedef enum
+{
+  STIM_FIXED,
+  STIM_POISSON,
+  STIM_BURST,
+  STIM_TRACE,
+  NUM_STIM_KINDS
+} stim_kind_t;
+
+typedef struct
+{
+  stim_kind_t kind;
+  double rate;                     /* Edges/s, during a burst for burst   */
+  uint64_t on_ns;                  /* Burst phases                        */
+  uint64_t off_ns;
+  uint64_t *gaps;                  /* Recorded inter-arrival times (ns)   */
+  size_t num_gaps;
+  uint64_t gaps_sum_ns;
+  double scale;                    /* Offered load multiplier             */
+  size_t next_gap;                 /* Position in the recorded trace      */
+  uint64_t phase_ns;               /* Time of the next edge in its burst  */
+  unsigned short xsubi[3];         /* erand48() state                     */
+  char name[STIM_NAME_LEN];        /* The pattern as given                */
+} stimulus_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Parses a pattern and loads the recorded trace of trace:<file>. It returns
+ * 0 on success and -1 if the pattern or the trace is invalid.
+ *
+ */
+int
+stim_parse (stimulus_t *stim, const char *spec);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Restarts the pattern with its offered load multiplied by scale: the rates
+ * are multiplied (the burst phases are kept) and a trace is replayed scale
+ * times faster. The random sequence restarts too, so every run of a scale
+ * sees the same arrivals.
+ *
+ */
+void
+stim_reset (stimulus_t *stim, double scale);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Returns the time from the current edge to the next one, in ns.
+ *
+ */
+uint64_t
+stim_next_gap (stimulus_t *stim);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Returns the mean offered load at the current scale, in edges/s.
+ *
+ */
+double
+stim_rate (const stimulus_t *stim);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Releases the recorded trace.
+ *
+ */
+void
+stim_free (stimulus_t *stim);
+
+#endif /* _STIMULUS_H_ */
@@ -1,6 +1,7 @@
 #!/bin/bash
 
-for ((;;)) #i=1;i<=300; i++))
-do
-	./gpio_interrupt_monitor
-done
+# One long-running monitor instead of relaunching it in a loop: the process,
+# the mappings and the caches stay warm and a summary is printed per window.
+# Stop it with Ctrl-C (SIGINT) or SIGHUP. Extra arguments are passed through,
+# e.g. "./testForever.sh -T 60 -w read".
+./gpio_interrupt_monitor -c "$@"
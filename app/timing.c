@@ -0,0 +1,215 @@
+#include <setjmp.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+
+#define CALIBRATION_READS     1001
+#define CYCLES_CALIBRATION_NS 50000000ULL  /* 50ms against MONOTONIC_RAW */
+
+static const char *timing_clock_name[NUM_TIMING_CLOCKS] =
+  { "mono", "mono_raw", "cycles" };
+
+static sigjmp_buf probe_env;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Reading the cycle counter raises SIGILL when user access is not enabled
+ * (PMUSERENR on ARM). The first read is done under a temporary handler.
+ *
+ */
+
+static void
+probe_sigill (int signo)
+{
+  (void) signo;
+  siglongjmp (probe_env, 1);
+}
+
+static int
+cycles_available (void)
+{
+  struct sigaction action, old_action;
+  volatile int available = 0;
+
+#if !defined(__arm__) && !defined(__aarch64__) \
+    && !defined(__x86_64__) && !defined(__i386__)
+  return 0;
+#endif
+
+  memset (&action, 0, sizeof(action));
+  action.sa_handler = probe_sigill;
+  sigemptyset (&action.sa_mask);
+  if (sigaction (SIGILL, &action, &old_action) == -1)
+    return 0;
+
+  if (sigsetjmp (probe_env, 1) == 0)
+  {
+    timing_stamp_t first = timing_read_cycles ();
+    struct timespec pause = { 0, 100000 };
+
+    nanosleep (&pause, NULL);
+    /* A counter that user space can read but that is stopped is useless */
+    available = timing_read_cycles () != first;
+  }
+  sigaction (SIGILL, &old_action, NULL);
+  return available;
+}
+
+static uint64_t
+monotonic_ns (clockid_t clock_id)
+{
+  struct timespec ts;
+
+  clock_gettime (clock_id, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+compare_u64 (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Measures the cycle counter frequency against CLOCK_MONOTONIC_RAW.
+ *
+ */
+
+static void
+calibrate_cycles (timing_t *timing)
+{
+  uint64_t t1, t2;
+  timing_stamp_t c1, c2;
+
+  t1 = monotonic_ns (CLOCK_MONOTONIC_RAW);
+  c1 = timing_read_cycles ();
+  do
+  {
+    t2 = monotonic_ns (CLOCK_MONOTONIC_RAW);
+    c2 = timing_read_cycles ();
+  }
+  while (t2 - t1 < CYCLES_CALIBRATION_NS);
+
+#if defined(__arm__)
+  timing->ns_per_tick = (double) (t2 - t1) / (uint32_t) (c2 - c1);
+#else
+  timing->ns_per_tick = (double) (t2 - t1) / (c2 - c1);
+#endif
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Measures the cost of one clock read: the interval between two back-to-back
+ * reads is one read. The median is the baseline subtracted from latencies.
+ *
+ */
+
+static void
+calibrate_read_cost (timing_t *timing)
+{
+  static uint64_t deltas[CALIBRATION_READS];
+  uint64_t min_step = UINT64_MAX;
+  timing_stamp_t t1, t2;
+  int i;
+
+  for (i = 0; i < CALIBRATION_READS; i++)
+  {
+    t1 = timing_read (timing);
+    t2 = timing_read (timing);
+    deltas[i] = timing_delta_ns (timing, t1, t2);
+    if (deltas[i] != 0 && deltas[i] < min_step)
+      min_step = deltas[i];
+  }
+  qsort (deltas, CALIBRATION_READS, sizeof(deltas[0]), compare_u64);
+  timing->read_cost_ns = deltas[CALIBRATION_READS / 2];
+  timing->read_cost_min_ns = deltas[0];
+
+  /* A clock coarser than its read cost shows up as a larger minimum step */
+  if (min_step != UINT64_MAX && min_step > timing->resolution_ns)
+    timing->resolution_ns = min_step;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Selects and calibrates a timing backend.
+ *
+ */
+
+int
+timing_init (timing_t *timing, timing_clock_t clock)
+{
+  struct timespec res;
+
+  if (clock >= NUM_TIMING_CLOCKS)
+    return -1;
+
+  memset (timing, 0, sizeof(*timing));
+  timing->clock = clock;
+  timing->name = timing_clock_name[clock];
+
+  switch (clock)
+  {
+    case TIMING_CYCLES:
+      if (!cycles_available ())
+        return -1;
+      calibrate_cycles (timing);
+      timing->resolution_ns = (uint64_t) (timing->ns_per_tick + 0.5);
+      break;
+    case TIMING_MONOTONIC_RAW:
+      if (clock_getres (CLOCK_MONOTONIC_RAW, &res) == -1)
+        return -1;
+      timing->resolution_ns = res.tv_sec * 1000000000ULL + res.tv_nsec;
+      break;
+    case TIMING_MONOTONIC:
+    default:
+      if (clock_getres (CLOCK_MONOTONIC, &res) == -1)
+        return -1;
+      timing->resolution_ns = res.tv_sec * 1000000000ULL + res.tv_nsec;
+      break;
+  }
+
+  /* Warm up the code path and the vDSO page before measuring */
+  timing_read (timing);
+  calibrate_read_cost (timing);
+  timing_anchor (timing);
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Returns the clock selected by name.
+ *
+ */
+
+timing_clock_t
+timing_clock_by_name (const char *name)
+{
+  timing_clock_t clock;
+
+  for (clock = 0; clock < NUM_TIMING_CLOCKS; clock++)
+  {
+    if (strcmp (name, timing_clock_name[clock]) == 0)
+      break;
+  }
+  return clock;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Records a CLOCK_MONOTONIC reference for timing_to_monotonic().
+ *
+ */
+
+void
+timing_anchor (timing_t *timing)
+{
+  if (timing->clock == TIMING_MONOTONIC)
+    return;
+  timing->anchor_mono_ns = monotonic_ns (CLOCK_MONOTONIC);
+  timing->anchor = timing_read (timing);
+}
@@ -0,0 +1,159 @@
+/*
+ * timing.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/* -----------------------------------------------------------------------------
+ *
+ * Timing backends of the latency measurements. A timestamp (timing_stamp_t)
+ * is the raw value of the selected clock; timing_delta_ns() turns two of them
+ * into nanoseconds. timing_init() measures the read cost and resolution of
+ * the clock, so the monitor can subtract the clock overhead from latencies.
+ *
+ */
+typedef enum
+{
+  TIMING_MONOTONIC = 0,  /* clock_gettime(CLOCK_MONOTONIC), served by vDSO */
+  TIMING_MONOTONIC_RAW,  /* clock_gettime(CLOCK_MONOTONIC_RAW), no NTP slew */
+  TIMING_CYCLES,         /* CPU cycle counter (PMCCNTR on ARM, TSC on x86)  */
+  NUM_TIMING_CLOCKS
+} timing_clock_t;
+
+typedef uint64_t timing_stamp_t;
+
+typedef struct
+{
+  timing_clock_t clock;      /* Selected backend                           */
+  const char *name;          /* Name of the backend                        */
+  double ns_per_tick;        /* Cycle counter period (TIMING_CYCLES)       */
+  uint64_t resolution_ns;    /* Smallest step the clock can report         */
+  uint64_t read_cost_ns;     /* Median cost of one read (the baseline)     */
+  uint64_t read_cost_min_ns; /* Cheapest read observed                     */
+  uint64_t anchor_mono_ns;   /* CLOCK_MONOTONIC at the last timing_anchor  */
+  timing_stamp_t anchor;     /* Clock value at the last timing_anchor      */
+} timing_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Selects and calibrates a timing backend. It returns -1 if the clock is not
+ * usable, e.g. the cycle counter when user access is not enabled.
+ *
+ */
+int
+timing_init (timing_t *timing, timing_clock_t clock);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Returns the clock selected by name ("mono", "mono_raw", "cycles"), or
+ * NUM_TIMING_CLOCKS if the name is unknown.
+ *
+ */
+timing_clock_t
+timing_clock_by_name (const char *name);
+
+/** @brief timing_read_cycles routine: Reads the CPU cycle counter.
+ *  @return The counter value
+ */
+static inline timing_stamp_t
+timing_read_cycles (void)
+{
+#if defined(__arm__)
+  uint32_t cycles;
+
+  __asm__ __volatile__ ("mrc p15, 0, %0, c9, c13, 0" : "=r" (cycles));
+  return cycles;
+#elif defined(__aarch64__)
+  uint64_t cycles;
+
+  __asm__ __volatile__ ("mrs %0, pmccntr_el0" : "=r" (cycles));
+  return cycles;
+#elif defined(__x86_64__) || defined(__i386__)
+  uint32_t lo, hi;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t) hi << 32) | lo;
+#else
+  return 0;
+#endif
+}
+
+/** @brief timing_read routine: Takes a timestamp with the selected clock.
+ *  Safe to call from a signal handler.
+ *  @param timing The timing backend
+ *  @return The timestamp
+ */
+static inline timing_stamp_t
+timing_read (const timing_t *timing)
+{
+  struct timespec ts;
+
+  switch (timing->clock)
+  {
+    case TIMING_CYCLES:
+      return timing_read_cycles ();
+    case TIMING_MONOTONIC_RAW:
+      clock_gettime (CLOCK_MONOTONIC_RAW, &ts);
+      break;
+    case TIMING_MONOTONIC:
+    default:
+      clock_gettime (CLOCK_MONOTONIC, &ts);
+      break;
+  }
+  return (timing_stamp_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** @brief timing_delta_ns routine: Converts the interval between two
+ *  timestamps to nanoseconds. The 32-bit ARM cycle counter may wrap once.
+ *  @param timing The timing backend
+ *  @param start The earlier timestamp
+ *  @param end The later timestamp
+ *  @return The interval in nanoseconds
+ */
+static inline uint64_t
+timing_delta_ns (const timing_t *timing, timing_stamp_t start,
+                 timing_stamp_t end)
+{
+  if (timing->clock != TIMING_CYCLES)
+    return end - start;
+#if defined(__arm__)
+  return (uint64_t) ((uint32_t) (end - start) * timing->ns_per_tick);
+#else
+  return (uint64_t) ((end - start) * timing->ns_per_tick);
+#endif
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Records a CLOCK_MONOTONIC reference for timing_to_monotonic(). Called
+ * before each sample (outside the measured interval) so clocks that drift
+ * from CLOCK_MONOTONIC, or wrap, stay comparable with kernel timestamps.
+ *
+ */
+void
+timing_anchor (timing_t *timing);
+
+/** @brief timing_to_monotonic routine: Converts a timestamp taken after the
+ *  last timing_anchor() to CLOCK_MONOTONIC nanoseconds, the domain of the
+ *  kernel module's ktime_get_ns() records.
+ *  @param timing The timing backend
+ *  @param stamp The timestamp
+ *  @return The CLOCK_MONOTONIC time in nanoseconds
+ */
+static inline uint64_t
+timing_to_monotonic (const timing_t *timing, timing_stamp_t stamp)
+{
+  if (timing->clock == TIMING_MONOTONIC)
+    return stamp;
+  return timing->anchor_mono_ns + timing_delta_ns (timing, timing->anchor,
+                                                   stamp);
+}
+
+#endif /* _TIMING_H_ */
@@ -0,0 +1,228 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+#define TRACE_CHUNK_BYTES     ((off_t) TRACE_CHUNK_RECORDS * sizeof(trace_record_t))
+
+static uint64_t
+clock_ns (clockid_t clock_id)
+{
+  struct timespec ts;
+
+  clock_gettime (clock_id, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static off_t
+record_offset (uint64_t index)
+{
+  return TRACE_HEADER_SIZE + (off_t) index * sizeof(trace_record_t);
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Opens a trace file for writing.
+ *
+ */
+
+int
+trace_create (trace_t *trace, const char *filename, const char *clock,
+              uint64_t read_cost_ns, uint64_t resolution_ns)
+{
+  struct stat st;
+  void *addr;
+
+  memset (trace, 0, sizeof(*trace));
+  trace->fd = open (filename, O_RDWR | O_CREAT, 0644);
+  if (trace->fd == -1)
+    return -1;
+  if (fstat (trace->fd, &st) == -1
+      || (st.st_size != 0 && st.st_size < TRACE_HEADER_SIZE)
+      || (st.st_size == 0 && ftruncate (trace->fd, TRACE_HEADER_SIZE) == -1))
+    goto fail;
+
+  addr = mmap (NULL, TRACE_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+               trace->fd, 0);
+  if (addr == MAP_FAILED)
+    goto fail;
+  trace->header = (trace_header_t *) addr;
+
+  if (st.st_size == 0)
+  {
+    trace->header->magic = TRACE_MAGIC;
+    trace->header->version = TRACE_VERSION;
+    trace->header->record_size = sizeof(trace_record_t);
+    trace->header->records = 0;
+    trace->header->created_ns = clock_ns (CLOCK_REALTIME);
+    trace->header->read_cost_ns = read_cost_ns;
+    trace->header->resolution_ns = resolution_ns;
+    strncpy (trace->header->clock, clock, sizeof(trace->header->clock) - 1);
+  }
+  else if (trace->header->magic != TRACE_MAGIC
+           || trace->header->version != TRACE_VERSION
+           || trace->header->record_size != sizeof(trace_record_t))
+  {
+    munmap (trace->header, TRACE_HEADER_SIZE);
+    goto fail;
+  }
+
+  /* Appending resumes after the last committed record */
+  trace->count = trace->header->records;
+  trace->last_checkpoint = trace->count;
+  trace->chunk_first = trace->count;
+  trace->limit = trace->count;
+  return 0;
+
+fail:
+  close (trace->fd);
+  trace->fd = -1;
+  return -1;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Maps the next chunk of records. Chunks start on a multiple of
+ * TRACE_CHUNK_RECORDS so the mapping offset stays page aligned. Every page
+ * is written once here, so the measurement loop takes no page fault.
+ *
+ */
+
+int
+trace_grow (trace_t *trace)
+{
+  uint64_t first = trace->count & ~((uint64_t) TRACE_CHUNK_RECORDS - 1);
+  size_t keep = (trace->count - first) * sizeof(trace_record_t);
+  void *addr;
+
+  if (trace->chunk != NULL)
+  {
+    munmap (trace->chunk, TRACE_CHUNK_BYTES);
+    trace->chunk = NULL;
+  }
+  if (ftruncate (trace->fd, record_offset (first) + TRACE_CHUNK_BYTES) == -1)
+    return -1;
+
+  addr = mmap (NULL, TRACE_CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED,
+               trace->fd, record_offset (first));
+  if (addr == MAP_FAILED)
+    return -1;
+
+  /* Records already in the chunk (appending to a trace) are kept */
+  memset ((char *) addr + keep, 0, TRACE_CHUNK_BYTES - keep);
+  trace->chunk = (trace_record_t *) addr;
+  trace->chunk_first = first;
+  trace->limit = first + TRACE_CHUNK_RECORDS;
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Writes a checkpoint record and commits the record count.
+ *
+ */
+
+int
+trace_checkpoint (trace_t *trace, uint32_t label, uint16_t mode)
+{
+  trace_record_t *record;
+
+  if (trace->count == trace->limit && trace_grow (trace) == -1)
+    return -1;
+
+  trace->label = label;
+  trace->mode = mode;
+  trace->last_checkpoint = trace->count;
+
+  record = &trace->chunk[trace->count - trace->chunk_first];
+  record->t_assert = clock_ns (CLOCK_REALTIME);
+  record->t_isr = clock_ns (CLOCK_MONOTONIC);
+  record->t_user = 0;
+  record->seq = label;
+  record->cpu = mode;
+  record->flags = TRACE_FLAG_CHECKPOINT;
+  trace->count++;
+
+  /* Records are complete in the page cache before the count covers them */
+  __atomic_store_n (&trace->header->records, trace->count, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Commits the records, trims the preallocated space and closes the trace.
+ *
+ */
+
+int
+trace_close (trace_t *trace)
+{
+  int rc = 0;
+
+  if (trace->fd == -1)
+    return -1;
+
+  trace->header->records = trace->count;
+  if (trace->chunk != NULL)
+    munmap (trace->chunk, TRACE_CHUNK_BYTES);
+  if (ftruncate (trace->fd, record_offset (trace->count)) == -1)
+    rc = -1;
+  munmap (trace->header, TRACE_HEADER_SIZE);
+  close (trace->fd);
+  trace->fd = -1;
+  return rc;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Maps a trace file read-only.
+ *
+ */
+
+long long
+trace_map (const char *filename, const trace_header_t **header,
+           const trace_record_t **records, size_t *length)
+{
+  const trace_header_t *hdr;
+  uint64_t available;
+  struct stat st;
+  void *addr;
+  int fd;
+
+  fd = open (filename, O_RDONLY);
+  if (fd == -1)
+    return -1;
+  if (fstat (fd, &st) == -1 || st.st_size < TRACE_HEADER_SIZE)
+  {
+    close (fd);
+    return -1;
+  }
+  addr = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+  if (addr == MAP_FAILED)
+    return -1;
+
+  hdr = (const trace_header_t *) addr;
+  if (hdr->magic != TRACE_MAGIC || hdr->version != TRACE_VERSION
+      || hdr->record_size != sizeof(trace_record_t))
+  {
+    munmap (addr, st.st_size);
+    return -1;
+  }
+
+  /* A writer that did not close the file leaves preallocated records */
+  available = (st.st_size - TRACE_HEADER_SIZE) / sizeof(trace_record_t);
+  *header = hdr;
+  *records = (const trace_record_t *) ((const char *) addr + TRACE_HEADER_SIZE);
+  *length = st.st_size;
+  return hdr->records < available ? hdr->records : available;
+}
+
+int
+trace_unmap (const trace_header_t *header, size_t length)
+{
+  return munmap ((void *) header, length);
+}
@@ -0,0 +1,147 @@
+/*
+ * trace.h
+ *
+ *  Created on: Mar 31, 2018
+ *      Author: Team 3
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* -----------------------------------------------------------------------------
+ *
+ * Append-only binary trace of every sample. The file starts with a header
+ * page followed by fixed-size records in host byte order. Records are stored
+ * through a preallocated shared mapping, so the measurement loop only copies
+ * 32 bytes per sample; no stdio or system call is involved until the mapped
+ * chunk is full.
+ *
+ * Checkpoint records (TRACE_FLAG_CHECKPOINT) are inserted at every set or
+ * window boundary and every TRACE_CHECKPOINT_INTERVAL records. They carry a
+ * wall-clock / CLOCK_MONOTONIC pair and commit the record count to the
+ * header, so a trace cut short by a crash is valid up to the last one.
+ *
+ */
+#define TRACE_MAGIC               0x43525447UL  /* "GTRC" little-endian */
+#define TRACE_VERSION             1
+#define TRACE_HEADER_SIZE         4096          /* Records start here   */
+#define TRACE_CHUNK_RECORDS       32768         /* Records per mapping  */
+#define TRACE_CHECKPOINT_INTERVAL 4096
+
+#define TRACE_FLAG_ISR            0x0001  /* t_isr, seq and cpu are valid   */
+#define TRACE_FLAG_LOST           0x0002  /* The wait timed out             */
+#define TRACE_FLAG_COALESCED      0x0004  /* The wake-up found more records */
+#define TRACE_FLAG_CHECKPOINT     0x8000  /* Checkpoint, not a sample       */
+
+/*
+ * One sample; times are CLOCK_MONOTONIC nanoseconds (the kernel's domain).
+ * In a checkpoint t_assert is CLOCK_REALTIME, t_isr CLOCK_MONOTONIC at the
+ * same instant, seq the set or window number and cpu the wait mode.
+ */
+typedef struct
+{
+  uint64_t t_assert;  /* Pin asserted                                  */
+  uint64_t t_isr;     /* IRQ entry recorded by the kernel module       */
+  uint64_t t_user;    /* Wait returned in user space                   */
+  uint32_t seq;       /* Interrupt sequence number of the kernel record */
+  uint16_t cpu;       /* CPU that ran the interrupt handler            */
+  uint16_t flags;     /* TRACE_FLAG_*                                  */
+} trace_record_t;
+
+typedef struct
+{
+  uint32_t magic;               /* TRACE_MAGIC                           */
+  uint16_t version;             /* TRACE_VERSION                         */
+  uint16_t record_size;         /* sizeof(trace_record_t)                */
+  uint64_t records;             /* Records committed by the last checkpoint */
+  uint64_t created_ns;          /* CLOCK_REALTIME when the file was created */
+  uint64_t read_cost_ns;        /* Clock baseline to subtract from t_user */
+  uint64_t resolution_ns;       /* Clock resolution                      */
+  char clock[16];               /* Name of the timing backend            */
+} trace_header_t;
+
+typedef struct
+{
+  int fd;
+  trace_header_t *header;       /* Mapped header page                    */
+  trace_record_t *chunk;        /* Mapped chunk of records               */
+  uint64_t chunk_first;         /* Index of chunk[0]                     */
+  uint64_t count;               /* Records written                       */
+  uint64_t limit;               /* First index beyond the mapped chunk   */
+  uint64_t last_checkpoint;     /* Index of the last checkpoint          */
+  uint32_t label;               /* Set or window number of checkpoints   */
+  uint16_t mode;                /* Wait mode of checkpoints              */
+} trace_t;
+
+/* -----------------------------------------------------------------------------
+ *
+ * Opens a trace file for writing. An existing trace is appended to after its
+ * last committed record; otherwise a new header is written. It returns 0 on
+ * success and -1 on failure (e.g. a file that is not a trace).
+ *
+ */
+int
+trace_create (trace_t *trace, const char *filename, const char *clock,
+              uint64_t read_cost_ns, uint64_t resolution_ns);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Maps the next chunk of records, growing the file. Called by
+ * trace_append() when the current chunk is full.
+ *
+ */
+int
+trace_grow (trace_t *trace);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Writes a checkpoint record and commits the record count to the header.
+ * label and mode are kept for the automatic checkpoints that follow.
+ *
+ */
+int
+trace_checkpoint (trace_t *trace, uint32_t label, uint16_t mode);
+
+/** @brief trace_append routine: Stores one record in the mapped chunk.
+ *  @param trace The opened trace
+ *  @param record The record to store
+ *  @return 0 on success, -1 if the file could not grow
+ */
+static inline int
+trace_append (trace_t *trace, const trace_record_t *record)
+{
+  if (trace->count == trace->limit && trace_grow (trace) == -1)
+    return -1;
+  trace->chunk[trace->count - trace->chunk_first] = *record;
+  trace->count++;
+  if (trace->count - trace->last_checkpoint >= TRACE_CHECKPOINT_INTERVAL)
+    return trace_checkpoint (trace, trace->label, trace->mode);
+  return 0;
+}
+
+/* -----------------------------------------------------------------------------
+ *
+ * Commits the records, trims the preallocated space and closes the trace.
+ *
+ */
+int
+trace_close (trace_t *trace);
+
+/* -----------------------------------------------------------------------------
+ *
+ * Maps a trace file read-only. On success header points to the header and
+ * records to the committed records, whose number is returned; -1 is
+ * returned if the file is not a valid trace. Release with trace_unmap().
+ *
+ */
+long long
+trace_map (const char *filename, const trace_header_t **header,
+           const trace_record_t **records, size_t *length);
+
+int
+trace_unmap (const trace_header_t *header, size_t length);
+
+#endif /* _TRACE_H_ */
@@ -0,0 +1,231 @@
+/*
+ ============================================================================
+ Name        : trace_tool.c
+ Author      : Advanced MCU - Spring 2018 - Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Reads the per-sample trace written by gpio_interrupt_monitor
+ (-f option). It prints the percentiles of every interval, converts the
+ trace to CSV or extracts the samples above a latency threshold together
+ with the wall-clock time of the set they belong to.
+ ============================================================================
+ */
+
+/* *************************** INCLUDES *********************************** */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "histogram.h"
+#include "trace.h"
+
+/* ******************* MACROS AND TYPE DEFINITIONS ************************* */
+
+#define NSEC_PER_SEC      1000000000ULL
+#define NSEC_PER_USEC     1000.0
+
+/* ******************* STATIC AND GLOBAL VARIABLES  *********************** */
+
+static histogram_t total_hist;
+static histogram_t hw_isr_hist;
+static histogram_t isr_user_hist;
+static uint64_t read_cost_ns;
+
+/* ********************** FUNCTION IMPLEMENTATION ************************* */
+
+/* Interval minus the clock baseline, as reported by the monitor */
+static uint64_t
+corrected (uint64_t start, uint64_t end)
+{
+  uint64_t delta = end - start;
+
+  return delta > read_cost_ns ? delta - read_cost_ns : 0;
+}
+
+static void
+print_percentiles (const char *name, const histogram_t *hist)
+{
+  if (hist->count == 0)
+    return;
+  printf ("%-28s %9llu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", name,
+          (unsigned long long) hist->count, hist->min / NSEC_PER_USEC,
+          hist_percentile (hist, 50) / NSEC_PER_USEC,
+          hist_percentile (hist, 99) / NSEC_PER_USEC,
+          hist_percentile (hist, 99.9) / NSEC_PER_USEC,
+          hist->max / NSEC_PER_USEC, hist->mean / NSEC_PER_USEC);
+}
+
+/* Wall-clock time of a CLOCK_MONOTONIC stamp, from the last checkpoint */
+static void
+format_wall_clock (const trace_record_t *checkpoint, uint64_t mono_ns,
+                   char *buf, size_t len)
+{
+  uint64_t wall_ns;
+  time_t secs;
+  struct tm tm;
+
+  if (checkpoint == NULL)
+  {
+    snprintf (buf, len, "-");
+    return;
+  }
+  wall_ns = checkpoint->t_assert + (mono_ns - checkpoint->t_isr);
+  secs = wall_ns / NSEC_PER_SEC;
+  localtime_r (&secs, &tm);
+  strftime (buf, len, "%Y-%m-%d %H:%M:%S", &tm);
+  snprintf (buf + 19, len - 19, ".%06llu",
+            (unsigned long long) (wall_ns % NSEC_PER_SEC) / 1000);
+}
+
+/* *************************** MAIN FUNCTION ****************************** */
+
+int
+main (int argc, char **argv)
+{
+  const trace_header_t *header;
+  const trace_record_t *records, *record;
+  const trace_record_t *checkpoint = NULL;
+  unsigned long long lost = 0, checkpoints = 0, printed = 0;
+  double outlier_us = -1;
+  unsigned long max_outliers = 0;
+  int csv = 0;
+  long long count, i;
+  size_t length;
+  char wall[32];
+  int opt;
+
+  while ((opt = getopt (argc, argv, "ck:x:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'c':
+        csv = 1;  // Convert the samples to CSV on stdout
+        break;
+      case 'x':
+        outlier_us = atof (optarg);  // Print samples above this latency
+        break;
+      case 'k':
+        max_outliers = strtoul (optarg, NULL, 0);  // At most this many
+        break;
+      default:
+        optind = argc + 1;
+        break;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    printf ("Usage: %s [-c] [-x threshold_us [-k max_outliers]] trace_file\n",
+            argv[0]);
+    exit (-1);
+  }
+
+  count = trace_map (argv[optind], &header, &records, &length);
+  if (count < 0)
+  {
+    printf ("TRACE_TOOL: %s is not a valid trace\n", argv[optind]);
+    exit (-1);
+  }
+  read_cost_ns = header->read_cost_ns;
+
+  if (csv)
+    printf ("index,set,mode,t_assert_ns,t_isr_ns,t_user_ns,seq,cpu,flags,"
+            "total_ns,assert_to_isr_ns,isr_to_user_ns\n");
+  else if (outlier_us >= 0)
+    printf ("%-10s %-26s %5s %5s %10s %10s %10s %10s %4s %6s\n", "Index",
+            "Wall clock", "Set", "Mode", "Total(us)", "HW(us)", "User(us)",
+            "Seq", "CPU", "Flags");
+
+  hist_reset (&total_hist);
+  hist_reset (&hw_isr_hist);
+  hist_reset (&isr_user_hist);
+
+  for (i = 0; i < count; i++)
+  {
+    uint64_t total, hw_isr = 0, isr_user = 0;
+    int split;
+
+    record = &records[i];
+    if (record->flags & TRACE_FLAG_CHECKPOINT)
+    {
+      checkpoint = record;
+      checkpoints++;
+      continue;
+    }
+    if (record->flags & TRACE_FLAG_LOST)
+      lost++;
+
+    total = corrected (record->t_assert, record->t_user);
+    split = (record->flags & TRACE_FLAG_ISR)
+        && record->t_isr >= record->t_assert
+        && record->t_isr <= record->t_user;
+    if (split)
+    {
+      hw_isr = record->t_isr - record->t_assert;
+      isr_user = corrected (record->t_isr, record->t_user);
+    }
+
+    if (csv)
+    {
+      printf ("%lld,%u,%u,%llu,%llu,%llu,%u,%u,0x%x,%llu,", i,
+              checkpoint ? checkpoint->seq : 0,
+              checkpoint ? checkpoint->cpu : 0,
+              (unsigned long long) record->t_assert,
+              (unsigned long long) record->t_isr,
+              (unsigned long long) record->t_user, record->seq,
+              record->cpu, record->flags, (unsigned long long) total);
+      if (split)
+        printf ("%llu,%llu\n", (unsigned long long) hw_isr,
+                (unsigned long long) isr_user);
+      else
+        printf (",\n");
+      continue;
+    }
+
+    /* Timed-out samples stay out of the statistics, as in the monitor */
+    if (record->flags & TRACE_FLAG_LOST)
+      continue;
+
+    hist_add (&total_hist, total);
+    if (split)
+    {
+      hist_add (&hw_isr_hist, hw_isr);
+      hist_add (&isr_user_hist, isr_user);
+    }
+
+    if (outlier_us >= 0 && total / NSEC_PER_USEC > outlier_us
+        && (max_outliers == 0 || printed < max_outliers))
+    {
+      format_wall_clock (checkpoint, record->t_assert, wall, sizeof(wall));
+      printf ("%-10lld %-26s %5u %5u %10.3f ", i, wall,
+              checkpoint ? checkpoint->seq : 0,
+              checkpoint ? checkpoint->cpu : 0, total / NSEC_PER_USEC);
+      if (split)
+        printf ("%10.3f %10.3f %10u %4u", hw_isr / NSEC_PER_USEC,
+                isr_user / NSEC_PER_USEC, record->seq, record->cpu);
+      else
+        printf ("%10s %10s %10s %4s", "-", "-", "-", "-");
+      printf (" 0x%04x\n", record->flags);
+      printed++;
+    }
+  }
+
+  if (!csv)
+  {
+    if (outlier_us >= 0)
+      printf ("\n");
+    printf ("Trace: %s, clock %s, read cost %lluns subtracted\n",
+            argv[optind], header->clock,
+            (unsigned long long) header->read_cost_ns);
+    printf ("Records: %lld (%llu checkpoints), lost interrupts: %llu\n",
+            count, checkpoints, lost);
+    printf ("%-28s %9s %10s %10s %10s %10s %10s %10s\n", "Interval",
+            "Samples", "Min(us)", "p50(us)", "p99(us)", "p99.9(us)",
+            "Max(us)", "Mean(us)");
+    print_percentiles ("Pin assert to user (total)", &total_hist);
+    print_percentiles ("Pin assert to IRQ entry", &hw_isr_hist);
+    print_percentiles ("IRQ entry to user", &isr_user_hist);
+  }
+  trace_unmap (header, length);
+  return 0;
+}
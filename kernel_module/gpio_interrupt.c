@@ -20,6 +20,33 @@
 #include <linux/platform_device.h>
 #include <asm/errno.h>
 #include <linux/signal.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/smp.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
+#include <linux/atomic.h>
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/bitops.h>
+#include <linux/version.h>
+#include <linux/eventfd.h>
+#include <linux/workqueue.h>
+#include <linux/cdev.h>
+#include <linux/device.h>
+#include <linux/slab.h>
+#include <linux/kref.h>
+#include <asm/io.h>
+#include "gpio_interrupt.h"
+
+#define CREATE_TRACE_POINTS
+#include "gpio_interrupt_trace.h"
 
 /* ******************* MACROS AND DEFINITIONS ****************************** */
 
@@ -31,20 +58,223 @@
 #define FALSE                 0
 
 #define GPIO_MODULE_VERSION   "1.0"
-#define GPIO_MAJOR            243 // Need to mknod /dev/gpio_int c 243 0
+#define GPIO_MAX_DEVICES      8   // Minors of /dev/gpio_intN
 #define GPIO_MODULE_NAME      "gpio-interrupt"
 #define GPIO_CHAR_DEV_NAME    "gpio_int"
-#define GPIO_PROC_ENTRY       GPIO_MODULE_NAME
+#define GPIO_PROC_ENTRY       GPIO_MODULE_NAME // Link to the entry of gpio_int0
+#define GPIO_READ_BATCH       16  // Records copied to user space per chunk
+#define GPIO_LATENCY_REG_ADDR GPIO_SIM_REG_OFFSET // int_latency_0, no reg property
+#define GPIO_LOOPBACK_MIN_NS  1000 // Shortest loopback period
+#define GPIO_COALESCE_MAX_US  1000000 // Longest coalescing time limit
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+#define GPIO_eventfd_signal(ctx) eventfd_signal(ctx)
+#else
+#define GPIO_eventfd_signal(ctx) eventfd_signal(ctx, 1)
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+#define GPIO_class_create(name) class_create(name)
+#else
+#define GPIO_class_create(name) class_create(THIS_MODULE, name)
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+#define GPIO_pde_data(inode) pde_data(inode)
+#else
+#define GPIO_pde_data(inode) PDE_DATA(inode)
+#endif
+
+// hrtimer_setup() replaces hrtimer_init() and the function assignment
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+#define GPIO_hrtimer_setup(timer, fn, mode) \
+  hrtimer_setup(timer, fn, CLOCK_MONOTONIC, mode)
+#else
+#define GPIO_hrtimer_setup(timer, fn, mode) \
+  do { \
+    hrtimer_init(timer, CLOCK_MONOTONIC, mode); \
+    (timer)->function = (fn); \
+  } while (0)
+#endif
+
+// Before 4.20 every hrtimer expired in hard interrupt context
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 20, 0)
+#define HRTIMER_MODE_REL_HARD HRTIMER_MODE_REL
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+#define GPIO_vm_flags_clear(vma, flags) vm_flags_clear(vma, flags)
+#else
+#define GPIO_vm_flags_clear(vma, flags) ((vma)->vm_flags &= ~(flags))
+#endif
 
 /* ******************* STATIC AND GLOBAL VARIABLES  ************************ */
-static unsigned int GPIO_interruptcount         = 0;
-unsigned int GPIO_interrupt_number              = 0;
-static struct proc_dir_entry *GPIO_proc_entry   = NULL;
-static struct fasync_struct *GPIO_fasync_queue  = NULL;
+
+/*
+* Statistics of GPIO_int_handler(), one copy per CPU. Only the handler
+* writes them, on its own CPU and with interrupts disabled, so no lock or
+* atomic is needed; /proc/gpio-interruptN sums the copies. On 32-bit CPUs a
+* 64-bit value read while it is updated may be torn, which only affects that
+* one report; GPIO_IOC_GET_STATS blocks the handler for an exact snapshot.
+* Bucket i of a histogram counts values in [2^(i-1), 2^i) ns.
+*/
+struct GPIO_cpu_stats {
+  u64 count;                // Interrupts handled on this CPU
+  u64 notifications;        // Wake-ups/signals sent from this CPU
+  u64 last_entry;           // IRQ entry time of the last one
+  struct gpio_int_stat isr; // Time spent in the handler
+  struct gpio_int_stat gap; // Interval since the previous interrupt (any CPU)
+  struct gpio_int_stat thread; // IRQ entry to IRQ thread, written by the thread
+  u64 thread_entry;         // IRQ entry of the last thread sample
+};
+
+/*
+* One int_latency core: allocated by GPIO_probe() for each matching device
+* tree node, or for each simulated platform device, and reached through the
+* cdev of /dev/gpio_intN, the proc entry or the dev_id of the handler.
+* An unbind only unregisters it: every open file holds a reference, and the
+* last one frees it (GPIO_free()).
+*/
+struct GPIO_dev {
+  int index;                         // N of /dev/gpio_intN
+  struct platform_device *pdev;
+  struct kref kref;                  // Probe and open files
+  struct cdev *cdev;                 // Outlives the instance until fput()
+  struct device *device;             // Node created by udev
+  struct proc_dir_entry *proc_entry; // /proc/gpio-interruptN
+  struct proc_dir_entry *proc_link;  // /proc/gpio-interrupt, instance 0
+  unsigned int irq;                  // IRQ number, 0 in the simulation
+  unsigned char irq_requested;
+  unsigned char cdev_added;
+  unsigned char gone;                // Unbound, under ctl_mutex
+  phys_addr_t reg_addr;              // int_latency register, 0: no loopback
+  unsigned int interruptcount;
+
+  /*
+  * Ring of interrupt records, allocated with vmalloc_user() so it can be
+  * mapped into user space. GPIO_int_handler() is the only producer: it
+  * fills the slot of the next sequence number and then publishes
+  * ring->head. The seq field of a slot is written before the rest of the
+  * record, so a reader can tell a complete record from one that is being
+  * overwritten (see GPIO_copy_event()).
+  */
+  struct gpio_int_ring *ring;
+  wait_queue_head_t wait_queue;      // Woken by the handler
+  struct fasync_struct *fasync_queue; // One entry per O_ASYNC file
+  atomic_t users;                    // Open files
+
+  struct GPIO_cpu_stats __percpu *stats;
+  u64 last_entry;                    // Written by the handler
+
+  /*
+  * Runtime configuration, set through the ioctl control plane and read by
+  * the handler with READ_ONCE(). ctl_mutex serializes the ioctl calls.
+  */
+  u32 notify_mask;
+  u32 coalesce_count;
+  u32 coalesce_us;
+  atomic_t coalesce_pending;         // Records not notified yet
+  struct hrtimer coalesce_timer;
+  u32 trigger;
+  u32 debug;
+  u32 irq_mode;
+  u64 thread_entry;                  // Entry that woke the thread
+  struct mutex ctl_mutex;
+
+  /*
+  * The eventfd registered with GPIO_IOC_SET_EVENTFD and the file that
+  * registered it. efd_lock keeps the context alive while it is signalled.
+  */
+  struct eventfd_ctx *efd;
+  struct file *efd_owner;
+  spinlock_t efd_lock;
+
+  /*
+  * Loopback mode (GPIO_IOC_LOOPBACK_START): lb_timer asserts bit 0 of the
+  * int_latency register, mapped with ioremap(), and GPIO_int_handler()
+  * deasserts it, so no user task is involved in a sample. lb_lock orders
+  * the two; lb_edge is the time of the pending assertion, 0 when none is
+  * pending.
+  */
+  void __iomem *lb_reg;
+  struct hrtimer lb_timer;
+  spinlock_t lb_lock;
+  u32 lb_running;
+  u64 lb_period_ns;
+  u64 lb_limit;                      // Edges, 0: no limit
+  u64 lb_edge;
+  struct gpio_int_loopback_stats lb_stats;
+
+#ifdef GPIO_SIMULATION
+  u32 *sim_regs;
+  struct hrtimer sim_poll_timer;
+  struct hrtimer sim_irq_timer;
+  spinlock_t sim_lock;
+  struct work_struct sim_thread_work; // Stands in for the IRQ thread
+  struct work_struct sim_irq_work;    // Forced IRQ thread (PREEMPT_RT)
+#endif
+};
+
+/*
+* State of one open file: every subscriber consumes the whole event stream
+* through its own read() cursor, at its own pace. The handler never looks
+* at the cursors, so its cost does not grow with the number of subscribers;
+* a subscriber that falls more than a ring behind loses the oldest records,
+* which are counted in its overruns.
+*/
+struct GPIO_file {
+  struct GPIO_dev *dev;
+  unsigned int read_tail;            // Next record of this file
+  unsigned int read_overruns;        // Records it lost
+  struct mutex read_mutex;           // Threads sharing the file
+};
+
+/*
+* The char device region and class shared by the instances. GPIO_minors
+* tracks the N in use and GPIO_devs the instance open() finds for each,
+* under GPIO_devices_mutex.
+*/
+static dev_t GPIO_devt;
+static struct class *GPIO_class                 = NULL;
+static DECLARE_BITMAP(GPIO_minors, GPIO_MAX_DEVICES);
+static struct GPIO_dev *GPIO_devs[GPIO_MAX_DEVICES];
+static DEFINE_MUTEX(GPIO_devices_mutex);
 static unsigned char platform_driver_registered = FALSE;
 static unsigned char char_dev_registered        = FALSE;
-static unsigned char proc_entry_created         = FALSE;
-static unsigned char interrupt_requested        = FALSE;
+
+static bool threaded_irq = false;
+module_param(threaded_irq, bool, 0444);
+MODULE_PARM_DESC(threaded_irq, "Start with a threaded IRQ handler (GPIO_IOC_SET_IRQ_MODE changes it)");
+
+#ifdef GPIO_SIMULATION
+/*
+* Simulation build (make SIM=1): no device-tree node nor IRQ line is needed.
+* sim_devices platform devices are registered by the module itself and
+* probed like the real cores. For each one a zeroed kernel page stands in
+* for the FPGA register page and is mapped at file offset
+* GPIO_SIM_REG_OFFSET of /dev/gpio_intN, so the monitor runs with
+* "-m /dev/gpio_intN". Bit 0 is a self-clearing trigger: when write() or a
+* sampling hrtimer finds it set, it is cleared and a one-shot hrtimer runs
+* the interrupt handler sim_delay_ns later, in hard interrupt context like
+* the real one. On PREEMPT_RT, where the real handler is force-threaded,
+* the hard timer hands the handler to a work item instead. Clearing bit 0
+* lets sampling catch every assertion, even when the pin is deasserted and
+* asserted again between two samples.
+*/
+static unsigned int sim_devices = 1;
+module_param(sim_devices, uint, 0444);
+MODULE_PARM_DESC(sim_devices, "Number of simulated devices, /dev/gpio_int0 and up (1 to 8)");
+
+static unsigned long sim_delay_ns = 1000;
+module_param(sim_delay_ns, ulong, 0644);
+MODULE_PARM_DESC(sim_delay_ns, "Delay from the rising edge of bit 0 to the simulated interrupt (ns)");
+
+static unsigned long sim_poll_ns = 10000;
+module_param(sim_poll_ns, ulong, 0644);
+MODULE_PARM_DESC(sim_poll_ns, "Sampling period of the mapped register page, 0 for write() only (ns)");
+
+static struct platform_device *GPIO_sim_pdevs[GPIO_MAX_DEVICES];
+#endif
 
 /* ************************* FUNCTION PROPOTOTYPES ************************** */
 
@@ -74,13 +304,21 @@ static void __exit GPIO_exit(void);
  *  @param irq    the IRQ number that is associated with the GPIO -- useful for
  *                logging.
  *  @param dev_id the *dev_id that is provided -- can be used to identify which
- *                device caused the interrupt. Not used in this case as NULL
- *                is passed.
+ *                device caused the interrupt. It is the struct GPIO_dev of
+ *                the instance.
  *  return returns IRQ_HANDLED if successful -- should return IRQ_NONE
  *  otherwise.
  */
 static irqreturn_t GPIO_int_handler(int irq, void *dev_id);
 
+/** @brief The IRQ thread of the threaded mode. It runs after the hard
+ *  handler returned IRQ_WAKE_THREAD and sends the notifications.
+ *  @param irq    the IRQ number
+ *  @param dev_id the struct GPIO_dev of the instance
+ *  @return IRQ_HANDLED
+ */
+static irqreturn_t GPIO_int_thread(int irq, void *dev_id);
+
 
 /** @brief The device open function that is called each time the device is opened
  *  This will only increment the numberOpens counter in this case.
@@ -91,8 +329,10 @@ static int GPIO_open (struct inode *inode, struct file *filp);
 
 /** @brief This function is called whenever device is being read from user space
  *  i.e. data is being sent from the device to the user. In this case is uses
- *  the copy_to_user() function to send the buffer string to the user and
- *  captures any errors.
+ *  the copy_to_user() function to send a batch of struct gpio_int_event
+ *  records (IRQ entry timestamp and sequence number) to the user and
+ *  captures any errors. When no new record is available it sleeps on the
+ *  wait queue, or returns -EAGAIN if the file was opened with O_NONBLOCK.
  *  @param filep A pointer to a file object (defined in linux/fs.h)
  *  @param buffer The pointer to the buffer to which this function writes the
  *         data
@@ -130,11 +370,93 @@ static int GPIO_release(struct inode *inodep, struct file *filep);
 */
 static int GPIO_fasync (int fd, struct file *filp, int on);
 
+/** @brief This is invoked by the mmap() system call. It maps the event ring
+ *  (struct gpio_int_ring) read-only into the calling process, so the records
+ *  can be consumed without any system call.
+ *  @param filp A pointer to a file object (defined in linux/fs.h)
+ *  @param vma The user virtual memory area to be mapped
+ */
+static int GPIO_mmap (struct file *filp, struct vm_area_struct *vma);
+
+/** @brief This is invoked by poll(), select() and epoll. The caller is added
+ *  to the wait queue woken by GPIO_int_handler().
+ *  @param filp A pointer to a file object (defined in linux/fs.h)
+ *  @param wait The poll table of the caller
+ *  @return POLLIN | POLLRDNORM when records are waiting to be read
+ */
+static unsigned int GPIO_poll (struct file *filp, poll_table *wait);
+
+
+/** @brief seq_file show function of /proc/gpio-interrupt: per-CPU counts,
+ *  min/max/last of the handler time and of the interval between interrupts,
+ *  and their log2 histograms.
+ *  @param m The seq_file
+ *  @param v Unused (single_open)
+ */
+static int GPIO_proc_show(struct seq_file *m, void *v);
+
+/** @brief Clears the per-CPU statistics.
+ *  @param dev The instance
+ */
+static void GPIO_reset_stats(struct GPIO_dev *dev);
+
+/** @brief This is invoked by the ioctl() system call: the control plane of
+ *  the driver (info, statistics snapshot/reset, notification mask,
+ *  coalescing, trigger, IRQ mode, eventfd, debug output and loopback). See
+ *  GPIO_IOC_* in gpio_interrupt.h.
+ *  @param filp A pointer to a file object (defined in linux/fs.h)
+ *  @param cmd The GPIO_IOC_* command
+ *  @param arg The user pointer or value of the command
+ *  @return 0 on success, a negative error code otherwise
+ */
+static long GPIO_ioctl (struct file *filp, unsigned int cmd, unsigned long arg);
+
+/** @brief hrtimer callback of the loopback mode: asserts the pin once per
+ *  period, or counts the timeout of an edge that was not handled.
+ */
+static enum hrtimer_restart GPIO_lb_tick(struct hrtimer *timer);
+
+/** @brief hrtimer callback of the coalescing time limit: notifies the
+ *  records still pending coalesce_us after the first one.
+ */
+static enum hrtimer_restart GPIO_coalesce_expire(struct hrtimer *timer);
+
+/** @brief Stops the loopback mode and deasserts the pin. Process context.
+ *  @param dev The instance
+ */
+static void GPIO_lb_stop(struct GPIO_dev *dev);
+
+/** @brief Frees an instance when its last reference is dropped.
+ *  @param kref The kref of the struct GPIO_dev
+ */
+static void GPIO_free(struct kref *kref);
 
-static int GPIO_remove(struct platform_device *pdev);
+static void GPIO_remove(struct platform_device *pdev);
 
 static int GPIO_probe(struct platform_device *pdev);
 
+#ifdef GPIO_SIMULATION
+/** @brief Samples the simulated register and raises the simulated interrupt
+ *  sim_delay_ns after bit 0 was set. Safe in any context.
+ */
+static void GPIO_sim_sample(struct GPIO_dev *dev);
+
+/** @brief hrtimer callbacks of the simulation: the sampling of the mapped
+ *  register page and the delayed interrupt.
+ */
+static enum hrtimer_restart GPIO_sim_poll(struct hrtimer *timer);
+static enum hrtimer_restart GPIO_sim_fire(struct hrtimer *timer);
+
+/** @brief Work item standing in for the IRQ thread in threaded mode.
+ */
+static void GPIO_sim_thread(struct work_struct *work);
+
+/** @brief Work item standing in for the force-threaded handler of
+ *  PREEMPT_RT: runs the handler, then the IRQ thread if it is woken.
+ */
+static void GPIO_sim_forced(struct work_struct *work);
+#endif
+
 
 
 /* ************************ STRUCTURES AND TYPEDEFS ************************* */
@@ -148,9 +470,10 @@ struct file_operations gpio_fops = {
   .llseek         = NULL,         // Change current read/write position in a file
   .read           = GPIO_read,    // Used to retrieve data from the device
   .write          = GPIO_write,   // Used to send data to the device
-  .poll           = NULL,         // Does a read or write block?
-  .unlocked_ioctl = NULL,         // Called by the ioctl system call
-  .mmap           = NULL,         // Called by mmap system call
+  .poll           = GPIO_poll,    // Does a read or write block?
+  .unlocked_ioctl = GPIO_ioctl,   // Called by the ioctl system call
+  .compat_ioctl   = GPIO_ioctl,   // Same layout for 32-bit callers
+  .mmap           = GPIO_mmap,    // Called by mmap system call
   .open           = GPIO_open,    // first operation performed on a device file
   .flush          = NULL,         // called when a process closes its copy of the descriptor
   .release        = GPIO_release, // called when a file structure is being released
@@ -159,18 +482,56 @@ struct file_operations gpio_fops = {
   .lock           = NULL,         // used to implement file locking
 };
 
+static int GPIO_proc_open(struct inode *inode, struct file *file)
+{
+  return single_open(file, GPIO_proc_show, GPIO_pde_data(inode));
+}
+
+/*
+* /proc/gpio-interruptN is a read-only seq_file
+*/
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 6, 0)
+static const struct proc_ops gpio_proc_fops = {
+  .proc_open    = GPIO_proc_open,
+  .proc_read    = seq_read,
+  .proc_lseek   = seq_lseek,
+  .proc_release = single_release,
+};
+#else
+static const struct file_operations gpio_proc_fops = {
+  .owner   = THIS_MODULE,
+  .open    = GPIO_proc_open,
+  .read    = seq_read,
+  .llseek  = seq_lseek,
+  .release = single_release,
+};
+#endif
+
 static const struct of_device_id gpio_of_match[] = {
   { .compatible = "xlnx,gpio-interrupt-1.0" },
   { /* end of table */ }
 };
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 11, 0)
+// The remove callback returned int before 6.11
+static int GPIO_remove_int(struct platform_device *pdev)
+{
+  GPIO_remove(pdev);
+  return 0;
+}
+#endif
+
 static struct platform_driver gpio_driver = {
   .driver = {
     .name           = GPIO_MODULE_NAME,
     .of_match_table = gpio_of_match,
   },
   .probe  = GPIO_probe,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
   .remove = GPIO_remove,
+#else
+  .remove = GPIO_remove_int,
+#endif
 };
 
 MODULE_DEVICE_TABLE(of, gpio_of_match);
@@ -178,44 +539,350 @@ MODULE_DEVICE_TABLE(of, gpio_of_match);
 
 /* ************************ FUNCTION IMPLEMENTATION ************************* */
 
+static inline struct GPIO_dev *GPIO_dev_of(struct file *filp)
+{
+  return ((struct GPIO_file *) filp->private_data)->dev;
+}
+
 int GPIO_open (struct inode *inode, struct file *filp)
 {
-  printk("GPIO_KMOD: gpio_open\n");
+  struct GPIO_dev *dev;
+  struct GPIO_file *file;
+  int users;
+
+  // The instance may be unbound while the open is on its way
+  mutex_lock(&GPIO_devices_mutex);
+  dev = GPIO_devs[iminor(inode)];
+  if (dev != NULL)
+    kref_get(&dev->kref);
+  mutex_unlock(&GPIO_devices_mutex);
+  if (dev == NULL)
+    return -ENODEV;
+
+  file = kzalloc(sizeof(*file), GFP_KERNEL);
+  if (file == NULL)
+  {
+    kref_put(&dev->kref, GPIO_free);
+    return -ENOMEM;
+  }
+  // A new subscriber starts with the next interrupt
+  file->dev = dev;
+  file->read_tail = smp_load_acquire(&dev->ring->head);
+  mutex_init(&file->read_mutex);
+  filp->private_data = file;
+
+  users = atomic_inc_return(&dev->users);
+  printk("GPIO_KMOD: gpio_open %s%d, %d open\n", GPIO_CHAR_DEV_NAME,
+         dev->index, users);
+#ifdef GPIO_SIMULATION
+  // The register page is only sampled while the device is in use
+  if (users == 1 && sim_poll_ns != 0)
+    hrtimer_start(&dev->sim_poll_timer, ns_to_ktime(sim_poll_ns),
+                  HRTIMER_MODE_REL_HARD);
+#endif
   return 0; /* success */
 }
 
+/* ===================================================================
+* function: GPIO_copy_event
+*
+* Copies the record of sequence number seq out of the ring. Returns FALSE
+* when the slot was (or is being) overwritten by a newer interrupt.
+*/
+static int GPIO_copy_event(struct GPIO_dev *dev, unsigned int seq,
+                           struct gpio_int_event *ev)
+{
+  struct gpio_int_event *slot = &dev->ring->events[seq & GPIO_EVENT_RING_MASK];
+
+  if (READ_ONCE(slot->seq) != seq)
+    return FALSE;
+  smp_rmb();
+  *ev = *slot;
+  smp_rmb();
+  return READ_ONCE(slot->seq) == seq;
+}
+
 ssize_t GPIO_read (struct file *filp,
                    char __user *buff, size_t count, loff_t *offp)
 {
+  struct GPIO_file *file = filp->private_data;
+  struct GPIO_dev *dev = file->dev;
+  struct gpio_int_event batch[GPIO_READ_BATCH];
+  unsigned int head, tail, n;
+  size_t copied = 0;
+
+  if (count < sizeof(struct gpio_int_event))
+    return -EINVAL;
+
+retry:
+  if (mutex_lock_interruptible(&file->read_mutex))
+    return -ERESTARTSYS;
+
+  tail = file->read_tail;
+  while (copied + sizeof(struct gpio_int_event) <= count)
+  {
+    head = smp_load_acquire(&dev->ring->head);
+    if (head - tail > GPIO_EVENT_RING_SIZE)
+    {
+      // The reader fell behind: skip the records that were overwritten
+      file->read_overruns += head - tail - GPIO_EVENT_RING_SIZE;
+      tail = head - GPIO_EVENT_RING_SIZE;
+    }
+    if (head == tail)
+      break;
+
+    for (n = 0; n < GPIO_READ_BATCH && tail + n != head &&
+                copied + (n + 1) * sizeof(struct gpio_int_event) <= count; n++)
+    {
+      if (!GPIO_copy_event(dev, tail + n, &batch[n]))
+        break;
+    }
+    if (n == 0)
+    {
+      // Overwritten while copying, restart from the current head
+      file->read_overruns++;
+      tail++;
+      continue;
+    }
+    if (copy_to_user(buff + copied, batch, n * sizeof(struct gpio_int_event)))
+    {
+      mutex_unlock(&file->read_mutex);
+      return -EFAULT;
+    }
+    copied += n * sizeof(struct gpio_int_event);
+    tail += n;
+  }
+  file->read_tail = tail;
+  mutex_unlock(&file->read_mutex);
+
+  if (copied == 0)
+  {
+    // Nothing recorded since the last read
+    if (READ_ONCE(dev->gone))
+      return -ENODEV;
+    if (filp->f_flags & O_NONBLOCK)
+      return -EAGAIN;
+    if (wait_event_interruptible(dev->wait_queue,
+          smp_load_acquire(&dev->ring->head) != READ_ONCE(file->read_tail) ||
+          READ_ONCE(dev->gone)))
+      return -ERESTARTSYS;
+    goto retry;
+  }
+  trace_gpio_int_wake(dev->index, tail - 1, GPIO_WAKE_READ);
+  return copied;
+}
+
+/* ===================================================================
+* function: gpio_poll
+*
+* Reports the device readable while the read() cursor of this file is
+* behind the head of the event ring, and hung up once it is unbound.
+*/
+static unsigned int GPIO_poll (struct file *filp, poll_table *wait)
+{
+  struct GPIO_file *file = filp->private_data;
+  struct GPIO_dev *dev = file->dev;
+  unsigned int head;
+
+  poll_wait(filp, &dev->wait_queue, wait);
+  head = smp_load_acquire(&dev->ring->head);
+  if (head != READ_ONCE(file->read_tail))
+  {
+    trace_gpio_int_wake(dev->index, head - 1, GPIO_WAKE_POLL);
+    return POLLIN | POLLRDNORM;
+  }
+  if (READ_ONCE(dev->gone))
+    return POLLHUP | POLLERR;
   return 0;
 }
 
 ssize_t GPIO_write (struct file *filp,
                    const char __user *buf, size_t count,loff_t *f_pos)
 {
+#ifdef GPIO_SIMULATION
+  struct GPIO_dev *dev = GPIO_dev_of(filp);
+  u32 value;
+
+  // A 32-bit write sets the simulated register, like a store to the page
+  if (count < sizeof(value))
+    return -EINVAL;
+  if (copy_from_user(&value, buf, sizeof(value)))
+    return -EFAULT;
+  if (READ_ONCE(dev->gone))
+    return -ENODEV;
+  WRITE_ONCE(dev->sim_regs[0], value);
+  GPIO_sim_sample(dev);
+  return sizeof(value);
+#else
   return 0;
+#endif
 }
 
+#ifdef GPIO_SIMULATION
 /* ===================================================================
-* gpio_probe - Initialization method for a zynq_gpio device
-* Return: 0 on success, negative error otherwise.
+* function: GPIO_sim_sample
+*
+* Takes an assertion of bit 0 of the simulated register (bit 0 of the first
+* little-endian word). The assertion seen by the sampling timer is late by
+* up to sim_poll_ns; write() sees it at once. Both the bit and the timer
+* are atomic on their own, so no lock is taken: the sampling timer runs in
+* hard interrupt context, where sim_lock may sleep on PREEMPT_RT.
 */
-static int GPIO_probe(struct platform_device *pdev)
+static void GPIO_sim_sample(struct GPIO_dev *dev)
 {
-  struct resource *res;
+  if (test_and_clear_bit(0, (unsigned long *) dev->sim_regs))
+    hrtimer_start(&dev->sim_irq_timer, ns_to_ktime(sim_delay_ns),
+                  HRTIMER_MODE_REL_HARD);
+}
 
-  printk("GPIO_KMOD: Starting probe\n");
-  // This code gets the IRQ number by probing the system.
-  res = platform_get_resource(pdev, IORESOURCE_IRQ, 0);
-  if (!res)
+static enum hrtimer_restart GPIO_sim_poll(struct hrtimer *timer)
+{
+  struct GPIO_dev *dev = container_of(timer, struct GPIO_dev, sim_poll_timer);
+
+  GPIO_sim_sample(dev);
+  if (sim_poll_ns == 0)
+    return HRTIMER_NORESTART;
+  hrtimer_forward_now(timer, ns_to_ktime(sim_poll_ns));
+  return HRTIMER_RESTART;
+}
+
+static enum hrtimer_restart GPIO_sim_fire(struct hrtimer *timer)
+{
+  struct GPIO_dev *dev = container_of(timer, struct GPIO_dev, sim_irq_timer);
+
+  if (IS_ENABLED(CONFIG_PREEMPT_RT))
   {
-    printk("GPIO_KMOD: No IRQ found\n");
-    return 0;
+    queue_work(system_highpri_wq, &dev->sim_irq_work);
+    return HRTIMER_NORESTART;
+  }
+
+  // The lock stands in for disable_irq() of the control plane
+  spin_lock(&dev->sim_lock);
+  if (GPIO_int_handler(0, dev) == IRQ_WAKE_THREAD)
+    queue_work(system_highpri_wq, &dev->sim_thread_work);
+  spin_unlock(&dev->sim_lock);
+  return HRTIMER_NORESTART;
+}
+
+static void GPIO_sim_thread(struct work_struct *work)
+{
+  struct GPIO_dev *dev = container_of(work, struct GPIO_dev, sim_thread_work);
+  unsigned long flags;
+
+  spin_lock_irqsave(&dev->sim_lock, flags);
+  GPIO_int_thread(0, dev);
+  spin_unlock_irqrestore(&dev->sim_lock, flags);
+}
+
+static void GPIO_sim_forced(struct work_struct *work)
+{
+  struct GPIO_dev *dev = container_of(work, struct GPIO_dev, sim_irq_work);
+  unsigned long flags;
+
+  spin_lock_irqsave(&dev->sim_lock, flags);
+  if (GPIO_int_handler(0, dev) == IRQ_WAKE_THREAD)
+    GPIO_int_thread(0, dev);
+  spin_unlock_irqrestore(&dev->sim_lock, flags);
+}
+#endif
+
+/* ===================================================================
+* function: GPIO_stat_add
+*
+* Records one value in a statistic of the current CPU.
+*/
+static inline void GPIO_stat_add(struct gpio_int_stat *stat, u64 value)
+{
+  unsigned int bucket = value ? fls64(value) : 0;
+
+  if (bucket >= GPIO_STAT_BUCKETS)
+    bucket = GPIO_STAT_BUCKETS - 1;
+  stat->hist[bucket]++;
+  if (value < stat->min)
+    stat->min = value;
+  if (value > stat->max)
+    stat->max = value;
+  stat->last = value;
+}
+
+/* ===================================================================
+* function: GPIO_account
+*
+* Updates the statistics of the current CPU at the end of the handler. One
+* extra clock read measures the handler time. The handler does not run
+* concurrently with itself, so last_entry needs no lock.
+*/
+static inline void GPIO_account(struct GPIO_dev *dev, u64 entry, int notified)
+{
+  struct GPIO_cpu_stats *stats = this_cpu_ptr(dev->stats);
+
+  stats->count++;
+  stats->notifications += notified;
+  stats->last_entry = entry;
+  GPIO_stat_add(&stats->isr, ktime_get_ns() - entry);
+  if (dev->last_entry != 0)
+    GPIO_stat_add(&stats->gap, entry - dev->last_entry);
+  dev->last_entry = entry;
+}
+
+/* ===================================================================
+* function: GPIO_lb_write
+*
+* Drives the int_latency register in loopback mode.
+*/
+static inline void GPIO_lb_write(struct GPIO_dev *dev, u32 value)
+{
+#ifdef GPIO_SIMULATION
+  WRITE_ONCE(dev->sim_regs[0], value);
+#else
+  iowrite32(value, dev->lb_reg);
+#endif
+}
+
+/* ===================================================================
+* function: GPIO_lb_complete
+*
+* Accounts the pending loopback edge and deasserts the pin, which re-arms
+* the rising-edge trigger for the next period.
+*/
+static inline void GPIO_lb_complete(struct GPIO_dev *dev, u64 entry)
+{
+  spin_lock(&dev->lb_lock);
+  if (dev->lb_edge != 0)
+  {
+    GPIO_stat_add(&dev->lb_stats.latency, entry - dev->lb_edge);
+    dev->lb_stats.samples++;
+    dev->lb_edge = 0;
+    GPIO_lb_write(dev, 0);
+  }
+  spin_unlock(&dev->lb_lock);
+}
+
+/* ===================================================================
+* function: GPIO_notify
+*
+* Wakes up blocked readers and pollers, then signals SIGIO subscribers and
+* the registered eventfd, as selected by the notification mask.
+*/
+static void GPIO_notify(struct GPIO_dev *dev, u32 notify)
+{
+  unsigned long flags;
+
+  // The arguments are evaluated even when the event is disabled
+  if (trace_gpio_int_notify_enabled())
+    trace_gpio_int_notify(dev->index,
+                          smp_load_acquire(&dev->ring->head) - 1, notify);
+  if (notify & GPIO_NOTIFY_WAKE)
+    wake_up_interruptible(&dev->wait_queue);
+  if (notify & GPIO_NOTIFY_SIGIO)
+    kill_fasync(&dev->fasync_queue, SIGIO, POLL_IN);
+  if (notify & GPIO_NOTIFY_EVENTFD)
+  {
+    spin_lock_irqsave(&dev->efd_lock, flags);
+    if (dev->efd != NULL)
+      GPIO_eventfd_signal(dev->efd);
+    spin_unlock_irqrestore(&dev->efd_lock, flags);
   }
-  // Get interrupt number
-  GPIO_interrupt_number = res->start;
-  printk("GPIO_KMOD: IRQ found: %d\n", GPIO_interrupt_number);
-  return 0;
 }
 
 /* ===================================================================
@@ -225,12 +892,105 @@ static int GPIO_probe(struct platform_device *pdev)
 */
 static irqreturn_t GPIO_int_handler(int irq, void *dev_id)
 {
-  GPIO_interruptcount++;
-  #ifdef DEBUG
-    printk("GPIO_KMOD: Interrupt detected in kernel \n"); // DEBUG
-  #endif
-  /* Signal the user application that an interrupt occurred */
-  kill_fasync(&GPIO_fasync_queue, SIGIO, POLL_IN);
+  struct GPIO_dev *dev = dev_id;
+  u64 now = ktime_get_ns();
+  u32 notify = READ_ONCE(dev->notify_mask);
+  unsigned int seq = dev->ring->head;
+  struct gpio_int_event *ev = &dev->ring->events[seq & GPIO_EVENT_RING_MASK];
+  int notified = FALSE, pending;
+  irqreturn_t ret = IRQ_HANDLED;
+
+  trace_gpio_int_irq(dev->index, seq, now);
+  if (READ_ONCE(dev->lb_running))
+    GPIO_lb_complete(dev, now);
+
+  if (notify & GPIO_NOTIFY_RING)
+  {
+    /*
+    * Claim the slot before overwriting it, so a reader still copying the old
+    * record sees its seq change, then fill it and publish the new head.
+    */
+    WRITE_ONCE(ev->seq, seq);
+    smp_wmb();
+    ev->timestamp_ns = now;
+    ev->cpu = smp_processor_id();
+    smp_store_release(&dev->ring->head, seq + 1);
+  }
+
+  dev->interruptcount++;
+  if (READ_ONCE(dev->debug))
+    printk("GPIO_KMOD: Interrupt detected in kernel on %s%d\n",
+           GPIO_CHAR_DEV_NAME, dev->index);
+
+  /*
+  * Notify once every coalesce_count interrupts, from here or, in
+  * threaded mode, from GPIO_int_thread(). The first record of a batch arms
+  * the time limit; the xchg decides between the handler and the timer.
+  */
+  pending = atomic_inc_return(&dev->coalesce_pending);
+  if (pending == 1 && pending < READ_ONCE(dev->coalesce_count) &&
+      READ_ONCE(dev->coalesce_us) != 0)
+    hrtimer_start(&dev->coalesce_timer,
+                  ns_to_ktime((u64) dev->coalesce_us * NSEC_PER_USEC),
+                  HRTIMER_MODE_REL);
+  if (pending >= READ_ONCE(dev->coalesce_count) &&
+      atomic_xchg(&dev->coalesce_pending, 0) != 0)
+  {
+    if (pending > 1 && READ_ONCE(dev->coalesce_us) != 0)
+      hrtimer_try_to_cancel(&dev->coalesce_timer);
+    notified = TRUE;
+    if (READ_ONCE(dev->irq_mode) == GPIO_IRQ_MODE_THREADED)
+    {
+      WRITE_ONCE(dev->thread_entry, now);
+      ret = IRQ_WAKE_THREAD;
+    }
+    else
+      GPIO_notify(dev, notify);
+  }
+
+  GPIO_account(dev, now, notified);
+  return ret;
+}
+
+/* ===================================================================
+* function: GPIO_coalesce_expire
+*
+* Hard interrupt context, like the handler, except on PREEMPT_RT where the
+* timer expires in softirq context and the handler can preempt it: the
+* notification counter of this CPU is updated with this_cpu_inc(), which is
+* safe against the handler in both cases. The notifications are sent from
+* here in both handler modes.
+*/
+static enum hrtimer_restart GPIO_coalesce_expire(struct hrtimer *timer)
+{
+  struct GPIO_dev *dev = container_of(timer, struct GPIO_dev, coalesce_timer);
+
+  if (atomic_xchg(&dev->coalesce_pending, 0) != 0)
+  {
+    this_cpu_inc(dev->stats->notifications);
+    GPIO_notify(dev, READ_ONCE(dev->notify_mask));
+  }
+  return HRTIMER_NORESTART;
+}
+
+/* ===================================================================
+* function: GPIO_int_thread
+*
+* Process context: the wake-up latency of the thread is accounted on the
+* CPU it runs on. Only the thread writes that statistic, so disabling
+* preemption is enough.
+*/
+static irqreturn_t GPIO_int_thread(int irq, void *dev_id)
+{
+  struct GPIO_dev *dev = dev_id;
+  struct GPIO_cpu_stats *stats = get_cpu_ptr(dev->stats);
+  u64 entry = READ_ONCE(dev->thread_entry);
+
+  GPIO_stat_add(&stats->thread, ktime_get_ns() - entry);
+  stats->thread_entry = entry;
+  put_cpu_ptr(dev->stats);
+
+  GPIO_notify(dev, READ_ONCE(dev->notify_mask));
   return IRQ_HANDLED;
 }
 
@@ -244,70 +1004,1003 @@ static irqreturn_t GPIO_int_handler(int irq, void *dev_id)
 */
 static int GPIO_fasync (int fd, struct file *filp, int on)
 {
+  struct GPIO_dev *dev = GPIO_dev_of(filp);
+
   #ifdef DEBUG
     printk("GPIO_KMOD: Inside gpio_fasync \n"); // DEBUG
   #endif
-  return fasync_helper(fd, filp, on, &GPIO_fasync_queue);
+  return fasync_helper(fd, filp, on, &dev->fasync_queue);
 };
 
+/* ===================================================================
+* function: gpio_mmap
+*
+* Maps the event ring into user space. Only a read-only mapping at offset 0
+* is accepted: the handler is the single writer of the ring. The simulation
+* build also maps its register page at GPIO_SIM_REG_OFFSET. Both are mapped
+* by page reference, so a mapping keeps its pages after an unbind.
+*/
+static int GPIO_mmap (struct file *filp, struct vm_area_struct *vma)
+{
+  struct GPIO_dev *dev = GPIO_dev_of(filp);
+
+#ifdef GPIO_SIMULATION
+  // The simulated register page, writable like /dev/mem
+  if (vma->vm_pgoff == (GPIO_SIM_REG_OFFSET >> PAGE_SHIFT))
+  {
+    if (vma->vm_end - vma->vm_start > PAGE_SIZE)
+      return -EINVAL;
+    return vm_insert_page(vma, vma->vm_start, virt_to_page(dev->sim_regs));
+  }
+#endif
+  if (vma->vm_pgoff != 0)
+    return -EINVAL;
+  if (vma->vm_end - vma->vm_start > PAGE_ALIGN(sizeof(struct gpio_int_ring)))
+    return -EINVAL;
+  if (vma->vm_flags & VM_WRITE)
+    return -EPERM;
+  GPIO_vm_flags_clear(vma, VM_MAYWRITE);
+
+  return remap_vmalloc_range(vma, dev->ring, 0);
+}
+
+/* ===================================================================
+* function: GPIO_reset_stats
+*
+* Clears the statistics of every CPU. Only exact while the handler is
+* blocked (GPIO_handler_block) or cannot run yet.
+*/
+static void GPIO_reset_stats(struct GPIO_dev *dev)
+{
+  struct GPIO_cpu_stats *stats;
+  int cpu;
+
+  for_each_possible_cpu(cpu)
+  {
+    stats = per_cpu_ptr(dev->stats, cpu);
+    memset(stats, 0, sizeof(*stats));
+    stats->isr.min = U64_MAX;
+    stats->gap.min = U64_MAX;
+    stats->thread.min = U64_MAX;
+  }
+  dev->last_entry = 0;
+}
+
+/* ===================================================================
+* function: GPIO_proc_show
+*
+* Reports the per-CPU statistics and their sum (line "total"). The "last"
+* columns of the total are those of the most recent interrupt.
+*/
+static void GPIO_proc_stat_line(struct seq_file *m, const char *name,
+                                u64 count, const struct gpio_int_stat *isr,
+                                const struct gpio_int_stat *gap)
+{
+  seq_printf(m, "%-6s %12llu %10llu %10llu %10llu %10llu %10llu %10llu\n",
+             name, count,
+             isr->min == U64_MAX ? 0 : isr->min, isr->max, isr->last,
+             gap->min == U64_MAX ? 0 : gap->min, gap->max, gap->last);
+}
+
+static void GPIO_proc_stat_merge(struct gpio_int_stat *total,
+                                 const struct gpio_int_stat *stat, int latest)
+{
+  int i;
+
+  if (stat->min < total->min)
+    total->min = stat->min;
+  if (stat->max > total->max)
+    total->max = stat->max;
+  if (latest)
+    total->last = stat->last;
+  for (i = 0; i < GPIO_STAT_BUCKETS; i++)
+    total->hist[i] += stat->hist[i];
+}
+
+/*
+* The totals cover every possible CPU, like GPIO_IOC_GET_STATS, so the counts
+* of a CPU taken offline are kept; only the CPUs that are online or have
+* counts get a column or a line.
+*/
+static bool GPIO_proc_cpu_shown(struct GPIO_dev *dev, int cpu)
+{
+  struct GPIO_cpu_stats *stats = per_cpu_ptr(dev->stats, cpu);
+
+  return cpu_online(cpu) || stats->count != 0 || stats->thread_entry != 0;
+}
+
+static void GPIO_proc_hist(struct seq_file *m, struct GPIO_dev *dev,
+                           const char *name, size_t offset)
+{
+  const struct gpio_int_stat *stat;
+  u64 sum;
+  int cpu, i;
+
+  seq_printf(m, "\n%s histogram (ns)\n%-12s", name, "from");
+  for_each_possible_cpu(cpu)
+    if (GPIO_proc_cpu_shown(dev, cpu))
+      seq_printf(m, " %10s%-3d", "cpu", cpu);
+  seq_printf(m, " %12s\n", "total");
+  for (i = 0; i < GPIO_STAT_BUCKETS; i++)
+  {
+    sum = 0;
+    for_each_possible_cpu(cpu)
+    {
+      stat = (void *) per_cpu_ptr(dev->stats, cpu) + offset;
+      sum += stat->hist[i];
+    }
+    if (sum == 0)
+      continue;
+    seq_printf(m, "%-12llu", i ? 1ULL << (i - 1) : 0ULL);
+    for_each_possible_cpu(cpu)
+    {
+      if (!GPIO_proc_cpu_shown(dev, cpu))
+        continue;
+      stat = (void *) per_cpu_ptr(dev->stats, cpu) + offset;
+      seq_printf(m, " %13u", stat->hist[i]);
+    }
+    seq_printf(m, " %12llu\n", sum);
+  }
+}
+
+static int GPIO_proc_show(struct seq_file *m, void *v)
+{
+  struct GPIO_dev *dev = m->private;
+  struct GPIO_cpu_stats *stats;
+  struct gpio_int_stat isr_total, gap_total;
+  struct gpio_int_loopback_stats lb_stats;
+  unsigned long flags;
+  u64 count = 0, latest = 0;
+  char name[16];
+  int cpu;
+
+  memset(&isr_total, 0, sizeof(isr_total));
+  memset(&gap_total, 0, sizeof(gap_total));
+  isr_total.min = U64_MAX;
+  gap_total.min = U64_MAX;
+
+  seq_printf(m, "%-6s %12s %10s %10s %10s %10s %10s %10s\n", "cpu", "count",
+             "isr_min", "isr_max", "isr_last", "gap_min", "gap_max",
+             "gap_last");
+  for_each_possible_cpu(cpu)
+  {
+    stats = per_cpu_ptr(dev->stats, cpu);
+    snprintf(name, sizeof(name), "%d", cpu);
+    if (GPIO_proc_cpu_shown(dev, cpu))
+      GPIO_proc_stat_line(m, name, stats->count, &stats->isr, &stats->gap);
+
+    count += stats->count;
+    GPIO_proc_stat_merge(&isr_total, &stats->isr,
+                         stats->count && stats->last_entry >= latest);
+    GPIO_proc_stat_merge(&gap_total, &stats->gap,
+                         stats->count && stats->last_entry >= latest);
+    if (stats->count && stats->last_entry >= latest)
+      latest = stats->last_entry;
+  }
+  GPIO_proc_stat_line(m, "total", count, &isr_total, &gap_total);
+
+  GPIO_proc_hist(m, dev, "ISR time", offsetof(struct GPIO_cpu_stats, isr));
+  GPIO_proc_hist(m, dev, "Interval", offsetof(struct GPIO_cpu_stats, gap));
+  if (READ_ONCE(dev->irq_mode) == GPIO_IRQ_MODE_THREADED)
+    GPIO_proc_hist(m, dev, "Thread wake", offsetof(struct GPIO_cpu_stats, thread));
+
+  spin_lock_irqsave(&dev->lb_lock, flags);
+  lb_stats = dev->lb_stats;
+  spin_unlock_irqrestore(&dev->lb_lock, flags);
+  if (lb_stats.samples + lb_stats.timeouts != 0)
+    seq_printf(m, "Loopback edge to IRQ entry: %llu samples, %llu timeouts, "
+               "min %llu max %llu last %llu ns\n", lb_stats.samples,
+               lb_stats.timeouts,
+               lb_stats.samples ? lb_stats.latency.min : 0,
+               lb_stats.latency.max, lb_stats.latency.last);
+  return 0;
+}
+
+/* ===================================================================
+* function: GPIO_handler_block
+*
+* Waits for a running handler and keeps it from running until
+* GPIO_handler_unblock(), so the statistics can be read or reset exactly.
+*/
+static void GPIO_handler_block(struct GPIO_dev *dev, unsigned long *flags)
+{
+#ifdef GPIO_SIMULATION
+  spin_lock_irqsave(&dev->sim_lock, *flags);
+#else
+  if (dev->irq_requested != FALSE)
+    disable_irq(dev->irq);
+#endif
+}
+
+static void GPIO_handler_unblock(struct GPIO_dev *dev, unsigned long *flags)
+{
+#ifdef GPIO_SIMULATION
+  spin_unlock_irqrestore(&dev->sim_lock, *flags);
+#else
+  if (dev->irq_requested != FALSE)
+    enable_irq(dev->irq);
+#endif
+}
+
+/* ===================================================================
+* function: GPIO_snapshot_stats
+*
+* Sums the per-CPU statistics. Called with the handler blocked.
+*/
+static void GPIO_snapshot_stats(struct GPIO_dev *dev,
+                                struct gpio_int_stats *snap)
+{
+  struct GPIO_cpu_stats *stats;
+  u64 latest = 0, latest_thread = 0;
+  int cpu, i;
+
+  memset(snap, 0, sizeof(*snap));
+  snap->isr.min = U64_MAX;
+  snap->gap.min = U64_MAX;
+  snap->thread.min = U64_MAX;
+  for_each_possible_cpu(cpu)
+  {
+    stats = per_cpu_ptr(dev->stats, cpu);
+    snap->count += stats->count;
+    snap->notifications += stats->notifications;
+    snap->isr.min = min(snap->isr.min, stats->isr.min);
+    snap->isr.max = max(snap->isr.max, stats->isr.max);
+    snap->gap.min = min(snap->gap.min, stats->gap.min);
+    snap->gap.max = max(snap->gap.max, stats->gap.max);
+    snap->thread.min = min(snap->thread.min, stats->thread.min);
+    snap->thread.max = max(snap->thread.max, stats->thread.max);
+    for (i = 0; i < GPIO_STAT_BUCKETS; i++)
+    {
+      snap->isr.hist[i] += stats->isr.hist[i];
+      snap->gap.hist[i] += stats->gap.hist[i];
+      snap->thread.hist[i] += stats->thread.hist[i];
+    }
+    if (stats->count && stats->last_entry >= latest)
+    {
+      latest = stats->last_entry;
+      snap->isr.last = stats->isr.last;
+      snap->gap.last = stats->gap.last;
+    }
+    // The thread may run on another CPU than the handler it follows
+    if (stats->thread_entry != 0 && stats->thread_entry >= latest_thread)
+    {
+      latest_thread = stats->thread_entry;
+      snap->thread.last = stats->thread.last;
+    }
+  }
+  snap->head = smp_load_acquire(&dev->ring->head);
+}
+
+/* ===================================================================
+* function: GPIO_request_irq
+*
+* Requests the IRQ with a trigger (GPIO_TRIGGER_*) and, in threaded mode,
+* the IRQ thread. On PREEMPT_RT the hard handler is force-threaded too: the
+* notifications take sleeping locks there, so it is not requested with
+* IRQF_NO_THREAD, and GPIO_FEAT_PREEMPT_RT tells user space.
+*/
+static int GPIO_request_irq(struct GPIO_dev *dev, u32 trigger, u32 mode)
+{
+  static const unsigned long flags[] = {
+    [GPIO_TRIGGER_RISING]  = IRQF_TRIGGER_RISING,
+    [GPIO_TRIGGER_FALLING] = IRQF_TRIGGER_FALLING,
+    [GPIO_TRIGGER_BOTH]    = IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+    [GPIO_TRIGGER_HIGH]    = IRQF_TRIGGER_HIGH,
+    [GPIO_TRIGGER_LOW]     = IRQF_TRIGGER_LOW,
+  };
+
+  return request_threaded_irq(dev->irq, GPIO_int_handler,
+                              mode == GPIO_IRQ_MODE_THREADED
+                                  ? GPIO_int_thread : NULL,
+                              flags[trigger], dev_name(&dev->pdev->dev), dev);
+}
+
+/* ===================================================================
+* function: GPIO_set_irq
+*
+* Requests the IRQ again with another trigger or handler mode. The mode is
+* switched while no handler is installed, so the hard handler never asks
+* for a thread that does not exist. The previous settings are restored if
+* the new ones are refused. The simulation only records them.
+*/
+static int GPIO_set_irq(struct GPIO_dev *dev, u32 trigger, u32 mode)
+{
+  u32 old_mode = dev->irq_mode;
+  int err = 0;
+
+  if (trigger > GPIO_TRIGGER_LOW || mode > GPIO_IRQ_MODE_THREADED)
+    return -EINVAL;
+#ifndef GPIO_SIMULATION
+  if (dev->irq_requested != FALSE)
+  {
+    free_irq(dev->irq, dev);
+    WRITE_ONCE(dev->irq_mode, mode);
+    err = GPIO_request_irq(dev, trigger, mode);
+    if (err)
+    {
+      printk("GPIO_KMOD: Trigger %u, IRQ mode %u refused with error code: %d\n",
+             trigger, mode, err);
+      WRITE_ONCE(dev->irq_mode, old_mode);
+      if (GPIO_request_irq(dev, dev->trigger, old_mode))
+        dev->irq_requested = FALSE;
+      return err;
+    }
+  }
+#endif
+  dev->trigger = trigger;
+  WRITE_ONCE(dev->irq_mode, mode);
+  return err;
+}
+
+/* ===================================================================
+* function: GPIO_lb_tick
+*
+* One loopback period. The edge is stamped before the register is written,
+* so the measured latency includes the posted write to the FPGA. In the
+* simulation build the assertion is sampled after lb_lock is released,
+* since the simulated handler takes sim_lock before lb_lock.
+*/
+static enum hrtimer_restart GPIO_lb_tick(struct hrtimer *timer)
+{
+  struct GPIO_dev *dev = container_of(timer, struct GPIO_dev, lb_timer);
+  unsigned long flags;
+  int asserted = FALSE;
+
+  spin_lock_irqsave(&dev->lb_lock, flags);
+  if (dev->lb_edge != 0)
+  {
+    // No interrupt within a period: deassert and skip this one
+    dev->lb_stats.timeouts++;
+    dev->lb_edge = 0;
+    GPIO_lb_write(dev, 0);
+  }
+  else if (dev->lb_limit == 0 ||
+           dev->lb_stats.samples + dev->lb_stats.timeouts < dev->lb_limit)
+  {
+    dev->lb_edge = ktime_get_ns();
+    GPIO_lb_write(dev, 1);
+    asserted = TRUE;
+  }
+  else
+    WRITE_ONCE(dev->lb_running, FALSE);
+  spin_unlock_irqrestore(&dev->lb_lock, flags);
+
+#ifdef GPIO_SIMULATION
+  if (asserted)
+    GPIO_sim_sample(dev);
+#endif
+  if (!READ_ONCE(dev->lb_running))
+    return HRTIMER_NORESTART;
+  hrtimer_forward_now(timer, ns_to_ktime(dev->lb_period_ns));
+  return HRTIMER_RESTART;
+}
+
+/* ===================================================================
+* function: GPIO_lb_start
+*
+* Maps the register and starts the loopback timer with cleared statistics.
+* A running loopback is stopped first.
+*/
+static int GPIO_lb_start(struct GPIO_dev *dev,
+                         const struct gpio_int_loopback *lb)
+{
+  unsigned long flags;
+
+  if (lb->period_ns < GPIO_LOOPBACK_MIN_NS)
+    return -EINVAL;
+  GPIO_lb_stop(dev);
+#ifndef GPIO_SIMULATION
+  if (dev->irq_requested == FALSE || dev->reg_addr == 0)
+    return -ENODEV;
+  dev->lb_reg = ioremap(dev->reg_addr, sizeof(u32));
+  if (dev->lb_reg == NULL)
+    return -ENOMEM;
+#endif
+
+  spin_lock_irqsave(&dev->lb_lock, flags);
+  memset(&dev->lb_stats, 0, sizeof(dev->lb_stats));
+  dev->lb_stats.latency.min = U64_MAX;
+  dev->lb_period_ns = lb->period_ns;
+  dev->lb_limit = lb->samples;
+  dev->lb_edge = 0;
+  GPIO_lb_write(dev, 0);
+  WRITE_ONCE(dev->lb_running, TRUE);
+  spin_unlock_irqrestore(&dev->lb_lock, flags);
+
+  hrtimer_start(&dev->lb_timer, ns_to_ktime(lb->period_ns), HRTIMER_MODE_REL);
+  return 0;
+}
+
+/* ===================================================================
+* function: GPIO_lb_stop
+*
+* Once the timer is cancelled and no edge is pending, the handler no longer
+* touches the register, so it can be unmapped.
+*/
+static void GPIO_lb_stop(struct GPIO_dev *dev)
+{
+  unsigned long flags;
+
+  hrtimer_cancel(&dev->lb_timer);
+  spin_lock_irqsave(&dev->lb_lock, flags);
+  if (dev->lb_edge != 0)
+  {
+    dev->lb_edge = 0;
+    GPIO_lb_write(dev, 0);
+  }
+  WRITE_ONCE(dev->lb_running, FALSE);
+  spin_unlock_irqrestore(&dev->lb_lock, flags);
+
+  if (dev->lb_reg != NULL)
+  {
+    iounmap(dev->lb_reg);
+    dev->lb_reg = NULL;
+  }
+}
+
+/* ===================================================================
+* function: GPIO_set_eventfd
+*
+* Replaces the registered eventfd with fd (-1: none) on behalf of filp.
+* GPIO_release() calls it with -1 when the owner is closed.
+*/
+static int GPIO_set_eventfd(struct GPIO_dev *dev, struct file *filp, int fd)
+{
+  struct eventfd_ctx *ctx = NULL, *old;
+  unsigned long flags;
+
+  if (fd >= 0)
+  {
+    ctx = eventfd_ctx_fdget(fd);
+    if (IS_ERR(ctx))
+      return PTR_ERR(ctx);
+  }
+
+  spin_lock_irqsave(&dev->efd_lock, flags);
+  if (ctx == NULL && dev->efd_owner != filp)
+  {
+    // Only the owner may unregister it
+    spin_unlock_irqrestore(&dev->efd_lock, flags);
+    return 0;
+  }
+  old = dev->efd;
+  dev->efd = ctx;
+  dev->efd_owner = ctx ? filp : NULL;
+  spin_unlock_irqrestore(&dev->efd_lock, flags);
+
+  if (old != NULL)
+    eventfd_ctx_put(old);
+  return 0;
+}
+
+/* ===================================================================
+* function: GPIO_ioctl
+*
+* Control plane of an instance. Every command runs under its ctl_mutex; the
+* handler only sees the new settings through READ_ONCE().
+*/
+static long GPIO_ioctl (struct file *filp, unsigned int cmd, unsigned long arg)
+{
+  struct GPIO_file *file = filp->private_data;
+  struct GPIO_dev *dev = file->dev;
+  void __user *uarg = (void __user *) arg;
+  struct gpio_int_info info;
+  struct gpio_int_stats snap;
+  struct gpio_int_cursor cursor;
+  struct gpio_int_coalesce coalesce;
+  struct gpio_int_loopback lb;
+  struct gpio_int_loopback_stats lb_stats;
+  unsigned long flags = 0;
+  u32 value;
+  s32 efd;
+  long err = 0;
+
+  if (_IOC_TYPE(cmd) != GPIO_IOC_MAGIC)
+    return -ENOTTY;
+  if (mutex_lock_interruptible(&dev->ctl_mutex))
+    return -ERESTARTSYS;
+  if (dev->gone != FALSE)
+  {
+    mutex_unlock(&dev->ctl_mutex);
+    return -ENODEV;
+  }
+
+  switch (cmd)
+  {
+    case GPIO_IOC_GET_INFO:
+      memset(&info, 0, sizeof(info));
+      info.version = GPIO_INT_VERSION;
+      info.features = GPIO_FEAT_RING | GPIO_FEAT_READ | GPIO_FEAT_STATS |
+                      GPIO_FEAT_COALESCE | GPIO_FEAT_TRIGGER |
+                      GPIO_FEAT_LOOPBACK | GPIO_FEAT_THREADED |
+                      GPIO_FEAT_EVENTFD;
+#ifdef GPIO_SIMULATION
+      info.features |= GPIO_FEAT_SIMULATION;
+#else
+      // Only instance 0 falls back on int_latency_0
+      if (dev->reg_addr == 0)
+        info.features &= ~GPIO_FEAT_LOOPBACK;
+#endif
+      if (IS_ENABLED(CONFIG_PREEMPT_RT))
+        info.features |= GPIO_FEAT_PREEMPT_RT;
+      info.ring_size = GPIO_EVENT_RING_SIZE;
+      info.irq = dev->irq;
+      info.notify = dev->notify_mask;
+      info.trigger = dev->trigger;
+      info.coalesce_count = dev->coalesce_count;
+      info.coalesce_us = dev->coalesce_us;
+      info.debug = dev->debug;
+      info.irq_mode = dev->irq_mode;
+      info.index = dev->index;
+      if (copy_to_user(uarg, &info, sizeof(info)))
+        err = -EFAULT;
+      break;
+
+    case GPIO_IOC_RESET_STATS:
+      GPIO_handler_block(dev, &flags);
+      GPIO_reset_stats(dev);
+      GPIO_handler_unblock(dev, &flags);
+      mutex_lock(&file->read_mutex);
+      file->read_overruns = 0;
+      mutex_unlock(&file->read_mutex);
+      break;
+
+    case GPIO_IOC_GET_STATS:
+    case GPIO_IOC_SNAP_RESET:
+      GPIO_handler_block(dev, &flags);
+      GPIO_snapshot_stats(dev, &snap);
+      if (cmd == GPIO_IOC_SNAP_RESET)
+        GPIO_reset_stats(dev);
+      GPIO_handler_unblock(dev, &flags);
+      // The read() overruns are those of the calling file
+      mutex_lock(&file->read_mutex);
+      snap.read_overruns = file->read_overruns;
+      if (cmd == GPIO_IOC_SNAP_RESET)
+        file->read_overruns = 0;
+      mutex_unlock(&file->read_mutex);
+      if (copy_to_user(uarg, &snap, sizeof(snap)))
+        err = -EFAULT;
+      break;
+
+    case GPIO_IOC_GET_CURSOR:
+      memset(&cursor, 0, sizeof(cursor));
+      mutex_lock(&file->read_mutex);
+      cursor.head = smp_load_acquire(&dev->ring->head);
+      cursor.tail = file->read_tail;
+      cursor.overruns = file->read_overruns;
+      mutex_unlock(&file->read_mutex);
+      cursor.pending = min_t(u32, cursor.head - cursor.tail,
+                             GPIO_EVENT_RING_SIZE);
+      cursor.subscribers = atomic_read(&dev->users);
+      if (copy_to_user(uarg, &cursor, sizeof(cursor)))
+        err = -EFAULT;
+      break;
+
+    case GPIO_IOC_SET_NOTIFY:
+      if (get_user(value, (u32 __user *) uarg))
+        err = -EFAULT;
+      else if (value & ~GPIO_NOTIFY_ALL)
+        err = -EINVAL;
+      else
+        WRITE_ONCE(dev->notify_mask, value);
+      break;
+
+    case GPIO_IOC_SET_COALESCE:
+      if (copy_from_user(&coalesce, uarg, sizeof(coalesce)))
+        err = -EFAULT;
+      else if (coalesce.count == 0 || coalesce.time_us > GPIO_COALESCE_MAX_US)
+        err = -EINVAL;
+      else
+      {
+        WRITE_ONCE(dev->coalesce_us, coalesce.time_us);
+        WRITE_ONCE(dev->coalesce_count, coalesce.count);
+      }
+      break;
+
+    case GPIO_IOC_SET_TRIGGER:
+      if (get_user(value, (u32 __user *) uarg))
+        err = -EFAULT;
+      else
+        err = GPIO_set_irq(dev, value, dev->irq_mode);
+      break;
+
+    case GPIO_IOC_SET_DEBUG:
+      if (get_user(value, (u32 __user *) uarg))
+        err = -EFAULT;
+      else
+        WRITE_ONCE(dev->debug, value);
+      break;
+
+    case GPIO_IOC_LOOPBACK_START:
+      if (copy_from_user(&lb, uarg, sizeof(lb)))
+        err = -EFAULT;
+      else
+        err = GPIO_lb_start(dev, &lb);
+      break;
+
+    case GPIO_IOC_LOOPBACK_STOP:
+      GPIO_lb_stop(dev);
+      break;
+
+    case GPIO_IOC_LOOPBACK_STATS:
+      spin_lock_irqsave(&dev->lb_lock, flags);
+      lb_stats = dev->lb_stats;
+      lb_stats.running = dev->lb_running;
+      spin_unlock_irqrestore(&dev->lb_lock, flags);
+      if (copy_to_user(uarg, &lb_stats, sizeof(lb_stats)))
+        err = -EFAULT;
+      break;
+
+    case GPIO_IOC_SET_IRQ_MODE:
+      if (get_user(value, (u32 __user *) uarg))
+        err = -EFAULT;
+      else
+        err = GPIO_set_irq(dev, dev->trigger, value);
+      break;
+
+    case GPIO_IOC_SET_EVENTFD:
+      if (get_user(efd, (s32 __user *) uarg))
+        err = -EFAULT;
+      else
+        err = GPIO_set_eventfd(dev, filp, efd);
+      break;
+
+    default:
+      err = -ENOTTY;
+      break;
+  }
+  mutex_unlock(&dev->ctl_mutex);
+  return err;
+}
+
 static int GPIO_release(struct inode *inodep, struct file *filep)
 {
+  struct GPIO_file *file = filep->private_data;
+  struct GPIO_dev *dev = file->dev;
+
+  GPIO_set_eventfd(dev, filep, -1);
+#ifdef GPIO_SIMULATION
+  if (atomic_dec_return(&dev->users) == 0)
+    hrtimer_cancel(&dev->sim_poll_timer);
+#else
+  atomic_dec(&dev->users);
+#endif
+  kfree(file);
+  kref_put(&dev->kref, GPIO_free);
   return 0;
 }
 
-/* =======================================================
+/* ===================================================================
+* function: GPIO_free
 *
-* zynq_gpio_remove - Driver removal function
+* Frees an instance once it is unregistered and its last file is closed.
+* The timers and work items are stopped again: a write() racing with the
+* unbind may have restarted the simulated interrupt.
+*/
+static void GPIO_free(struct kref *kref)
+{
+  struct GPIO_dev *dev = container_of(kref, struct GPIO_dev, kref);
+
+#ifdef GPIO_SIMULATION
+  hrtimer_cancel(&dev->sim_poll_timer);
+  hrtimer_cancel(&dev->sim_irq_timer);
+#endif
+  hrtimer_cancel(&dev->coalesce_timer);
+#ifdef GPIO_SIMULATION
+  flush_work(&dev->sim_irq_work);
+  flush_work(&dev->sim_thread_work);
+  // A user mapping keeps its own reference to the page
+  free_page((unsigned long) dev->sim_regs);
+#endif
+  free_percpu(dev->stats);
+  vfree(dev->ring); // Release the event ring, mappings keep their pages
+  kfree(dev);
+}
+
+/* ===================================================================
+* function: GPIO_destroy
+*
+* Unregisters an instance, fully or partly set up by GPIO_probe(), and drops
+* the reference of the probe. The node and the proc entry go first, so no
+* new user can find the instance, then the pin is deasserted before the IRQ
+* is released. The open files get -ENODEV, or POLLHUP, and the instance is
+* freed when the last of them is closed.
+*/
+static void GPIO_destroy(struct GPIO_dev *dev)
+{
+  if (dev->proc_link != NULL)
+    proc_remove(dev->proc_link);
+  if (dev->proc_entry != NULL)
+    proc_remove(dev->proc_entry);
+  if (dev->device != NULL)
+    device_destroy(GPIO_class, MKDEV(MAJOR(GPIO_devt), dev->index));
+  if (dev->cdev_added != FALSE)
+    cdev_del(dev->cdev); // Freed by the last fput() of its files
+  else if (dev->cdev != NULL)
+    kobject_put(&dev->cdev->kobj);
+
+  mutex_lock(&GPIO_devices_mutex);
+  GPIO_devs[dev->index] = NULL;
+  clear_bit(dev->index, GPIO_minors);
+  mutex_unlock(&GPIO_devices_mutex);
+
+  // No ioctl() can restart the loopback mode or request the IRQ again
+  mutex_lock(&dev->ctl_mutex);
+  WRITE_ONCE(dev->gone, TRUE);
+  GPIO_lb_stop(dev);
+  if (dev->irq_requested != FALSE)
+    free_irq(dev->irq, dev); // Release IRQ
+  dev->irq_requested = FALSE;
+  mutex_unlock(&dev->ctl_mutex);
+#ifdef GPIO_SIMULATION
+  hrtimer_cancel(&dev->sim_poll_timer);
+  hrtimer_cancel(&dev->sim_irq_timer);
+#endif
+  wake_up_interruptible_all(&dev->wait_queue);
+  kref_put(&dev->kref, GPIO_free);
+}
+
+/* ===================================================================
+* gpio_probe - Initialization method for a zynq_gpio device
 *
-* Return: 0 always
+* Sets up one instance: its event ring, statistics and timers, its IRQ
+* (not in the simulation), /dev/gpio_intN, created by udev from the device
+* class, and /proc/gpio-interruptN. Instance 0 also gets the
+* /proc/gpio-interrupt link.
+* Return: 0 on success, negative error otherwise.
 */
-static int GPIO_remove(struct platform_device *pdev)
+static int GPIO_probe(struct platform_device *pdev)
 {
+  struct GPIO_dev *dev;
+  struct resource *res;
+  char name[32];
+  int index, err;
+
+  printk("GPIO_KMOD: Starting probe of %s\n", dev_name(&pdev->dev));
+  mutex_lock(&GPIO_devices_mutex);
+  index = find_first_zero_bit(GPIO_minors, GPIO_MAX_DEVICES);
+  if (index < GPIO_MAX_DEVICES)
+    set_bit(index, GPIO_minors);
+  mutex_unlock(&GPIO_devices_mutex);
+  if (index >= GPIO_MAX_DEVICES)
+  {
+    printk("GPIO_KMOD: More than %d devices, %s ignored\n", GPIO_MAX_DEVICES,
+           dev_name(&pdev->dev));
+    return -ENOSPC;
+  }
+
+  dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+  if (dev == NULL)
+  {
+    mutex_lock(&GPIO_devices_mutex);
+    clear_bit(index, GPIO_minors);
+    mutex_unlock(&GPIO_devices_mutex);
+    return -ENOMEM;
+  }
+  dev->index = index;
+  dev->pdev = pdev;
+  kref_init(&dev->kref);
+  mutex_init(&dev->ctl_mutex);
+  init_waitqueue_head(&dev->wait_queue);
+  spin_lock_init(&dev->efd_lock);
+  spin_lock_init(&dev->lb_lock);
+  dev->notify_mask = GPIO_NOTIFY_ALL;
+  dev->coalesce_count = 1;
+  atomic_set(&dev->coalesce_pending, 0);
+  atomic_set(&dev->users, 0);
+  dev->trigger = GPIO_TRIGGER_RISING;
+  dev->irq_mode = threaded_irq ? GPIO_IRQ_MODE_THREADED : GPIO_IRQ_MODE_HARD;
+  GPIO_hrtimer_setup(&dev->lb_timer, GPIO_lb_tick, HRTIMER_MODE_REL);
+  GPIO_hrtimer_setup(&dev->coalesce_timer, GPIO_coalesce_expire,
+                     HRTIMER_MODE_REL);
+#ifdef GPIO_SIMULATION
+  spin_lock_init(&dev->sim_lock);
+  GPIO_hrtimer_setup(&dev->sim_poll_timer, GPIO_sim_poll,
+                     HRTIMER_MODE_REL_HARD);
+  GPIO_hrtimer_setup(&dev->sim_irq_timer, GPIO_sim_fire,
+                     HRTIMER_MODE_REL_HARD);
+  INIT_WORK(&dev->sim_thread_work, GPIO_sim_thread);
+  INIT_WORK(&dev->sim_irq_work, GPIO_sim_forced);
+#endif
+  platform_set_drvdata(pdev, dev);
+
+  // The event ring is zeroed by vmalloc_user() and shared with user space
+  dev->ring = vmalloc_user(PAGE_ALIGN(sizeof(struct gpio_int_ring)));
+  dev->stats = alloc_percpu(struct GPIO_cpu_stats);
+  if (dev->ring == NULL || dev->stats == NULL)
+  {
+    printk("GPIO_KMOD: Unable to allocate the event ring. ABORTING!\n");
+    err = -ENOMEM;
+    goto fail;
+  }
+#ifdef GPIO_SIMULATION
+  dev->sim_regs = (u32 *) get_zeroed_page(GFP_KERNEL);
+  if (dev->sim_regs == NULL)
+  {
+    printk("GPIO_KMOD: Unable to allocate the simulated registers. ABORTING!\n");
+    err = -ENOMEM;
+    goto fail;
+  }
+#endif
+  dev->ring->size = GPIO_EVENT_RING_SIZE;
+  GPIO_reset_stats(dev);
+
+#ifndef GPIO_SIMULATION
+  // This code gets the IRQ number by probing the system.
+  res = platform_get_resource(pdev, IORESOURCE_IRQ, 0);
+  if (!res)
+  {
+    printk("GPIO_KMOD: No IRQ found\n");
+    err = -ENODEV;
+    goto fail;
+  }
+  // Get interrupt number
+  dev->irq = res->start;
+  printk("GPIO_KMOD: IRQ found: %d\n", dev->irq);
+  // The int_latency register driven by the loopback mode
+  res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
+  if (res)
+    dev->reg_addr = res->start;
+  else if (index == 0)
+    dev->reg_addr = GPIO_LATENCY_REG_ADDR; // The others would share it
+
+  // request interrupt number from linux
+  err = GPIO_request_irq(dev, dev->trigger, dev->irq_mode);
+  if ( err )
+  {
+    printk("GPIO_KMOD: Can't get interrupt %d with error code: %d\n", dev->irq, err);
+    goto fail;
+  }
+  dev->irq_requested = TRUE;
+#else
+  (void) res;
+#endif
+
+  // Published before the node exists, so open() always finds it
+  mutex_lock(&GPIO_devices_mutex);
+  GPIO_devs[index] = dev;
+  mutex_unlock(&GPIO_devices_mutex);
+
+  // Allocated apart: an open file releases the cdev after GPIO_release()
+  dev->cdev = cdev_alloc();
+  if (dev->cdev == NULL)
+  {
+    err = -ENOMEM;
+    goto fail;
+  }
+  dev->cdev->ops = &gpio_fops;
+  dev->cdev->owner = THIS_MODULE;
+  err = cdev_add(dev->cdev, MKDEV(MAJOR(GPIO_devt), index), 1);
+  if (err)
+  {
+    printk("GPIO_KMOD: Unable to add %s%d. ABORTING!\n", GPIO_CHAR_DEV_NAME, index);
+    goto fail;
+  }
+  dev->cdev_added = TRUE;
+  dev->device = device_create(GPIO_class, &pdev->dev,
+                              MKDEV(MAJOR(GPIO_devt), index), dev,
+                              GPIO_CHAR_DEV_NAME "%d", index);
+  if (IS_ERR(dev->device))
+  {
+    err = PTR_ERR(dev->device);
+    dev->device = NULL;
+    printk("GPIO_KMOD: Unable to create /dev/%s%d. ABORTING!\n", GPIO_CHAR_DEV_NAME, index);
+    goto fail;
+  }
+
+  // Create the proc entry
+  snprintf(name, sizeof(name), "%s%d", GPIO_PROC_ENTRY, index);
+  dev->proc_entry = proc_create_data(name, 0444, NULL, &gpio_proc_fops, dev);
+  if (dev->proc_entry == NULL)
+  {
+    printk("GPIO_KMOD: Create /proc/%s entry returned NULL. ABORTING!\n", name);
+    err = -ENOMEM;
+    goto fail;
+  }
+  if (index == 0)
+    dev->proc_link = proc_symlink(GPIO_PROC_ENTRY, NULL, name);
+
+  printk("GPIO_KMOD: Success to create /dev/%s%d and /proc/%s for %s\n",
+         GPIO_CHAR_DEV_NAME, index, name, dev_name(&pdev->dev));
   return 0;
+
+fail:
+  platform_set_drvdata(pdev, NULL);
+  GPIO_destroy(dev);
+  return err;
+}
+
+/* =======================================================
+*
+* zynq_gpio_remove - Driver removal function
+*/
+static void GPIO_remove(struct platform_device *pdev)
+{
+  struct GPIO_dev *dev = platform_get_drvdata(pdev);
+
+  if (dev != NULL)
+    GPIO_destroy(dev);
 }
+
 /* ===================================================================
-* function: cleanup_gpio_interrupt
+* function: GPIO_cleanup
 *
-* This function frees interrupt then removes the /proc directory entry
-* gpio_interrupt.
+* Undoes GPIO_init(): removing the simulated devices and unregistering the
+* driver remove every instance, then the class and the major are released.
 */
-static void __exit GPIO_exit(void)
+static void GPIO_cleanup(void)
 {
+#ifdef GPIO_SIMULATION
+  int i;
+
+  for (i = GPIO_MAX_DEVICES - 1; i >= 0; i--)
+  {
+    if (GPIO_sim_pdevs[i] != NULL)
+      platform_device_unregister(GPIO_sim_pdevs[i]);
+    GPIO_sim_pdevs[i] = NULL;
+  }
+#endif
   if(platform_driver_registered != FALSE)
-    unregister_chrdev(GPIO_MAJOR, GPIO_CHAR_DEV_NAME); // Release character device
-  if(char_dev_registered != FALSE)
     platform_driver_unregister(&gpio_driver); // Unregister the driver
-  if(proc_entry_created != FALSE)
-    remove_proc_entry(GPIO_PROC_ENTRY, NULL); // Remove process entry
-  if(interrupt_requested != FALSE)
-    free_irq(GPIO_interrupt_number,NULL); // Release IRQ
+  platform_driver_registered = FALSE;
+  if(GPIO_class != NULL)
+    class_destroy(GPIO_class);
+  GPIO_class = NULL;
+  if(char_dev_registered != FALSE)
+    unregister_chrdev_region(GPIO_devt, GPIO_MAX_DEVICES); // Release the major
+  char_dev_registered = FALSE;
+}
 
+/* ===================================================================
+* function: cleanup_gpio_interrupt
+*
+* This function removes every instance, with its interrupt, /dev node and
+* /proc entry, then the driver itself.
+*/
+static void __exit GPIO_exit(void)
+{
+  GPIO_cleanup();
   printk(KERN_INFO "GPIO_KMOD: %s %s removed\n", GPIO_MODULE_NAME, GPIO_MODULE_VERSION);
 }
 
 /* ===================================================================
 * function: init_gpio_int
 *
-* This function creates the /proc directory entry gpio_interrupt.
+* This function reserves the major of /dev/gpio_intN and registers the
+* platform driver, whose probe sets up one instance per device.
 */
 static int __init GPIO_init(void)
 {
   int err = 0;
-
-  GPIO_interruptcount   = 0;
-  GPIO_interrupt_number = 0;
-  GPIO_proc_entry       = NULL;
-  GPIO_fasync_queue     = NULL;
+#ifdef GPIO_SIMULATION
+  int i;
+#endif
 
   platform_driver_registered = FALSE;
   char_dev_registered        = FALSE;
-  proc_entry_created         = FALSE;
-  interrupt_requested        = FALSE;
 
-  platform_driver_unregister(&gpio_driver);
   printk("GPIO_KMOD: ZED Interrupt Module\n");
   printk("GPIO_KMOD: ZED Interrupt Driver Loading.\n");
-  printk("GPIO_KMOD: Using Major Number %d on %s\n", GPIO_MAJOR, GPIO_CHAR_DEV_NAME);
+
+  err = alloc_chrdev_region(&GPIO_devt, 0, GPIO_MAX_DEVICES, GPIO_CHAR_DEV_NAME);
+  if(err != 0)
+  {
+    printk("GPIO_KMOD: Unable to get a major for %s. ABORTING!\n", GPIO_CHAR_DEV_NAME);
+    return err;
+  }
+  char_dev_registered = TRUE;
+  printk("GPIO_KMOD: Using Major Number %d on %s0 to %s%d\n", MAJOR(GPIO_devt),
+         GPIO_CHAR_DEV_NAME, GPIO_CHAR_DEV_NAME, GPIO_MAX_DEVICES - 1);
+
+  // udev creates the nodes of the devices of this class
+  GPIO_class = GPIO_class_create(GPIO_CHAR_DEV_NAME);
+  if(IS_ERR(GPIO_class))
+  {
+    err = PTR_ERR(GPIO_class);
+    GPIO_class = NULL;
+    printk("GPIO_KMOD: Unable to create the %s class. ABORTING!\n", GPIO_CHAR_DEV_NAME);
+    goto no_gpio_interrupt;
+  }
 
   err = platform_driver_register(&gpio_driver);
   if(err !=0)
@@ -319,55 +2012,45 @@ static int __init GPIO_init(void)
 
   platform_driver_registered = TRUE;
 
-  err = register_chrdev(GPIO_MAJOR, GPIO_CHAR_DEV_NAME, &gpio_fops);
-
-  if(err != 0)
+#ifdef GPIO_SIMULATION
+  // Software-only devices, probed like device-tree nodes
+  sim_devices = clamp(sim_devices, 1U, (unsigned int) GPIO_MAX_DEVICES);
+  for (i = 0; i < sim_devices; i++)
   {
-    printk("GPIO_KMOD: Unable to get major %d. ABORTING!\n", GPIO_MAJOR);
-    goto no_gpio_interrupt;
+    GPIO_sim_pdevs[i] = platform_device_register_simple(GPIO_MODULE_NAME, i,
+                                                        NULL, 0);
+    if (IS_ERR(GPIO_sim_pdevs[i]))
+    {
+      err = PTR_ERR(GPIO_sim_pdevs[i]);
+      GPIO_sim_pdevs[i] = NULL;
+      printk("GPIO_KMOD: Unable to register simulated device %d\n", i);
+      goto no_gpio_interrupt;
+    }
   }
-  printk("GPIO_KMOD: Success to register %s with major %d\n", GPIO_CHAR_DEV_NAME,GPIO_MAJOR);
-
-  char_dev_registered = TRUE;
+#endif
 
-  // Create the proc entry
-  GPIO_proc_entry = proc_create(GPIO_PROC_ENTRY, 0444, NULL, &gpio_fops );
-  if(GPIO_proc_entry == NULL)
+  // The devices present were probed by the registrations above
+  if (bitmap_empty(GPIO_minors, GPIO_MAX_DEVICES))
   {
-    printk("GPIO_KMOD: Create /proc/%s entry returned NULL. ABORTING!\n",GPIO_PROC_ENTRY);
+    printk("GPIO_KMOD: No device could be probed. ABORTING!\n");
+    err = -ENODEV;
     goto no_gpio_interrupt;
   }
-  printk("GPIO_KMOD: Success to create /proc/%s\n", GPIO_PROC_ENTRY);
-
-  proc_entry_created = TRUE;
 
-  // request interrupt number from linux
-  err = request_irq(GPIO_interrupt_number,
-                   GPIO_int_handler,
-                   IRQF_TRIGGER_RISING,
-                   GPIO_MODULE_NAME,
-                   NULL);
-  if ( err )
-  {
-    printk("GPIO_KMOD: Can't get interrupt %d with error code: %d\n", GPIO_interrupt_number, err);
-    goto no_gpio_interrupt;
-  }
+#ifdef GPIO_SIMULATION
+  // The hrtimers stand in for the IRQ lines
+  printk("GPIO_KMOD: %s %s Initialized (simulation, %u devices, delay %luns, sampling %luns)\n",
+         GPIO_MODULE_NAME, GPIO_MODULE_VERSION, sim_devices, sim_delay_ns,
+         sim_poll_ns);
+#else
   printk("GPIO_KMOD: %s %s Initialized\n",GPIO_MODULE_NAME, GPIO_MODULE_VERSION);
-
-  interrupt_requested = TRUE;
-
+#endif
   return 0;
-  // remove the proc entry on error
+
+  // remove the instances and the driver on error
 no_gpio_interrupt:
-  if(platform_driver_registered != FALSE)
-    unregister_chrdev(GPIO_MAJOR, GPIO_CHAR_DEV_NAME);
-  if(char_dev_registered != FALSE)
-    platform_driver_unregister(&gpio_driver);
-  if(proc_entry_created != FALSE)
-    remove_proc_entry(GPIO_PROC_ENTRY, NULL);
-  if(interrupt_requested != FALSE)
-    free_irq(GPIO_interrupt_number,NULL); // Release IRQ
-  return -EBUSY;
+  GPIO_cleanup();
+  return err;
 };
 
 /* REQUIRED */
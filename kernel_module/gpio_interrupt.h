@@ -0,0 +1,207 @@
+/*
+ ============================================================================
+ Name        : gpio_interrupt.h
+ Author      : Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : Interface shared by the GPIO kernel module and the user
+ applications (records returned by read() on /dev/gpio_intN and the event
+ ring mapped with mmap())
+ ============================================================================
+ */
+
+#ifndef _GPIO_INTERRUPT_H_
+#define _GPIO_INTERRUPT_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+/* ******************* MACROS AND DEFINITIONS ****************************** */
+
+#define GPIO_EVENT_RING_SIZE  1024 // Number of records kept, power of two
+#define GPIO_EVENT_RING_MASK  (GPIO_EVENT_RING_SIZE - 1)
+#define GPIO_RING_HEADER_SIZE 64   // Header padded to a cache line
+
+/*
+* Simulation build only: mmap() offset of the register page that stands in
+* for the FPGA. It is the physical address of the real register, so the
+* monitor maps /dev/gpio_int exactly like /dev/mem.
+*/
+#define GPIO_SIM_REG_OFFSET   0x43C10000
+
+#define GPIO_INT_VERSION      0x0103 // Interface version, major << 8 | minor
+#define GPIO_STAT_BUCKETS     32     // log2(ns) buckets of the statistics
+
+/* Features reported by GPIO_IOC_GET_INFO */
+#define GPIO_FEAT_RING        0x0001 // mmap() event ring
+#define GPIO_FEAT_READ        0x0002 // Blocking read() and poll()
+#define GPIO_FEAT_STATS       0x0004 // Statistics and /proc/gpio-interrupt
+#define GPIO_FEAT_COALESCE    0x0008 // Notification coalescing
+#define GPIO_FEAT_TRIGGER     0x0010 // Runtime trigger selection
+#define GPIO_FEAT_LOOPBACK    0x0020 // In-kernel loopback latency mode
+#define GPIO_FEAT_THREADED    0x0040 // Threaded IRQ handler option
+#define GPIO_FEAT_EVENTFD     0x0080 // eventfd notification
+#define GPIO_FEAT_SIMULATION  0x0100 // Simulation build, no FPGA
+#define GPIO_FEAT_PREEMPT_RT  0x0200 // PREEMPT_RT: the hard handler is force-threaded
+
+/* Notification paths, GPIO_IOC_SET_NOTIFY */
+#define GPIO_NOTIFY_RING      0x0001 // Publish records (ring, read, poll)
+#define GPIO_NOTIFY_WAKE      0x0002 // Wake blocked read()/poll()/epoll
+#define GPIO_NOTIFY_SIGIO     0x0004 // kill_fasync() (O_ASYNC, F_SETSIG)
+#define GPIO_NOTIFY_EVENTFD   0x0008 // Signal the registered eventfd
+#define GPIO_NOTIFY_ALL       0x000F
+
+/*
+* IRQ handling, GPIO_IOC_SET_IRQ_MODE. In threaded mode the hard handler
+* only stamps and publishes the record; the IRQ thread sends the
+* notifications (wake-up, SIGIO, eventfd).
+*/
+#define GPIO_IRQ_MODE_HARD     0
+#define GPIO_IRQ_MODE_THREADED 1
+
+/* Interrupt triggers, GPIO_IOC_SET_TRIGGER */
+#define GPIO_TRIGGER_RISING   0
+#define GPIO_TRIGGER_FALLING  1
+#define GPIO_TRIGGER_BOTH     2
+#define GPIO_TRIGGER_HIGH     3
+#define GPIO_TRIGGER_LOW      4
+
+/* ************************ STRUCTURES AND TYPEDEFS ************************* */
+
+/*
+* One record per interrupt, written by GPIO_int_handler().
+* read() returns whole records only, as many as fit in the user buffer.
+*/
+struct gpio_int_event {
+  __u64 timestamp_ns;   // ktime_get_ns() (CLOCK_MONOTONIC) at IRQ entry
+  __u32 seq;            // Sequence number of the interrupt, starts at 0
+  __u32 cpu;            // CPU that ran GPIO_int_handler()
+};
+
+/*
+* Single-producer ring of interrupt records, mapped read-only into user space
+* with mmap(fd, offset 0). GPIO_int_handler() fills
+* events[seq & GPIO_EVENT_RING_MASK] and then increments head (release).
+* Each consumer keeps its own tail: records tail..head-1 are available, and
+* when head - tail > size the oldest were overwritten. The seq of a slot is
+* written before the rest of the record, so a record is valid only if its seq
+* reads the expected value both before and after it is copied.
+*/
+struct gpio_int_ring {
+  __u32 head;           // Sequence number of the next interrupt
+  __u32 size;           // Number of slots in events[]
+  __u32 reserved[(GPIO_RING_HEADER_SIZE / 4) - 2];
+  struct gpio_int_event events[GPIO_EVENT_RING_SIZE];
+};
+
+/*
+* Driver description, GPIO_IOC_GET_INFO.
+*/
+struct gpio_int_info {
+  __u32 version;        // GPIO_INT_VERSION of the driver
+  __u32 features;       // GPIO_FEAT_*
+  __u32 ring_size;      // Slots of the event ring
+  __u32 irq;            // IRQ number, 0 in the simulation build
+  __u32 notify;         // Current GPIO_NOTIFY_* mask
+  __u32 trigger;        // Current GPIO_TRIGGER_*
+  __u32 coalesce_count; // Current coalescing thresholds
+  __u32 coalesce_us;
+  __u32 debug;          // printk() in the handler when non-zero
+  __u32 irq_mode;       // Current GPIO_IRQ_MODE_*
+  __u32 index;          // N of /dev/gpio_intN
+  __u32 reserved[5];
+};
+
+/*
+* Sum of the per-CPU statistics shown in /proc/gpio-interrupt, taken while
+* no interrupt is being handled (GPIO_IOC_GET_STATS). Bucket i of a
+* histogram counts values in [2^(i-1), 2^i) ns. min is ~0 when empty.
+*/
+struct gpio_int_stat {
+  __u64 min;
+  __u64 max;
+  __u64 last;
+  __u32 hist[GPIO_STAT_BUCKETS];
+};
+
+struct gpio_int_stats {
+  __u64 count;          // Interrupts handled
+  __u64 notifications;  // Wake-ups/signals sent (fewer when coalescing)
+  __u32 head;           // Sequence number of the next interrupt
+  __u32 read_overruns;  // Records lost by the read() cursor of the caller
+  struct gpio_int_stat isr; // Time spent in the handler
+  struct gpio_int_stat gap; // Interval between interrupts
+  struct gpio_int_stat thread; // IRQ entry to IRQ thread, threaded mode
+};
+
+/*
+* read() cursor of the calling file, GPIO_IOC_GET_CURSOR. Every open file
+* has its own cursor, starting at the head of the ring when it is opened, so
+* each subscriber receives every record; one that falls more than a ring
+* behind skips the oldest records and counts them in overruns.
+*/
+struct gpio_int_cursor {
+  __u32 head;           // Sequence number of the next interrupt
+  __u32 tail;           // Next record read() returns to this file
+  __u32 pending;        // Records waiting, at most the ring size
+  __u32 overruns;       // Records this file lost
+  __u32 subscribers;    // Open files of the device
+  __u32 reserved[3];
+};
+
+/*
+* Notification coalescing: subscribers are notified once per count records,
+* or time_us after the first record not yet notified, whichever comes first
+* (0 disables the time limit, at most 1000000). count 1 notifies every
+* interrupt.
+*/
+struct gpio_int_coalesce {
+  __u32 count;
+  __u32 time_us;
+};
+
+/*
+* Loopback mode, GPIO_IOC_LOOPBACK_START: the driver asserts the pin itself
+* every period_ns from an hrtimer, stamps the edge and deasserts it from the
+* interrupt handler, for samples edges (0: until GPIO_IOC_LOOPBACK_STOP).
+* An edge still pending at the next period is counted as a timeout, the pin
+* is deasserted and that period is skipped. The user-space monitor must not
+* drive the pin meanwhile.
+*/
+struct gpio_int_loopback {
+  __u64 period_ns;
+  __u64 samples;
+};
+
+struct gpio_int_loopback_stats {
+  __u64 samples;        // Edges that reached the handler
+  __u64 timeouts;       // Edges with no interrupt within one period
+  __u32 running;        // Non-zero while the loopback timer runs
+  __u32 reserved;
+  struct gpio_int_stat latency; // Pin assertion to handler entry
+};
+
+/* ******************************* IOCTLS ********************************** */
+
+#define GPIO_IOC_MAGIC        'G'
+
+#define GPIO_IOC_GET_INFO     _IOR(GPIO_IOC_MAGIC, 0, struct gpio_int_info)
+#define GPIO_IOC_RESET_STATS  _IO(GPIO_IOC_MAGIC, 1)
+#define GPIO_IOC_GET_STATS    _IOR(GPIO_IOC_MAGIC, 2, struct gpio_int_stats)
+// Snapshot and reset in one step, no interrupt is lost in between
+#define GPIO_IOC_SNAP_RESET   _IOR(GPIO_IOC_MAGIC, 3, struct gpio_int_stats)
+#define GPIO_IOC_SET_NOTIFY   _IOW(GPIO_IOC_MAGIC, 4, __u32)
+#define GPIO_IOC_SET_COALESCE _IOW(GPIO_IOC_MAGIC, 5, struct gpio_int_coalesce)
+#define GPIO_IOC_SET_TRIGGER  _IOW(GPIO_IOC_MAGIC, 6, __u32)
+#define GPIO_IOC_SET_DEBUG    _IOW(GPIO_IOC_MAGIC, 7, __u32)
+// Starting clears the loopback statistics; they are kept after the stop
+#define GPIO_IOC_LOOPBACK_START _IOW(GPIO_IOC_MAGIC, 8, struct gpio_int_loopback)
+#define GPIO_IOC_LOOPBACK_STOP  _IO(GPIO_IOC_MAGIC, 9)
+#define GPIO_IOC_LOOPBACK_STATS _IOR(GPIO_IOC_MAGIC, 10, struct gpio_int_loopback_stats)
+#define GPIO_IOC_SET_IRQ_MODE _IOW(GPIO_IOC_MAGIC, 11, __u32)
+// Registers an eventfd signalled on each notification, -1 unregisters it.
+// One eventfd at a time; it is dropped when the registering file is closed
+#define GPIO_IOC_SET_EVENTFD  _IOW(GPIO_IOC_MAGIC, 12, __s32)
+#define GPIO_IOC_GET_CURSOR   _IOR(GPIO_IOC_MAGIC, 13, struct gpio_int_cursor)
+
+#endif /* _GPIO_INTERRUPT_H_ */
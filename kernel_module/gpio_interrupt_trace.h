@@ -0,0 +1,118 @@
+/*
+ ============================================================================
+ Name        : gpio_interrupt_trace.h
+ Author      : Team3
+ Version     :
+ Copyright   : Your copyright notice
+ Description : ftrace tracepoints of the GPIO kernel module, enabled with
+ "echo 1 > /sys/kernel/tracing/events/gpio_interrupt/enable". Every event
+ carries the ktime_get_ns() (CLOCK_MONOTONIC) time it was taken at, the
+ domain of the records and of the monitor, whatever the trace_clock. Except
+ for the IRQ entry, which reuses the time of its record, that time is read
+ in TP_fast_assign(), so a disabled event costs no clock read.
+ ============================================================================
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM gpio_interrupt
+
+#if !defined(_GPIO_INTERRUPT_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _GPIO_INTERRUPT_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+#define GPIO_WAKE_READ        0   // read() returned records
+#define GPIO_WAKE_POLL        1   // poll()/epoll found the file readable
+
+/*
+* IRQ entry: seq is the sequence number of the record being written.
+*/
+TRACE_EVENT(gpio_int_irq,
+
+  TP_PROTO(unsigned int index, u32 seq, u64 ts),
+
+  TP_ARGS(index, seq, ts),
+
+  TP_STRUCT__entry(
+    __field(unsigned int, index)
+    __field(u32, seq)
+    __field(u64, ts)
+  ),
+
+  TP_fast_assign(
+    __entry->index = index;
+    __entry->seq = seq;
+    __entry->ts = ts;
+  ),
+
+  TP_printk("dev=%u seq=%u ts=%llu", __entry->index, __entry->seq,
+            (unsigned long long) __entry->ts)
+);
+
+/*
+* Notification of the waiters (GPIO_NOTIFY_* mask), from the handler, the
+* IRQ thread or the coalescing timer: seq is the newest record it covers.
+*/
+TRACE_EVENT(gpio_int_notify,
+
+  TP_PROTO(unsigned int index, u32 seq, u32 notify),
+
+  TP_ARGS(index, seq, notify),
+
+  TP_STRUCT__entry(
+    __field(unsigned int, index)
+    __field(u32, seq)
+    __field(u32, notify)
+    __field(u64, ts)
+  ),
+
+  TP_fast_assign(
+    __entry->index = index;
+    __entry->seq = seq;
+    __entry->notify = notify;
+    __entry->ts = ktime_get_ns();
+  ),
+
+  TP_printk("dev=%u seq=%u notify=0x%x ts=%llu", __entry->index,
+            __entry->seq, __entry->notify, (unsigned long long) __entry->ts)
+);
+
+/*
+* A waiter runs again in the driver and finds records up to seq, in the
+* context of its own task.
+*/
+TRACE_EVENT(gpio_int_wake,
+
+  TP_PROTO(unsigned int index, u32 seq, int path),
+
+  TP_ARGS(index, seq, path),
+
+  TP_STRUCT__entry(
+    __field(unsigned int, index)
+    __field(u32, seq)
+    __field(int, path)
+    __field(u64, ts)
+  ),
+
+  TP_fast_assign(
+    __entry->index = index;
+    __entry->seq = seq;
+    __entry->path = path;
+    __entry->ts = ktime_get_ns();
+  ),
+
+  TP_printk("dev=%u seq=%u path=%s ts=%llu", __entry->index, __entry->seq,
+            __print_symbolic(__entry->path,
+                             { GPIO_WAKE_READ, "read" },
+                             { GPIO_WAKE_POLL, "poll" }),
+            (unsigned long long) __entry->ts)
+);
+
+#endif /* _GPIO_INTERRUPT_TRACE_H_ */
+
+/* This part must be outside the include guard */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gpio_interrupt_trace
+#include <trace/define_trace.h>
@@ -1,15 +1,15 @@
 #!/bin/bash
 
 MODULE_NAME=$1
+shift # Remaining arguments are module parameters, e.g. sim_devices=4
 DEV_FILE=/dev/gpio_int
-GPIO_MAJOR=243
-
-if [ ! -f $DEV_FILE ]; then
-  echo "GPIO_INT_MOD: Creating device node: "$DEV_FILE
-  echo "GPIO_INT_MOD: Command = mknod "$DEV_FILE" c "$GPIO_MAJOR" 0"
-  mknod $DEV_FILE c $GPIO_MAJOR 0
-fi
 
 echo "Inserting kernel module = " $MODULE_NAME
-insmod $MODULE_NAME
+insmod $MODULE_NAME "$@" || exit 1
 
+# udev creates /dev/gpio_int0, /dev/gpio_int1... from the gpio_int class
+udevadm settle 2>/dev/null
+if [ -e ${DEV_FILE}0 ] && [ ! -e $DEV_FILE -o -L $DEV_FILE ]; then
+  echo "GPIO_INT_MOD: Linking "$DEV_FILE" to "${DEV_FILE}0
+  ln -sf gpio_int0 $DEV_FILE
+fi
@@ -1,6 +1,10 @@
 #!/bin/bash
 
 MODULE_NAME=$1
+DEV_FILE=/dev/gpio_int
 
 echo "Removing kernel module = " $MODULE_NAME
 rmmod $MODULE_NAME
+if [ -L $DEV_FILE ]; then
+  rm -f $DEV_FILE
+fi